@@ -0,0 +1,157 @@
+/*
+ * BigInt multiplication and division: per-algorithm timings and threshold
+ * tuning.
+ *
+ * usage: bignum_bench [tune]
+ *
+ * Without arguments, times balanced n x n limb products for n from 8 to
+ * 2^18 with the default LIMBS::MulThresholds, next to schoolbook alone
+ * and Toom-Cook without the NTT where those still finish in reasonable
+ * time. A second table times 2n / n limb divisions with the default
+ * LIMBS::DivThresholds and gives them as a multiple of the n x n product.
+ *
+ * `tune` searches the crossovers in order. For each candidate size n it
+ * times a product (or division) that uses the next algorithm only at the
+ * top level (its threshold set to n) against one that does not. The
+ * crossover is the first n where the new algorithm wins at three sizes in
+ * a row. The results are printed in MulThresholds' and DivThresholds'
+ * form, ready to paste in.
+ */
+
+#include "limbs.hpp"
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+using LIMBS::DivThresholds;
+using LIMBS::Limb;
+using LIMBS::MulThresholds;
+
+constexpr MulThresholds SCHOOLBOOK = {INT_MAX, INT_MAX, INT_MAX};
+
+// ns per n x n product, repeated for at least 20 ms
+double timeProduct(int n, const MulThresholds &at) {
+  std::mt19937_64 rng(n);
+  std::vector<Limb> a(n), b(n), out(2 * n);
+  for (int i = 0; i < n; ++i) {
+    a[i] = rng();
+    b[i] = rng();
+  }
+  using Clock = std::chrono::steady_clock;
+  long reps = 0;
+  auto start = Clock::now();
+  std::chrono::duration<double> elapsed{};
+  do {
+    LIMBS::multiply(out.data(), a.data(), n, b.data(), n, at);
+    ++reps;
+    elapsed = Clock::now() - start;
+  } while (elapsed.count() < 0.02);
+  return elapsed.count() * 1e9 / reps;
+}
+
+// ns per 2n / n division, repeated for at least 20 ms
+double timeDivision(int n, const DivThresholds &at) {
+  std::mt19937_64 rng(n);
+  std::vector<Limb> a(2 * n), b(n), q(n + 1), r(n);
+  for (int i = 0; i < n; ++i) {
+    a[i] = rng();
+    a[n + i] = rng();
+    b[i] = rng();
+  }
+  using Clock = std::chrono::steady_clock;
+  long reps = 0;
+  auto start = Clock::now();
+  std::chrono::duration<double> elapsed{};
+  do {
+    LIMBS::divide(q.data(), r.data(), a.data(), 2 * n, b.data(), n, at);
+    ++reps;
+    elapsed = Clock::now() - start;
+  } while (elapsed.count() < 0.02);
+  return elapsed.count() * 1e9 / reps;
+}
+
+double timeOf(int n, const MulThresholds &at) { return timeProduct(n, at); }
+double timeOf(int n, const DivThresholds &at) { return timeDivision(n, at); }
+
+// First size where `with` (given n) beats `without` three times running
+template <typename Thresholds, typename Set>
+int crossover(const Thresholds &without, Set &&with, int from, int to) {
+  int wins = 0, first = to;
+  for (int n = from; n < to; n += n / 8 + 1) {
+    double old = timeOf(n, without), next = timeOf(n, with(n));
+    std::printf("  n=%5d %10.0f ns %10.0f ns\n", n, old, next);
+    if (next < old) {
+      if (wins++ == 0)
+        first = n;
+      if (wins == 3)
+        return first;
+    } else {
+      wins = 0;
+    }
+  }
+  return to;
+}
+
+void tune() {
+  MulThresholds at = SCHOOLBOOK;
+  std::printf("schoolbook -> Karatsuba\n");
+  at.karatsuba = crossover(
+      at, [&](int n) { return MulThresholds{n, INT_MAX, INT_MAX}; }, 8, 400);
+  std::printf("Karatsuba -> Toom-3\n");
+  at.toom3 = crossover(
+      at, [&](int n) { return MulThresholds{at.karatsuba, n, INT_MAX}; },
+      at.karatsuba, 2000);
+  std::printf("Toom-3 -> NTT\n");
+  at.ntt = crossover(
+      at, [&](int n) { return MulThresholds{at.karatsuba, at.toom3, n}; },
+      at.toom3, 40000);
+  std::printf("MulThresholds{%d, %d, %d}\n", at.karatsuba, at.toom3,
+              at.ntt);
+
+  // division runs on the default multiplication thresholds
+  DivThresholds dt = {INT_MAX, INT_MAX};
+  std::printf("schoolbook -> Burnikel-Ziegler\n");
+  dt.burnikelZiegler = crossover(
+      dt, [&](int n) { return DivThresholds{n, INT_MAX}; }, 8, 1000);
+  std::printf("Burnikel-Ziegler -> Newton\n");
+  dt.newton = crossover(
+      dt, [&](int n) { return DivThresholds{dt.burnikelZiegler, n}; },
+      dt.burnikelZiegler, 40000);
+  std::printf("DivThresholds{%d, %d}\n", dt.burnikelZiegler, dt.newton);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc > 1 && std::strcmp(argv[1], "tune") == 0) {
+    tune();
+    return 0;
+  }
+  MulThresholds toomOnly;
+  toomOnly.ntt = INT_MAX;
+  std::printf("%7s %14s %14s %14s\n", "limbs", "default ns", "no-NTT ns",
+              "schoolbook ns");
+  for (int n = 8; n <= 1 << 18; n *= 2) {
+    std::printf("%7d %14.0f", n, timeProduct(n, {}));
+    if (n <= 1 << 16)
+      std::printf(" %14.0f", timeProduct(n, toomOnly));
+    else
+      std::printf(" %14s", "-");
+    if (n <= 1 << 12)
+      std::printf(" %14.0f\n", timeProduct(n, SCHOOLBOOK));
+    else
+      std::printf(" %14s\n", "-");
+  }
+
+  std::printf("\n%7s %14s %14s\n", "limbs", "2n / n ns", "/ product");
+  for (int n = 8; n <= 1 << 17; n *= 2) {
+    double ns = timeDivision(n, {});
+    std::printf("%7d %14.0f %14.2f\n", n, ns, ns / timeProduct(n, {}));
+  }
+  return 0;
+}
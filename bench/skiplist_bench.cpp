@@ -0,0 +1,135 @@
+/*
+ * Lock-free skip list vs. RedBlackTree behind a shared_mutex.
+ *
+ * usage: skiplist_bench [ops-per-thread] [key-range]
+ *
+ * Each run prefills half of the key range, then every thread performs a
+ * random mix of search / insert / remove on uniform keys. Reported numbers
+ * are aggregate million operations per second.
+ */
+
+#include "rbtree.h"
+#include "skiplist.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Mix {
+  const char *name;
+  unsigned searchPct;
+  unsigned insertPct; // the remainder removes
+};
+
+// the baseline: one tree, readers shared, writers exclusive
+class LockedTree {
+public:
+  bool insert(int key) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    if (tree.search(key))
+      return false;
+    tree.insert(key);
+    return true;
+  }
+  bool search(int key) {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return tree.search(key) != nullptr;
+  }
+  bool remove(int key) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    if (!tree.search(key))
+      return false;
+    tree.remove(key);
+    return true;
+  }
+
+private:
+  std::shared_mutex mutex;
+  RBTREE::RedBlackTree<int> tree;
+};
+
+std::uint64_t xorshift(std::uint64_t &x) {
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  return x;
+}
+
+template <typename Set>
+double run(unsigned threads, const Mix &mix, long ops, int range) {
+  Set set;
+  for (int k = 0; k < range; k += 2)
+    set.insert(k);
+
+  std::atomic<unsigned> ready{0};
+  std::atomic<bool> go{false};
+  std::atomic<long> sink{0};
+  std::vector<std::thread> workers;
+
+  for (unsigned t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      std::uint64_t rng = 0x9e3779b97f4a7c15ull * (t + 1);
+      long hits = 0;
+      ready.fetch_add(1);
+      while (!go.load(std::memory_order_acquire))
+        std::this_thread::yield();
+      for (long i = 0; i < ops; ++i) {
+        std::uint64_t r = xorshift(rng);
+        int key = static_cast<int>((r >> 8) % range);
+        unsigned dice = r % 100;
+        if (dice < mix.searchPct)
+          hits += set.search(key);
+        else if (dice < mix.searchPct + mix.insertPct)
+          hits += set.insert(key);
+        else
+          hits += set.remove(key);
+      }
+      sink.fetch_add(hits);
+    });
+  }
+
+  while (ready.load() != threads)
+    std::this_thread::yield();
+  auto start = std::chrono::steady_clock::now();
+  go.store(true, std::memory_order_release);
+  for (auto &w : workers)
+    w.join();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  return threads * ops / elapsed.count() / 1e6;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  long ops = argc > 1 ? std::atol(argv[1]) : 200000;
+  int range = argc > 2 ? std::atoi(argv[2]) : 1 << 20;
+
+  const Mix mixes[] = {
+      {"read-mostly 90/5/5", 90, 5},
+      {"balanced 50/25/25", 50, 25},
+  };
+  const unsigned threadCounts[] = {1, 2, 4, 8, 16, 32, 64};
+
+  std::printf("ops/thread=%ld key-range=%d hw-threads=%u\n", ops, range,
+              std::thread::hardware_concurrency());
+  for (const Mix &mix : mixes) {
+    std::printf("\n%s (Mops/s)\n", mix.name);
+    std::printf("%8s %14s %14s %8s\n", "threads", "skiplist", "locked-rbt",
+                "ratio");
+    for (unsigned t : threadCounts) {
+      double lf = run<SKIPLIST::LockFreeSkipList<int>>(t, mix, ops, range);
+      double rb = run<LockedTree>(t, mix, ops, range);
+      std::printf("%8u %14.2f %14.2f %8.2f\n", t, lf, rb, lf / rb);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,205 @@
+/*
+ * Successor / predecessor traffic on 32-bit keys: VanEmdeBoasTree vs.
+ * AVLTree, RedBlackTree, AdaptiveRadixTree and std::set.
+ *
+ * usage: successor_bench [keys] [queries]
+ *
+ * Loads `keys` distinct uniform 32-bit integers, then times: the inserts,
+ * successor of stored keys (AVLTree::successor(key) for the trees), and
+ * successor / predecessor of arbitrary probes (lowerBound plus a step for
+ * the trees), and finally removing every key. Reported in Mops/s, plus the
+ * bytes per key each structure holds after loading.
+ */
+
+#include "art.hpp"
+#include "generator.hpp"
+#include "nodepool.hpp"
+#include "rbtree.h"
+#include "tree.hpp"
+#include "veb.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <random>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+volatile long sink; // keeps predecessor answers from being optimised away
+
+//-------------------------------------------------------------------------------
+//                                 Structures
+//-------------------------------------------------------------------------------
+
+// Each adapter answers successor / predecessor with the key or `none`
+constexpr long none = -1;
+
+struct Veb {
+  static constexpr const char *name = "vEB";
+  VEB::VanEmdeBoasTree<int> s;
+  void insert(int k) { s.insert(k); }
+  void remove(int k) { s.remove(k); }
+  long nextOfStored(int k) { return successor(k); }
+  long successor(int k) { return s.successor(k).value_or(none); }
+  long predecessor(int k) { return s.predecessor(k).value_or(none); }
+  double bytesPerKey() { return double(s.memoryUsage()) / s.size(); }
+};
+
+struct Art {
+  static constexpr const char *name = "ART";
+  ART::AdaptiveRadixTree<int> s;
+  void insert(int k) { s.insert(k); }
+  void remove(int k) { s.remove(k); }
+  long nextOfStored(int k) { return successor(k); }
+  long successor(int k) { return s.successor(k).value_or(none); }
+  long predecessor(int) { return none; } // ART has none, see timed<>
+  double bytesPerKey() { return double(s.memoryUsage()) / s.size(); }
+};
+
+template <typename Tree> struct TreeOf {
+  Tree t;
+  void insert(int k) { t.insert(k); }
+  void remove(int k) { t.remove(k); }
+  long nextOfStored(int k) {
+    auto *node = t.successor(k); // the maximum comes back as itself
+    return node && node->key != k ? node->key : none;
+  }
+  long successor(int k) {
+    auto *node = TRAVERSE::lowerBound(t.getRoot(), k);
+    if (node && node->key == k)
+      node = TRAVERSE::next(node);
+    return node ? node->key : none;
+  }
+  long predecessor(int k) {
+    auto *root = t.getRoot();
+    auto *node = TRAVERSE::lowerBound(root, k);
+    node = node ? TRAVERSE::prev(node) : TRAVERSE::rightmost(root);
+    return node ? node->key : none;
+  }
+  double bytesPerKey() {
+    using NodeT = std::remove_pointer_t<decltype(t.getRoot())>;
+    return double(POOL::sizeClass(sizeof(NodeT)));
+  }
+};
+
+struct Avl : TreeOf<TREE::AVLTree<int>> {
+  static constexpr const char *name = "AVL";
+};
+struct Rbt : TreeOf<RBTREE::RedBlackTree<int>> {
+  static constexpr const char *name = "RedBlack";
+};
+
+struct StdSet {
+  static constexpr const char *name = "std::set";
+  std::set<int> s;
+  void insert(int k) { s.insert(k); }
+  void remove(int k) { s.erase(k); }
+  long nextOfStored(int k) { return successor(k); }
+  long successor(int k) {
+    auto it = s.upper_bound(k);
+    return it == s.end() ? none : *it;
+  }
+  long predecessor(int k) {
+    auto it = s.lower_bound(k);
+    return it == s.begin() ? none : *std::prev(it);
+  }
+  double bytesPerKey() { return -1; } // node size is the library's business
+};
+
+//-------------------------------------------------------------------------------
+//                                   Timing
+//-------------------------------------------------------------------------------
+
+template <typename S> constexpr bool timesPredecessor = true;
+template <> constexpr bool timesPredecessor<Art> = false;
+
+// negative entries were not measured
+struct Row {
+  double insert, nextOfStored, successor, predecessor, remove, bytes;
+  long check; // summed successor answers, compared across structures
+};
+
+template <typename Op> double mops(std::size_t count, Op &&op) {
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < count; ++i)
+    op(i);
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return count / elapsed.count() / 1e6;
+}
+
+template <typename S>
+Row run(const std::vector<int> &keys, const std::vector<int> &stored,
+        const std::vector<int> &probes) {
+  auto *s = new S;
+  Row row{};
+  long sum = 0, predSum = 0;
+  row.insert = mops(keys.size(), [&](std::size_t i) { s->insert(keys[i]); });
+  row.bytes = s->bytesPerKey();
+  row.nextOfStored = mops(stored.size(), [&](std::size_t i) {
+    sum += s->nextOfStored(stored[i]);
+  });
+  row.successor = mops(probes.size(), [&](std::size_t i) {
+    sum += s->successor(probes[i]);
+  });
+  row.predecessor = -1;
+  if constexpr (timesPredecessor<S>)
+    row.predecessor = mops(probes.size(), [&](std::size_t i) {
+      predSum += s->predecessor(probes[i]);
+    });
+  sink = predSum;
+  row.remove = mops(keys.size(), [&](std::size_t i) { s->remove(keys[i]); });
+  row.check = sum;
+  delete s;
+  return row;
+}
+
+std::string cell(double v) {
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%.2f", v);
+  return v < 0 ? "-" : buf;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1 << 20;
+  std::size_t q = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1 << 21;
+
+  std::mt19937 rng(20240611);
+  std::unordered_set<int> seen;
+  std::vector<int> keys;
+  while (keys.size() < n)
+    if (int k = int(rng()); seen.insert(k).second)
+      keys.push_back(k);
+  std::vector<int> stored(q), probes(q);
+  for (std::size_t i = 0; i < q; ++i) {
+    stored[i] = keys[rng() % n];
+    probes[i] = int(rng());
+  }
+
+  const char *names[] = {Veb::name, Avl::name, Rbt::name, Art::name,
+                         StdSet::name};
+  Row rows[] = {run<Veb>(keys, stored, probes), run<Avl>(keys, stored, probes),
+                run<Rbt>(keys, stored, probes), run<Art>(keys, stored, probes),
+                run<StdSet>(keys, stored, probes)};
+
+  std::printf("keys=%zu queries=%zu (Mops/s)\n", n, q);
+  std::printf("%-9s %9s %9s %9s %9s %9s %9s\n", "structure", "insert",
+              "succ-key", "succ-any", "pred-any", "remove", "bytes/key");
+  for (std::size_t i = 0; i < std::size(rows); ++i) {
+    const Row &r = rows[i];
+    std::printf("%-9s %9.2f %9.2f %9.2f %9s %9.2f %9s%s\n", names[i],
+                r.insert, r.nextOfStored, r.successor,
+                cell(r.predecessor).c_str(), r.remove, cell(r.bytes).c_str(),
+                r.check == rows[0].check ? "" : "  MISMATCH");
+  }
+  return 0;
+}
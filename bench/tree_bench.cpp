@@ -0,0 +1,405 @@
+/*
+ * BinarySearchTree / AVLTree / RedBlackTree / ScapegoatTree vs. std::set and
+ * std::map.
+ *
+ * usage: tree_bench [max-exponent] [min-exponent]
+ *
+ * For every n = 10^min .. 10^max (default 10^3 .. 10^6; 10^8 needs tens of
+ * GB) and every key pattern (uniform, sequential, Zipf 0.99) each structure
+ * runs: insert n keys, n lookup hits, n lookup misses, a full ordered scan,
+ * delete all keys, and finally a 80/10/10 lookup/insert/delete mix on a
+ * freshly loaded copy. Reported per workload: throughput in Mops/s and
+ * p50/p99 latency of every 16th operation (which includes ~20 ns of clock
+ * overhead), plus heap bytes per key after the insert phase.
+ *
+ * A tree that loses keys or degenerates past 4 log2(n) levels is reported
+ * and skipped for larger n of that pattern, since the recursive insert of a
+ * degenerate tree would overflow the stack.
+ */
+
+#include "generator.hpp"
+#include "layout.hpp"
+#include "rbtree.h"
+#include "scapegoat.hpp"
+#include "tree.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <malloc.h>
+#include <map>
+#include <new>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------------------------
+//                               Heap Accounting
+//-------------------------------------------------------------------------------
+
+// malloc_usable_size() counts what the allocator really hands out, rounding
+// included; the bench is single threaded so a plain counter will do
+static std::size_t heapBytes = 0;
+
+static void *countedAlloc(std::size_t size) {
+  void *p = std::malloc(size ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+  heapBytes += malloc_usable_size(p);
+  return p;
+}
+
+static void countedFree(void *p) noexcept {
+  if (p)
+    heapBytes -= malloc_usable_size(p);
+  std::free(p);
+}
+
+void *operator new(std::size_t size) { return countedAlloc(size); }
+void *operator new[](std::size_t size) { return countedAlloc(size); }
+void operator delete(void *p) noexcept { countedFree(p); }
+void operator delete[](void *p) noexcept { countedFree(p); }
+void operator delete(void *p, std::size_t) noexcept { countedFree(p); }
+void operator delete[](void *p, std::size_t) noexcept { countedFree(p); }
+
+namespace {
+
+//-------------------------------------------------------------------------------
+//                                 Structures
+//-------------------------------------------------------------------------------
+
+struct StdSet {
+  static constexpr const char *name = "std::set";
+  std::set<int> s;
+  void insert(int k) { s.insert(k); }
+  bool contains(int k) { return s.find(k) != s.end(); }
+  void erase(int k) { s.erase(k); }
+  long scan() {
+    long sum = 0;
+    for (int k : s)
+      sum += k;
+    return sum;
+  }
+  std::string health(std::size_t) { return {}; }
+};
+
+struct StdMap {
+  static constexpr const char *name = "std::map";
+  std::map<int, int> m;
+  void insert(int k) { m.emplace(k, k); }
+  bool contains(int k) { return m.find(k) != m.end(); }
+  void erase(int k) { m.erase(k); }
+  long scan() {
+    long sum = 0;
+    for (const auto &kv : m)
+      sum += kv.first;
+    return sum;
+  }
+  std::string health(std::size_t) { return {}; }
+};
+
+template <typename Tree> struct TreeOf {
+  Tree t;
+  void insert(int k) { t.insert(k); }
+  bool contains(int k) { return t.search(k) != nullptr; }
+  void erase(int k) { t.remove(k); }
+  long scan() {
+    long sum = 0;
+    for (int k : TRAVERSE::inOrder(t.getRoot()))
+      sum += k;
+    return sum;
+  }
+  std::string health(std::size_t n) {
+    std::size_t found = 0; // capped: broken links may form a cycle
+    for (int k [[maybe_unused]] : TRAVERSE::inOrder(t.getRoot()))
+      if (++found > n)
+        break;
+    if (found != n)
+      return "broken: " + std::to_string(found) + " of " + std::to_string(n) +
+             " keys reachable";
+    int height = LAYOUT::height(t.getRoot());
+    if (height > 4 * std::log2(double(n) + 1) + 4)
+      return "degenerate: height " + std::to_string(height);
+    return {};
+  }
+};
+
+struct BST : TreeOf<TREE::BinarySearchTree<int>> {
+  static constexpr const char *name = "BST";
+};
+struct AVL : TreeOf<TREE::AVLTree<int>> {
+  static constexpr const char *name = "AVL";
+};
+struct RBT : TreeOf<RBTREE::RedBlackTree<int>> {
+  static constexpr const char *name = "RedBlack";
+};
+
+// no parent pointers, so it walks with forEach instead of TRAVERSE
+struct SGT {
+  static constexpr const char *name = "Scapegoat";
+  SCAPEGOAT::ScapegoatTree<int> t;
+  void insert(int k) { t.insert(k); }
+  bool contains(int k) { return t.search(k) != nullptr; }
+  void erase(int k) { t.remove(k); }
+  std::size_t bytes() { return t.bytes(); }
+  long scan() {
+    long sum = 0;
+    t.forEach([&](int k) { sum += k; });
+    return sum;
+  }
+  std::string health(std::size_t n) {
+    std::size_t found = 0;
+    t.forEach([&](int) { ++found; });
+    if (found != n)
+      return "broken: " + std::to_string(found) + " of " + std::to_string(n) +
+             " keys reachable";
+    if (t.height() > 4 * std::log2(double(n) + 1) + 4)
+      return "degenerate: height " + std::to_string(t.height());
+    return {};
+  }
+};
+
+//-------------------------------------------------------------------------------
+//                                Key Patterns
+//-------------------------------------------------------------------------------
+
+enum class Pattern { Uniform, Sequential, Zipf };
+const char *patternName(Pattern p) {
+  return p == Pattern::Uniform ? "uniform"
+         : p == Pattern::Sequential ? "sequential"
+                                    : "zipf-0.99";
+}
+
+// Gray et al. "Quickly generating billion-record synthetic databases";
+// O(n) setup, O(1) per draw, ranks in [0, n) with rank 0 the hottest
+class Zipf {
+public:
+  Zipf(std::size_t n, double theta) : n(n), theta(theta) {
+    for (std::size_t i = 1; i <= n; ++i)
+      zetan += 1.0 / std::pow(double(i), theta);
+    double zeta2 = 1.0 + 1.0 / std::pow(2.0, theta);
+    alpha = 1.0 / (1.0 - theta);
+    eta = (1.0 - std::pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / zetan);
+  }
+  template <typename Rng> std::size_t operator()(Rng &rng) {
+    double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+    double uz = u * zetan;
+    if (uz < 1.0)
+      return 0;
+    if (uz < 1.0 + std::pow(0.5, theta))
+      return 1;
+    auto rank = std::size_t(n * std::pow(eta * u - eta + 1.0, alpha));
+    return std::min(rank, n - 1);
+  }
+
+private:
+  std::size_t n;
+  double theta, zetan{0}, alpha, eta;
+};
+
+// Stored keys are 2i, misses 2i+1. `order` is the insert/delete order,
+// `hits`/`misses` the lookup streams, `mixed`/`dice` the mixed operands.
+struct Workload {
+  std::vector<int> order, hits, misses, mixed;
+  std::vector<unsigned char> dice; // 0 insert, 1 delete, else lookup
+};
+
+Workload makeWorkload(Pattern pattern, std::size_t n, std::size_t queries) {
+  std::mt19937_64 rng(42);
+  Workload w;
+  w.order.resize(n);
+  for (std::size_t i = 0; i < n; ++i)
+    w.order[i] = int(2 * i);
+  if (pattern != Pattern::Sequential)
+    std::shuffle(w.order.begin(), w.order.end(), rng);
+
+  // rank -> key; for Zipf the hot ranks land on scattered keys
+  std::vector<int> byRank = w.order;
+  Zipf zipf(pattern == Pattern::Zipf ? n : 1, 0.99);
+  auto draw = [&](std::size_t i) -> std::size_t {
+    switch (pattern) {
+    case Pattern::Sequential:
+      return i % n;
+    case Pattern::Zipf:
+      return zipf(rng);
+    default:
+      return rng() % n;
+    }
+  };
+  w.hits.reserve(queries);
+  w.misses.reserve(queries);
+  w.mixed.reserve(queries);
+  w.dice.reserve(queries);
+  for (std::size_t i = 0; i < queries; ++i) {
+    std::size_t r = draw(i);
+    w.hits.push_back(pattern == Pattern::Sequential ? int(2 * r) : byRank[r]);
+  }
+  for (int k : w.hits)
+    w.misses.push_back(k + 1);
+  for (std::size_t i = 0; i < queries; ++i) { // 2n slots, half stored
+    w.mixed.push_back(w.hits[i] + int(rng() & 1));
+    w.dice.push_back((unsigned char)(rng() % 10));
+  }
+  return w;
+}
+
+//-------------------------------------------------------------------------------
+//                                   Timing
+//-------------------------------------------------------------------------------
+
+using Clock = std::chrono::steady_clock;
+
+// Per-workload accumulator. Small n repeats the insert/delete cycle on a
+// fresh structure until about `queries` operations were timed, so short
+// phases are not at the mercy of a single preemption.
+struct Stats {
+  std::vector<double> samples; // ns, every 16th operation
+  double seconds{0};
+  std::size_t ops{0};
+  bool latency{true};
+
+  double percentile(double q) {
+    auto it = samples.begin() + std::size_t(q * (samples.size() - 1));
+    std::nth_element(samples.begin(), it, samples.end());
+    return *it;
+  }
+};
+
+// run op(i) for i in [0, count), timing every 16th call on its own
+template <typename Op> void measure(Stats &stats, std::size_t count, Op &&op) {
+  auto start = Clock::now();
+  for (std::size_t i = 0; i < count; ++i) {
+    if (i % 16 == 0) {
+      auto t0 = Clock::now();
+      op(i);
+      stats.samples.push_back(
+          std::chrono::duration<double, std::nano>(Clock::now() - t0).count());
+    } else {
+      op(i);
+    }
+  }
+  stats.seconds += std::chrono::duration<double>(Clock::now() - start).count();
+  stats.ops += count;
+}
+
+void report(const char *structure, const char *workload, Stats &stats) {
+  double mops = stats.ops / stats.seconds / 1e6;
+  if (stats.latency && !stats.samples.empty())
+    std::printf("  %-9s %-12s %9.2f %9.0f %9.0f\n", structure, workload, mops,
+                stats.percentile(0.50), stats.percentile(0.99));
+  else
+    std::printf("  %-9s %-12s %9.2f %9s %9s\n", structure, workload, mops, "-",
+                "-");
+}
+
+volatile long sink; // keeps lookups and scans from being optimised away
+
+// returns an error string if the structure misbehaved
+template <typename S> std::string run(const Workload &w) {
+  std::size_t n = w.order.size(), q = w.hits.size();
+  std::size_t reps = std::max<std::size_t>(1, q / n);
+  Stats insert, hit, miss, scan, erase, mixed;
+  double perKey = 0;
+  long hits = 0;
+
+  for (std::size_t rep = 0; rep < reps; ++rep) {
+    auto *s = new S;
+    std::size_t before = heapBytes;
+    measure(insert, n, [&](std::size_t i) { s->insert(w.order[i]); });
+    if (rep == 0) {
+      perKey = double(heapBytes - before) / n;
+      // a structure that really frees its pooled nodes would reuse blocks
+      // from earlier runs unseen by heapBytes; such ones report themselves
+      if constexpr (requires { s->bytes(); })
+        perKey = double(s->bytes()) / n;
+      if (std::string bad = s->health(n); !bad.empty()) {
+        std::printf("  %-9s %s\n", S::name, bad.c_str());
+        return bad; // leaked on purpose, its links may not be sound
+      }
+    }
+    if (rep + 1 == reps) { // the last copy serves the read workloads
+      measure(hit, q, [&](std::size_t i) { hits += s->contains(w.hits[i]); });
+      measure(miss, q,
+              [&](std::size_t i) { hits += s->contains(w.misses[i]); });
+      scan.latency = false;
+      measure(scan, reps, [&](std::size_t) { sink = s->scan(); });
+      scan.ops = reps * n; // count keys visited, not scans
+    }
+    measure(erase, n, [&](std::size_t i) { s->erase(w.order[i]); });
+    delete s;
+  }
+
+  {
+    S s;
+    for (int k : w.order)
+      s.insert(k);
+    measure(mixed, q, [&](std::size_t i) {
+      int k = w.mixed[i];
+      unsigned dice = w.dice[i];
+      bool present = s.contains(k);
+      hits += present;
+      if (dice == 0 && !present)
+        s.insert(k);
+      else if (dice == 1 && present)
+        s.erase(k);
+    });
+  }
+  sink = hits;
+
+  report(S::name, "insert", insert);
+  report(S::name, "lookup-hit", hit);
+  report(S::name, "lookup-miss", miss);
+  report(S::name, "scan", scan);
+  report(S::name, "delete", erase);
+  report(S::name, "mixed 80/10", mixed);
+  std::printf("  %-9s %-12s %9.1f\n", S::name, "bytes/key", perKey);
+  return {};
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  int maxExp = argc > 1 ? std::atoi(argv[1]) : 6;
+  int minExp = argc > 2 ? std::atoi(argv[2]) : 3;
+
+  const Pattern patterns[] = {Pattern::Uniform, Pattern::Sequential,
+                              Pattern::Zipf};
+  // a structure that failed at some n is not run at larger n of that pattern
+  std::map<std::string, std::string> failed;
+
+  for (Pattern pattern : patterns) {
+    for (int e = minExp; e <= maxExp; ++e) {
+      auto n = std::size_t(std::pow(10.0, e));
+      std::size_t queries = std::max<std::size_t>(n, 1 << 20);
+      Workload w = makeWorkload(pattern, n, queries);
+
+      std::printf("\nn=10^%d pattern=%s queries=%zu\n", e, patternName(pattern),
+                  queries);
+      std::printf("  %-9s %-12s %9s %9s %9s\n", "structure", "workload",
+                  "Mops/s", "p50 ns", "p99 ns");
+
+      auto go = [&](auto tag) {
+        using S = decltype(tag);
+        std::string key = std::string(S::name) + patternName(pattern);
+        if (failed.count(key)) {
+          std::printf("  %-9s skipped, %s\n", S::name, failed[key].c_str());
+          return;
+        }
+        std::string bad = run<S>(w);
+        if (!bad.empty())
+          failed[key] = bad + " at 10^" + std::to_string(e);
+      };
+      go(StdSet{});
+      go(StdMap{});
+      go(BST{});
+      go(AVL{});
+      go(RBT{});
+      go(SGT{});
+    }
+  }
+  return 0;
+}
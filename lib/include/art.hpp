@@ -0,0 +1,847 @@
+#pragma once
+
+#include "bits.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <optional>
+#include <type_traits>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace ART {
+
+//-------------------------------------------------------------------------------
+//                             Adaptive Radix Tree
+//-------------------------------------------------------------------------------
+
+// Radix tree over the big-endian bytes of an integer key (sign bit flipped
+// for signed types, so byte order equals numeric order). Inner nodes grow
+// and shrink between four layouts:
+//   Node4   up to  4 children, sorted key bytes
+//   Node16  up to 16 children, sorted key bytes, SSE2 lookup
+//   Node48  up to 48 children, 256-entry byte -> slot index
+//   Node256 up to 256 children, direct array
+// Common key bytes below a node are stored in its prefix (path compression),
+// and a subtree with a single key collapses into a leaf (lazy expansion).
+//
+// Child slots are tagged words: 0 is empty, an odd value is a leaf. Keys
+// narrower than a pointer live directly in the leaf word; wider keys point
+// to a heap leaf.
+//
+// Not a drop-in for TREE::AVLTree: there are no nodes to hand out, so the
+// interface is the one VEB shares. search() answers bool, insert() and
+// remove() report whether the set changed, and minimum(), maximum(),
+// successor() and predecessor() return std::optional<Key> where the trees
+// return a possibly null node. Porting AVLTree<int> code means replacing
+// `search(k) != nullptr` with `search(k)` and `node->key` with `*key`.
+
+template <Integer Key> class AdaptiveRadixTree {
+public:
+  AdaptiveRadixTree() = default;
+  AdaptiveRadixTree(std::initializer_list<Key> list);
+  ~AdaptiveRadixTree();
+
+  AdaptiveRadixTree(const AdaptiveRadixTree &) = delete;
+  AdaptiveRadixTree &operator=(const AdaptiveRadixTree &) = delete;
+
+  bool insert(Key key);
+  bool search(Key key) const;
+  bool remove(Key key);
+
+  std::optional<Key> minimum() const;
+  std::optional<Key> maximum() const;
+  std::optional<Key> successor(Key key) const;   // smallest key > key
+  std::optional<Key> predecessor(Key key) const; // largest key < key
+
+  // in-order visit of every key
+  template <typename Fn> void forEach(Fn &&fn) const;
+
+  std::size_t size() const { return count; }
+  std::size_t memoryUsage() const; // bytes held by inner nodes and leaves
+
+private:
+  using UKey = std::make_unsigned_t<Key>;
+  using Ref = std::uintptr_t;
+
+  static constexpr int KEY_BYTES = sizeof(Key);
+  static constexpr bool INLINE_LEAF = sizeof(Key) < sizeof(Ref);
+
+  enum Type : std::uint8_t { NODE4, NODE16, NODE48, NODE256 };
+
+  struct Inner {
+    Type type;
+    std::uint8_t prefixLen{0};
+    std::uint16_t children{0};
+    std::uint8_t prefix[8]{};
+  };
+  struct Node4 : Inner {
+    std::uint8_t keys[4]{};
+    Ref child[4]{};
+  };
+  struct Node16 : Inner {
+    std::uint8_t keys[16]{};
+    Ref child[16]{};
+  };
+  struct Node48 : Inner {
+    std::uint8_t index[256]{}; // slot + 1, 0 = empty
+    Ref child[48]{};
+  };
+  struct Node256 : Inner {
+    Ref child[256]{};
+  };
+  struct Leaf {
+    UKey key;
+  };
+
+  Ref root{0};
+  std::size_t count{0};
+
+  // key encoding
+  static UKey encode(Key key);
+  static Key decode(UKey u);
+  static std::uint8_t byteAt(UKey u, int depth);
+
+  // tagged words
+  static bool isLeaf(Ref r) { return r & 1; }
+  static Inner *inner(Ref r) { return reinterpret_cast<Inner *>(r); }
+  static Ref makeLeaf(UKey u);
+  static UKey leafKey(Ref r);
+  static void freeLeaf(Ref r);
+
+  // inner nodes
+  template <typename N> static N *make(Type type);
+  static Ref *findChild(Inner *node, std::uint8_t byte);
+  static const Ref *findChild(const Inner *node, std::uint8_t byte);
+  static void addChild(Ref &ref, Inner *node, std::uint8_t byte, Ref child);
+  static void removeChild(Ref &ref, Inner *node, std::uint8_t byte);
+  static int prefixMismatch(const Inner *node, UKey u, int depth);
+
+  // first/last/next child by byte order
+  template <typename Fn> static void eachChild(const Inner *node, Fn &&fn);
+  static Ref minChild(const Inner *node);
+  static Ref maxChild(const Inner *node);
+  static std::optional<UKey> minLeaf(Ref r);
+  static std::optional<UKey> maxLeaf(Ref r);
+  static std::optional<UKey> successorIn(Ref r, UKey u, int depth);
+  static std::optional<UKey> predecessorIn(Ref r, UKey u, int depth);
+
+  bool insertAt(Ref &ref, UKey u, int depth);
+  bool removeAt(Ref &ref, UKey u, int depth);
+  static void destroy(Ref r);
+  static std::size_t bytes(Ref r);
+};
+
+//-------------------------------------------------------------------------------
+//                     Encoding / Tagged Slot Implementation
+//-------------------------------------------------------------------------------
+
+template <Integer Key>
+typename AdaptiveRadixTree<Key>::UKey AdaptiveRadixTree<Key>::encode(Key key) {
+  UKey u = static_cast<UKey>(key);
+  if constexpr (std::is_signed_v<Key>)
+    u ^= UKey(1) << (KEY_BYTES * 8 - 1);
+  return u;
+}
+
+template <Integer Key> Key AdaptiveRadixTree<Key>::decode(UKey u) {
+  if constexpr (std::is_signed_v<Key>)
+    u ^= UKey(1) << (KEY_BYTES * 8 - 1);
+  return static_cast<Key>(u);
+}
+
+template <Integer Key>
+std::uint8_t AdaptiveRadixTree<Key>::byteAt(UKey u, int depth) {
+  return static_cast<std::uint8_t>(u >> (8 * (KEY_BYTES - 1 - depth)));
+}
+
+template <Integer Key>
+typename AdaptiveRadixTree<Key>::Ref AdaptiveRadixTree<Key>::makeLeaf(UKey u) {
+  if constexpr (INLINE_LEAF)
+    return (static_cast<Ref>(u) << 1) | 1;
+  else
+    return reinterpret_cast<Ref>(new Leaf{u}) | 1;
+}
+
+template <Integer Key>
+typename AdaptiveRadixTree<Key>::UKey AdaptiveRadixTree<Key>::leafKey(Ref r) {
+  if constexpr (INLINE_LEAF)
+    return static_cast<UKey>(r >> 1);
+  else
+    return reinterpret_cast<const Leaf *>(r & ~Ref(1))->key;
+}
+
+template <Integer Key> void AdaptiveRadixTree<Key>::freeLeaf(Ref r) {
+  if constexpr (!INLINE_LEAF)
+    delete reinterpret_cast<Leaf *>(r & ~Ref(1));
+}
+
+//-------------------------------------------------------------------------------
+//                           Inner Node Implementation
+//-------------------------------------------------------------------------------
+
+template <Integer Key>
+template <typename N>
+N *AdaptiveRadixTree<Key>::make(Type type) {
+  N *node = new N();
+  node->type = type;
+  return node;
+}
+
+template <Integer Key>
+const typename AdaptiveRadixTree<Key>::Ref *
+AdaptiveRadixTree<Key>::findChild(const Inner *node, std::uint8_t byte) {
+  switch (node->type) {
+  case NODE4: {
+    auto *n = static_cast<const Node4 *>(node);
+    for (int i = 0; i < n->children; ++i)
+      if (n->keys[i] == byte)
+        return &n->child[i];
+    return nullptr;
+  }
+  case NODE16: {
+    auto *n = static_cast<const Node16 *>(node);
+#if defined(__SSE2__)
+    __m128i cmp = _mm_cmpeq_epi8(
+        _mm_set1_epi8(static_cast<char>(byte)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(n->keys)));
+    unsigned mask = _mm_movemask_epi8(cmp) & ((1u << n->children) - 1);
+    return mask ? &n->child[__builtin_ctz(mask)] : nullptr;
+#else
+    for (int i = 0; i < n->children; ++i)
+      if (n->keys[i] == byte)
+        return &n->child[i];
+    return nullptr;
+#endif
+  }
+  case NODE48: {
+    auto *n = static_cast<const Node48 *>(node);
+    return n->index[byte] ? &n->child[n->index[byte] - 1] : nullptr;
+  }
+  default: {
+    auto *n = static_cast<const Node256 *>(node);
+    return n->child[byte] ? &n->child[byte] : nullptr;
+  }
+  }
+}
+
+template <Integer Key>
+typename AdaptiveRadixTree<Key>::Ref *
+AdaptiveRadixTree<Key>::findChild(Inner *node, std::uint8_t byte) {
+  return const_cast<Ref *>(findChild(static_cast<const Inner *>(node), byte));
+}
+
+// Insert `child` under `byte`, growing the node (and rewriting `ref`, the
+// slot pointing at it) when it is full.
+template <Integer Key>
+void AdaptiveRadixTree<Key>::addChild(Ref &ref, Inner *node, std::uint8_t byte,
+                                      Ref child) {
+  switch (node->type) {
+  case NODE4: {
+    auto *n = static_cast<Node4 *>(node);
+    if (n->children < 4) {
+      int pos = 0;
+      while (pos < n->children && n->keys[pos] < byte)
+        ++pos;
+      std::memmove(n->keys + pos + 1, n->keys + pos, n->children - pos);
+      std::memmove(n->child + pos + 1, n->child + pos,
+                   (n->children - pos) * sizeof(Ref));
+      n->keys[pos] = byte;
+      n->child[pos] = child;
+      ++n->children;
+      return;
+    }
+    auto *grown = make<Node16>(NODE16);
+    std::memcpy(grown->prefix, n->prefix, 8);
+    grown->prefixLen = n->prefixLen;
+    grown->children = 4;
+    std::memcpy(grown->keys, n->keys, 4);
+    std::memcpy(grown->child, n->child, 4 * sizeof(Ref));
+    delete n;
+    ref = reinterpret_cast<Ref>(static_cast<Inner *>(grown));
+    addChild(ref, grown, byte, child);
+    return;
+  }
+  case NODE16: {
+    auto *n = static_cast<Node16 *>(node);
+    if (n->children < 16) {
+      int pos = 0;
+      while (pos < n->children && n->keys[pos] < byte)
+        ++pos;
+      std::memmove(n->keys + pos + 1, n->keys + pos, n->children - pos);
+      std::memmove(n->child + pos + 1, n->child + pos,
+                   (n->children - pos) * sizeof(Ref));
+      n->keys[pos] = byte;
+      n->child[pos] = child;
+      ++n->children;
+      return;
+    }
+    auto *grown = make<Node48>(NODE48);
+    std::memcpy(grown->prefix, n->prefix, 8);
+    grown->prefixLen = n->prefixLen;
+    grown->children = 16;
+    for (int i = 0; i < 16; ++i) {
+      grown->child[i] = n->child[i];
+      grown->index[n->keys[i]] = static_cast<std::uint8_t>(i + 1);
+    }
+    delete n;
+    ref = reinterpret_cast<Ref>(static_cast<Inner *>(grown));
+    addChild(ref, grown, byte, child);
+    return;
+  }
+  case NODE48: {
+    auto *n = static_cast<Node48 *>(node);
+    if (n->children < 48) {
+      int slot = 0;
+      while (n->child[slot])
+        ++slot;
+      n->child[slot] = child;
+      n->index[byte] = static_cast<std::uint8_t>(slot + 1);
+      ++n->children;
+      return;
+    }
+    auto *grown = make<Node256>(NODE256);
+    std::memcpy(grown->prefix, n->prefix, 8);
+    grown->prefixLen = n->prefixLen;
+    grown->children = 48;
+    for (int b = 0; b < 256; ++b)
+      if (n->index[b])
+        grown->child[b] = n->child[n->index[b] - 1];
+    delete n;
+    ref = reinterpret_cast<Ref>(static_cast<Inner *>(grown));
+    addChild(ref, grown, byte, child);
+    return;
+  }
+  default: {
+    auto *n = static_cast<Node256 *>(node);
+    n->child[byte] = child;
+    ++n->children;
+    return;
+  }
+  }
+}
+
+// Drop the entry for `byte` and shrink the node once it is sparse enough.
+// A Node4 left with one child is folded into that child (or replaced by it,
+// if it is a leaf).
+template <Integer Key>
+void AdaptiveRadixTree<Key>::removeChild(Ref &ref, Inner *node,
+                                         std::uint8_t byte) {
+  switch (node->type) {
+  case NODE4: {
+    auto *n = static_cast<Node4 *>(node);
+    int pos = 0;
+    while (n->keys[pos] != byte)
+      ++pos;
+    std::memmove(n->keys + pos, n->keys + pos + 1, n->children - pos - 1);
+    std::memmove(n->child + pos, n->child + pos + 1,
+                 (n->children - pos - 1) * sizeof(Ref));
+    --n->children;
+
+    if (n->children == 1) {
+      Ref only = n->child[0];
+      if (!isLeaf(only)) {
+        // merge prefixes: ours + the edge byte + the child's
+        Inner *c = inner(only);
+        std::uint8_t merged[8];
+        int len = 0;
+        for (int i = 0; i < n->prefixLen; ++i)
+          merged[len++] = n->prefix[i];
+        merged[len++] = n->keys[0];
+        for (int i = 0; i < c->prefixLen; ++i)
+          merged[len++] = c->prefix[i];
+        std::memcpy(c->prefix, merged, len);
+        c->prefixLen = static_cast<std::uint8_t>(len);
+      }
+      delete n;
+      ref = only;
+    }
+    return;
+  }
+  case NODE16: {
+    auto *n = static_cast<Node16 *>(node);
+    int pos = 0;
+    while (n->keys[pos] != byte)
+      ++pos;
+    std::memmove(n->keys + pos, n->keys + pos + 1, n->children - pos - 1);
+    std::memmove(n->child + pos, n->child + pos + 1,
+                 (n->children - pos - 1) * sizeof(Ref));
+    --n->children;
+
+    if (n->children == 3) {
+      auto *shrunk = make<Node4>(NODE4);
+      std::memcpy(shrunk->prefix, n->prefix, 8);
+      shrunk->prefixLen = n->prefixLen;
+      shrunk->children = 3;
+      std::memcpy(shrunk->keys, n->keys, 3);
+      std::memcpy(shrunk->child, n->child, 3 * sizeof(Ref));
+      delete n;
+      ref = reinterpret_cast<Ref>(static_cast<Inner *>(shrunk));
+    }
+    return;
+  }
+  case NODE48: {
+    auto *n = static_cast<Node48 *>(node);
+    n->child[n->index[byte] - 1] = 0;
+    n->index[byte] = 0;
+    --n->children;
+
+    if (n->children == 12) {
+      auto *shrunk = make<Node16>(NODE16);
+      std::memcpy(shrunk->prefix, n->prefix, 8);
+      shrunk->prefixLen = n->prefixLen;
+      for (int b = 0; b < 256; ++b) {
+        if (n->index[b]) {
+          shrunk->keys[shrunk->children] = static_cast<std::uint8_t>(b);
+          shrunk->child[shrunk->children++] = n->child[n->index[b] - 1];
+        }
+      }
+      delete n;
+      ref = reinterpret_cast<Ref>(static_cast<Inner *>(shrunk));
+    }
+    return;
+  }
+  default: {
+    auto *n = static_cast<Node256 *>(node);
+    n->child[byte] = 0;
+    --n->children;
+
+    if (n->children == 37) {
+      auto *shrunk = make<Node48>(NODE48);
+      std::memcpy(shrunk->prefix, n->prefix, 8);
+      shrunk->prefixLen = n->prefixLen;
+      for (int b = 0; b < 256; ++b) {
+        if (n->child[b]) {
+          shrunk->child[shrunk->children] = n->child[b];
+          shrunk->index[b] = static_cast<std::uint8_t>(++shrunk->children);
+        }
+      }
+      delete n;
+      ref = reinterpret_cast<Ref>(static_cast<Inner *>(shrunk));
+    }
+    return;
+  }
+  }
+}
+
+// index of the first prefix byte that differs from the key, or prefixLen
+template <Integer Key>
+int AdaptiveRadixTree<Key>::prefixMismatch(const Inner *node, UKey u,
+                                           int depth) {
+  for (int i = 0; i < node->prefixLen; ++i)
+    if (node->prefix[i] != byteAt(u, depth + i))
+      return i;
+  return node->prefixLen;
+}
+
+template <Integer Key>
+template <typename Fn>
+void AdaptiveRadixTree<Key>::eachChild(const Inner *node, Fn &&fn) {
+  switch (node->type) {
+  case NODE4: {
+    auto *n = static_cast<const Node4 *>(node);
+    for (int i = 0; i < n->children; ++i)
+      if (!fn(n->keys[i], n->child[i]))
+        return;
+    return;
+  }
+  case NODE16: {
+    auto *n = static_cast<const Node16 *>(node);
+    for (int i = 0; i < n->children; ++i)
+      if (!fn(n->keys[i], n->child[i]))
+        return;
+    return;
+  }
+  case NODE48: {
+    auto *n = static_cast<const Node48 *>(node);
+    for (int b = 0; b < 256; ++b)
+      if (n->index[b] && !fn(std::uint8_t(b), n->child[n->index[b] - 1]))
+        return;
+    return;
+  }
+  default: {
+    auto *n = static_cast<const Node256 *>(node);
+    for (int b = 0; b < 256; ++b)
+      if (n->child[b] && !fn(std::uint8_t(b), n->child[b]))
+        return;
+    return;
+  }
+  }
+}
+
+template <Integer Key>
+typename AdaptiveRadixTree<Key>::Ref
+AdaptiveRadixTree<Key>::minChild(const Inner *node) {
+  Ref found = 0;
+  eachChild(node, [&](std::uint8_t, Ref c) {
+    found = c;
+    return false;
+  });
+  return found;
+}
+
+template <Integer Key>
+typename AdaptiveRadixTree<Key>::Ref
+AdaptiveRadixTree<Key>::maxChild(const Inner *node) {
+  switch (node->type) {
+  case NODE4:
+    return static_cast<const Node4 *>(node)->child[node->children - 1];
+  case NODE16:
+    return static_cast<const Node16 *>(node)->child[node->children - 1];
+  case NODE48: {
+    auto *n = static_cast<const Node48 *>(node);
+    for (int b = 255; b >= 0; --b)
+      if (n->index[b])
+        return n->child[n->index[b] - 1];
+    return 0;
+  }
+  default: {
+    auto *n = static_cast<const Node256 *>(node);
+    for (int b = 255; b >= 0; --b)
+      if (n->child[b])
+        return n->child[b];
+    return 0;
+  }
+  }
+}
+
+template <Integer Key>
+std::optional<typename AdaptiveRadixTree<Key>::UKey>
+AdaptiveRadixTree<Key>::minLeaf(Ref r) {
+  while (r && !isLeaf(r))
+    r = minChild(inner(r));
+  if (!r)
+    return std::nullopt;
+  return leafKey(r);
+}
+
+template <Integer Key>
+std::optional<typename AdaptiveRadixTree<Key>::UKey>
+AdaptiveRadixTree<Key>::maxLeaf(Ref r) {
+  while (r && !isLeaf(r))
+    r = maxChild(inner(r));
+  if (!r)
+    return std::nullopt;
+  return leafKey(r);
+}
+
+template <Integer Key>
+std::optional<typename AdaptiveRadixTree<Key>::UKey>
+AdaptiveRadixTree<Key>::successorIn(Ref r, UKey u, int depth) {
+  if (!r)
+    return std::nullopt;
+  if (isLeaf(r)) {
+    UKey k = leafKey(r);
+    if (k > u)
+      return k;
+    return std::nullopt;
+  }
+
+  const Inner *node = inner(r);
+  int p = prefixMismatch(node, u, depth);
+  if (p < node->prefixLen) {
+    // the whole subtree is either above or below the key
+    if (node->prefix[p] > byteAt(u, depth + p))
+      return minLeaf(r);
+    return std::nullopt;
+  }
+  depth += node->prefixLen;
+
+  std::uint8_t b = byteAt(u, depth);
+  std::optional<UKey> found;
+  eachChild(node, [&](std::uint8_t cb, Ref c) {
+    if (cb == b)
+      found = successorIn(c, u, depth + 1);
+    else if (cb > b)
+      found = minLeaf(c);
+    return !found;
+  });
+  return found;
+}
+
+template <Integer Key>
+std::optional<typename AdaptiveRadixTree<Key>::UKey>
+AdaptiveRadixTree<Key>::predecessorIn(Ref r, UKey u, int depth) {
+  if (!r)
+    return std::nullopt;
+  if (isLeaf(r)) {
+    UKey k = leafKey(r);
+    if (k < u)
+      return k;
+    return std::nullopt;
+  }
+
+  const Inner *node = inner(r);
+  int p = prefixMismatch(node, u, depth);
+  if (p < node->prefixLen) {
+    // the whole subtree is either above or below the key
+    if (node->prefix[p] < byteAt(u, depth + p))
+      return maxLeaf(r);
+    return std::nullopt;
+  }
+  depth += node->prefixLen;
+
+  // children come in ascending byte order: remember the last one below the
+  // key's byte, in case the key's own child holds nothing smaller
+  std::uint8_t b = byteAt(u, depth);
+  Ref below = 0;
+  std::optional<UKey> found;
+  eachChild(node, [&](std::uint8_t cb, Ref c) {
+    if (cb < b)
+      below = c;
+    else if (cb == b)
+      found = predecessorIn(c, u, depth + 1);
+    return cb < b;
+  });
+  return found ? found : maxLeaf(below);
+}
+
+//-------------------------------------------------------------------------------
+//                         AdaptiveRadixTree Implementation
+//-------------------------------------------------------------------------------
+
+template <Integer Key>
+AdaptiveRadixTree<Key>::AdaptiveRadixTree(std::initializer_list<Key> list) {
+  for (Key key : list)
+    insert(key);
+}
+
+template <Integer Key> AdaptiveRadixTree<Key>::~AdaptiveRadixTree() {
+  destroy(root);
+}
+
+template <Integer Key> void AdaptiveRadixTree<Key>::destroy(Ref r) {
+  if (!r)
+    return;
+  if (isLeaf(r)) {
+    freeLeaf(r);
+    return;
+  }
+  Inner *node = inner(r);
+  eachChild(node, [](std::uint8_t, Ref c) {
+    destroy(c);
+    return true;
+  });
+  switch (node->type) {
+  case NODE4:
+    delete static_cast<Node4 *>(node);
+    break;
+  case NODE16:
+    delete static_cast<Node16 *>(node);
+    break;
+  case NODE48:
+    delete static_cast<Node48 *>(node);
+    break;
+  default:
+    delete static_cast<Node256 *>(node);
+    break;
+  }
+}
+
+template <Integer Key> std::size_t AdaptiveRadixTree<Key>::bytes(Ref r) {
+  if (!r)
+    return 0;
+  if (isLeaf(r))
+    return INLINE_LEAF ? 0 : sizeof(Leaf);
+
+  const Inner *node = inner(r);
+  std::size_t total = 0;
+  switch (node->type) {
+  case NODE4:
+    total = sizeof(Node4);
+    break;
+  case NODE16:
+    total = sizeof(Node16);
+    break;
+  case NODE48:
+    total = sizeof(Node48);
+    break;
+  default:
+    total = sizeof(Node256);
+    break;
+  }
+  eachChild(node, [&](std::uint8_t, Ref c) {
+    total += bytes(c);
+    return true;
+  });
+  return total;
+}
+
+template <Integer Key>
+std::size_t AdaptiveRadixTree<Key>::memoryUsage() const {
+  return bytes(root);
+}
+
+template <Integer Key>
+bool AdaptiveRadixTree<Key>::insertAt(Ref &ref, UKey u, int depth) {
+  if (!ref) {
+    ref = makeLeaf(u);
+    return true;
+  }
+
+  if (isLeaf(ref)) {
+    UKey other = leafKey(ref);
+    if (other == u)
+      return false;
+    // lazy expansion: split the leaf into a Node4 over their common bytes
+    auto *node = make<Node4>(NODE4);
+    while (byteAt(u, depth) == byteAt(other, depth))
+      node->prefix[node->prefixLen++] = byteAt(u, depth++);
+    Ref self = reinterpret_cast<Ref>(static_cast<Inner *>(node));
+    addChild(self, node, byteAt(other, depth), ref);
+    addChild(self, node, byteAt(u, depth), makeLeaf(u));
+    ref = self;
+    return true;
+  }
+
+  Inner *node = inner(ref);
+  int p = prefixMismatch(node, u, depth);
+  if (p < node->prefixLen) {
+    // the key leaves the compressed path: split it at the mismatch
+    auto *split = make<Node4>(NODE4);
+    split->prefixLen = static_cast<std::uint8_t>(p);
+    std::memcpy(split->prefix, node->prefix, p);
+
+    std::uint8_t edge = node->prefix[p];
+    node->prefixLen = static_cast<std::uint8_t>(node->prefixLen - p - 1);
+    std::memmove(node->prefix, node->prefix + p + 1, node->prefixLen);
+
+    Ref self = reinterpret_cast<Ref>(static_cast<Inner *>(split));
+    addChild(self, split, edge, ref);
+    addChild(self, split, byteAt(u, depth + p), makeLeaf(u));
+    ref = self;
+    return true;
+  }
+  depth += node->prefixLen;
+
+  std::uint8_t b = byteAt(u, depth);
+  if (Ref *child = findChild(node, b))
+    return insertAt(*child, u, depth + 1);
+  addChild(ref, node, b, makeLeaf(u));
+  return true;
+}
+
+template <Integer Key>
+bool AdaptiveRadixTree<Key>::removeAt(Ref &ref, UKey u, int depth) {
+  Inner *node = inner(ref);
+  if (prefixMismatch(node, u, depth) < node->prefixLen)
+    return false;
+  depth += node->prefixLen;
+
+  std::uint8_t b = byteAt(u, depth);
+  Ref *child = findChild(node, b);
+  if (!child)
+    return false;
+
+  if (isLeaf(*child)) {
+    if (leafKey(*child) != u)
+      return false;
+    freeLeaf(*child);
+    removeChild(ref, node, b);
+    return true;
+  }
+  return removeAt(*child, u, depth + 1);
+}
+
+template <Integer Key> bool AdaptiveRadixTree<Key>::insert(Key key) {
+  if (!insertAt(root, encode(key), 0))
+    return false;
+  ++count;
+  return true;
+}
+
+template <Integer Key> bool AdaptiveRadixTree<Key>::search(Key key) const {
+  UKey u = encode(key);
+  Ref r = root;
+  int depth = 0;
+  while (r) {
+    if (isLeaf(r))
+      return leafKey(r) == u;
+    const Inner *node = inner(r);
+    // prefix bytes are checked by the final leaf comparison; skip them
+    depth += node->prefixLen;
+    const Ref *child = findChild(node, byteAt(u, depth++));
+    r = child ? *child : 0;
+  }
+  return false;
+}
+
+template <Integer Key> bool AdaptiveRadixTree<Key>::remove(Key key) {
+  UKey u = encode(key);
+  bool removed;
+  if (!root)
+    return false;
+  if (isLeaf(root)) {
+    removed = leafKey(root) == u;
+    if (removed) {
+      freeLeaf(root);
+      root = 0;
+    }
+  } else {
+    removed = removeAt(root, u, 0);
+  }
+  if (removed)
+    --count;
+  return removed;
+}
+
+template <Integer Key>
+std::optional<Key> AdaptiveRadixTree<Key>::minimum() const {
+  auto u = minLeaf(root);
+  return u ? std::optional<Key>(decode(*u)) : std::nullopt;
+}
+
+template <Integer Key>
+std::optional<Key> AdaptiveRadixTree<Key>::maximum() const {
+  auto u = maxLeaf(root);
+  return u ? std::optional<Key>(decode(*u)) : std::nullopt;
+}
+
+template <Integer Key>
+std::optional<Key> AdaptiveRadixTree<Key>::successor(Key key) const {
+  auto u = successorIn(root, encode(key), 0);
+  return u ? std::optional<Key>(decode(*u)) : std::nullopt;
+}
+
+template <Integer Key>
+std::optional<Key> AdaptiveRadixTree<Key>::predecessor(Key key) const {
+  auto u = predecessorIn(root, encode(key), 0);
+  return u ? std::optional<Key>(decode(*u)) : std::nullopt;
+}
+
+template <Integer Key>
+template <typename Fn>
+void AdaptiveRadixTree<Key>::forEach(Fn &&fn) const {
+  // depth is bounded by the key width, so a fixed stack suffices
+  struct Frame {
+    Ref ref;
+  };
+  Frame stack[KEY_BYTES * 256];
+  int top = 0;
+  if (root)
+    stack[top++] = {root};
+
+  while (top > 0) {
+    Ref r = stack[--top].ref;
+    if (isLeaf(r)) {
+      fn(decode(leafKey(r)));
+      continue;
+    }
+    // push children largest first so the smallest is visited next
+    const Inner *node = inner(r);
+    int first = top;
+    eachChild(node, [&](std::uint8_t, Ref c) {
+      stack[top++] = {c};
+      return true;
+    });
+    for (int i = first, j = top - 1; i < j; ++i, --j) {
+      Frame tmp = stack[i];
+      stack[i] = stack[j];
+      stack[j] = tmp;
+    }
+  }
+}
+
+} // namespace ART
@@ -0,0 +1,469 @@
+#pragma once
+
+#include "node.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace BETREE {
+
+//-------------------------------------------------------------------------------
+//                          Buffered (B-epsilon) Tree
+//-------------------------------------------------------------------------------
+
+// Write-optimised ordered set. Inserts and removes are not applied at the
+// leaves right away: they become messages in the root's buffer, and when a
+// buffer overflows the biggest batch bound for one child is pushed down in
+// a single step. The cost of walking to a leaf, and of any splits, is
+// therefore shared by every message in the batch.
+//
+// Each buffer stays sorted and holds at most one message per key (a newer
+// message replaces an older one), so a lookup binary-searches the buffer at
+// every level on its way down. The first message it finds is the newest
+// word on that key.
+//
+// successor() and minimum() flush only the root-to-leaf path they read
+// (and the next one over when that leaf has nothing above the key);
+// forEach() visits everything and so flushes every buffer first.
+
+template <KeyComparble Key> class BufferedTree {
+public:
+  explicit BufferedTree(std::size_t leafCapacity = 128,
+                        std::size_t fanout = 16,
+                        std::size_t bufferCapacity = 512);
+  BufferedTree(std::initializer_list<Key> list);
+  ~BufferedTree();
+
+  BufferedTree(const BufferedTree &) = delete;
+  BufferedTree &operator=(const BufferedTree &) = delete;
+
+  void insert(const Key &key);
+  void remove(const Key &key);
+  bool search(const Key &key) const;
+
+  std::optional<Key> minimum();
+  std::optional<Key> successor(const Key &key); // smallest key > key
+  template <typename Fn> void forEach(Fn &&fn);
+
+  void flush(); // push every pending message down to the leaves
+
+private:
+  enum Op : unsigned char { INSERT, REMOVE };
+
+  struct Message {
+    Key key;
+    Op op;
+  };
+
+  struct Node {
+    bool leaf;
+    std::vector<Key> keys;         // leaf: sorted keys, inner: pivots
+    std::vector<Node *> children;  // inner only, keys.size() + 1 entries
+    std::vector<Message> buffer;   // inner only, sorted and unique by key
+
+    explicit Node(bool isLeaf) : leaf(isLeaf) {}
+  };
+
+  using MsgIt = const Message *;
+
+  Node *root;
+  std::size_t leafCap;
+  std::size_t maxFanout;
+  std::size_t bufferCap;
+
+  static bool keyLess(const Message &m, const Key &k) { return m.key < k; }
+  static std::size_t childIndex(const Node *node, const Key &key);
+
+  void enqueue(Node *node, const Message &msg);
+  void applyToLeaf(Node *leaf, MsgIt first, MsgIt last);
+  void mergeIntoBuffer(Node *node, MsgIt first, MsgIt last);
+  void push(Node *parent, std::size_t i, MsgIt first, MsgIt last,
+            bool cascade);
+  void flushNode(Node *node);
+  void flushAll(Node *node);
+  void fixChild(Node *parent, std::size_t i);
+  void fixRoot();
+  // flush the path to *probe's leaf (the leftmost when null) and return its
+  // smallest key > *after (any key when null); `upper` gets the pivot
+  // bounding that leaf from above, if there is one
+  std::optional<Key> firstOnPath(const Key *probe, const Key *after,
+                                 std::optional<Key> &upper);
+  static void destroy(Node *node);
+};
+
+//-------------------------------------------------------------------------------
+//                          BufferedTree Implementation
+//-------------------------------------------------------------------------------
+
+template <KeyComparble Key>
+BufferedTree<Key>::BufferedTree(std::size_t leafCapacity, std::size_t fanout,
+                                std::size_t bufferCapacity)
+    : root(new Node(true)), leafCap(std::max<std::size_t>(leafCapacity, 4)),
+      // a split must leave every piece at least two children
+      maxFanout(std::max<std::size_t>(fanout, 4)),
+      bufferCap(std::max<std::size_t>(bufferCapacity, 4)) {}
+
+template <KeyComparble Key>
+BufferedTree<Key>::BufferedTree(std::initializer_list<Key> list)
+    : BufferedTree() {
+  for (const Key &key : list)
+    insert(key);
+}
+
+template <KeyComparble Key> BufferedTree<Key>::~BufferedTree() {
+  destroy(root);
+}
+
+template <KeyComparble Key> void BufferedTree<Key>::destroy(Node *node) {
+  for (Node *child : node->children)
+    destroy(child);
+  delete node;
+}
+
+template <KeyComparble Key>
+std::size_t BufferedTree<Key>::childIndex(const Node *node, const Key &key) {
+  return std::upper_bound(node->keys.begin(), node->keys.end(), key) -
+         node->keys.begin();
+}
+
+// sorted insert into one buffer; a message for a key already queued here
+// replaces the older one
+template <KeyComparble Key>
+void BufferedTree<Key>::enqueue(Node *node, const Message &msg) {
+  auto it = std::lower_bound(node->buffer.begin(), node->buffer.end(), msg.key,
+                             keyLess);
+  if (it != node->buffer.end() && !(msg.key < it->key))
+    it->op = msg.op;
+  else
+    node->buffer.insert(it, msg);
+}
+
+template <KeyComparble Key>
+void BufferedTree<Key>::applyToLeaf(Node *leaf, MsgIt first, MsgIt last) {
+  std::vector<Key> merged;
+  merged.reserve(leaf->keys.size() + (last - first));
+
+  auto k = leaf->keys.begin();
+  while (k != leaf->keys.end() || first != last) {
+    if (first == last || (k != leaf->keys.end() && *k < first->key)) {
+      merged.push_back(*k++);
+      continue;
+    }
+    if (k != leaf->keys.end() && !(first->key < *k))
+      ++k; // same key: the message decides
+    if (first->op == INSERT)
+      merged.push_back(first->key);
+    ++first;
+  }
+  leaf->keys.swap(merged);
+}
+
+// merge a sorted batch into a child's sorted buffer, batch wins on ties
+template <KeyComparble Key>
+void BufferedTree<Key>::mergeIntoBuffer(Node *node, MsgIt first, MsgIt last) {
+  std::vector<Message> merged;
+  merged.reserve(node->buffer.size() + (last - first));
+
+  auto m = node->buffer.cbegin();
+  while (m != node->buffer.cend() || first != last) {
+    if (first == last || (m != node->buffer.cend() && m->key < first->key)) {
+      merged.push_back(*m++);
+      continue;
+    }
+    if (m != node->buffer.cend() && !(first->key < m->key))
+      ++m;
+    merged.push_back(*first++);
+  }
+  node->buffer.swap(merged);
+}
+
+template <KeyComparble Key>
+void BufferedTree<Key>::push(Node *parent, std::size_t i, MsgIt first,
+                             MsgIt last, bool cascade) {
+  Node *child = parent->children[i];
+  if (child->leaf) {
+    applyToLeaf(child, first, last);
+  } else {
+    mergeIntoBuffer(child, first, last);
+    if (cascade && child->buffer.size() > bufferCap)
+      flushNode(child);
+  }
+  fixChild(parent, i);
+}
+
+// Push the heaviest per-child batch down until the buffer is half empty.
+template <KeyComparble Key> void BufferedTree<Key>::flushNode(Node *node) {
+  while (node->buffer.size() > bufferCap / 2) {
+    std::size_t best = 0, bestBegin = 0, bestEnd = 0;
+    std::size_t begin = 0;
+    while (begin < node->buffer.size()) {
+      std::size_t c = childIndex(node, node->buffer[begin].key);
+      std::size_t end = c < node->keys.size()
+                            ? std::lower_bound(node->buffer.begin() + begin,
+                                               node->buffer.end(),
+                                               node->keys[c], keyLess) -
+                                  node->buffer.begin()
+                            : node->buffer.size();
+      if (end - begin > bestEnd - bestBegin) {
+        best = c;
+        bestBegin = begin;
+        bestEnd = end;
+      }
+      begin = end;
+    }
+
+    std::vector<Message> batch(node->buffer.begin() + bestBegin,
+                               node->buffer.begin() + bestEnd);
+    node->buffer.erase(node->buffer.begin() + bestBegin,
+                       node->buffer.begin() + bestEnd);
+    push(node, best, batch.data(), batch.data() + batch.size(), true);
+  }
+}
+
+// Empty every buffer in the subtree.
+template <KeyComparble Key> void BufferedTree<Key>::flushAll(Node *node) {
+  if (node->leaf)
+    return;
+
+  std::vector<Message> pending;
+  pending.swap(node->buffer);
+  // deliver right to left so splits never shift a batch we still need
+  std::size_t end = pending.size();
+  while (end > 0) {
+    std::size_t c = childIndex(node, pending[end - 1].key);
+    std::size_t begin =
+        c > 0 ? std::lower_bound(pending.begin(), pending.begin() + end,
+                                 node->keys[c - 1], keyLess) -
+                    pending.begin()
+              : 0;
+    push(node, c, pending.data() + begin, pending.data() + end, false);
+    end = begin;
+  }
+
+  for (std::size_t i = node->children.size(); i-- > 0;) {
+    flushAll(node->children[i]);
+    fixChild(node, i);
+  }
+}
+
+// Split an overflowing child or drop an empty leaf, adjusting parent pivots.
+template <KeyComparble Key>
+void BufferedTree<Key>::fixChild(Node *parent, std::size_t i) {
+  Node *child = parent->children[i];
+
+  if (child->leaf) {
+    if (child->keys.empty() && parent->children.size() > 1) {
+      delete child;
+      parent->children.erase(parent->children.begin() + i);
+      parent->keys.erase(parent->keys.begin() + (i > 0 ? i - 1 : 0));
+      return;
+    }
+    if (child->keys.size() <= leafCap)
+      return;
+
+    // a big batch may overflow a leaf several times over: cut it into
+    // half-full pieces in one go
+    std::size_t n = child->keys.size();
+    std::size_t pieces = (n + leafCap / 2 - 1) / (leafCap / 2);
+    std::vector<Key> all;
+    all.swap(child->keys);
+    for (std::size_t p = 0; p < pieces; ++p) {
+      std::size_t from = n * p / pieces, to = n * (p + 1) / pieces;
+      Node *piece = p == 0 ? child : new Node(true);
+      piece->keys.assign(all.begin() + from, all.begin() + to);
+      if (p > 0) {
+        parent->children.insert(parent->children.begin() + i + p, piece);
+        parent->keys.insert(parent->keys.begin() + i + p - 1, all[from]);
+      }
+    }
+    return;
+  }
+
+  if (child->children.size() <= maxFanout)
+    return;
+
+  // same for inner nodes, which may have gained several leaves at once;
+  // every piece takes the pivots and buffered messages of its range
+  std::vector<Node *> kids;
+  std::vector<Key> pivots;
+  std::vector<Message> pending;
+  kids.swap(child->children);
+  pivots.swap(child->keys);
+  pending.swap(child->buffer);
+
+  std::size_t n = kids.size();
+  std::size_t pieces = (n + maxFanout / 2 - 1) / (maxFanout / 2);
+  for (std::size_t p = 0; p < pieces; ++p) {
+    std::size_t from = n * p / pieces, to = n * (p + 1) / pieces;
+    Node *piece = p == 0 ? child : new Node(false);
+    piece->children.assign(kids.begin() + from, kids.begin() + to);
+    piece->keys.assign(pivots.begin() + from, pivots.begin() + to - 1);
+
+    auto lo = p == 0 ? pending.begin()
+                     : std::lower_bound(pending.begin(), pending.end(),
+                                        pivots[from - 1], keyLess);
+    auto hi = to < n ? std::lower_bound(lo, pending.end(), pivots[to - 1],
+                                        keyLess)
+                     : pending.end();
+    piece->buffer.assign(lo, hi);
+
+    if (p > 0) {
+      parent->children.insert(parent->children.begin() + i + p, piece);
+      parent->keys.insert(parent->keys.begin() + i + p - 1, pivots[from - 1]);
+    }
+  }
+}
+
+template <KeyComparble Key> void BufferedTree<Key>::fixRoot() {
+  bool overflow = root->leaf ? root->keys.size() > leafCap
+                             : root->children.size() > maxFanout;
+  while (overflow) {
+    Node *top = new Node(false);
+    top->children.push_back(root);
+    root = top;
+    fixChild(root, 0);
+    overflow = root->children.size() > maxFanout;
+  }
+  // collapse a chain of single-child roots left behind by removals
+  while (!root->leaf && root->children.size() == 1 && root->buffer.empty()) {
+    Node *only = root->children[0];
+    delete root;
+    root = only;
+  }
+}
+
+template <KeyComparble Key> void BufferedTree<Key>::insert(const Key &key) {
+  if (root->leaf) {
+    Message msg{key, INSERT};
+    applyToLeaf(root, &msg, &msg + 1);
+  } else {
+    enqueue(root, {key, INSERT});
+    if (root->buffer.size() > bufferCap)
+      flushNode(root);
+  }
+  fixRoot();
+}
+
+template <KeyComparble Key> void BufferedTree<Key>::remove(const Key &key) {
+  if (root->leaf) {
+    Message msg{key, REMOVE};
+    applyToLeaf(root, &msg, &msg + 1);
+  } else {
+    enqueue(root, {key, REMOVE});
+    if (root->buffer.size() > bufferCap)
+      flushNode(root);
+  }
+  fixRoot();
+}
+
+template <KeyComparble Key>
+bool BufferedTree<Key>::search(const Key &key) const {
+  const Node *node = root;
+  while (!node->leaf) {
+    auto it = std::lower_bound(node->buffer.begin(), node->buffer.end(), key,
+                               keyLess);
+    if (it != node->buffer.end() && !(key < it->key))
+      return it->op == INSERT; // the newest message wins
+    node = node->children[childIndex(node, key)];
+  }
+  return std::binary_search(node->keys.begin(), node->keys.end(), key);
+}
+
+template <KeyComparble Key> void BufferedTree<Key>::flush() {
+  flushAll(root);
+  fixRoot();
+}
+
+// Each node on the way down hands its batch for the next child over, as a
+// flushNode() would, so the leaf reached holds the newest word on every key
+// in its range. A push may split the child or drop an emptied leaf (which
+// widens a neighbour), so the child is looked up again until it has no
+// batch left, and the path is repaired bottom-up at the end.
+template <KeyComparble Key>
+std::optional<Key> BufferedTree<Key>::firstOnPath(const Key *probe,
+                                                  const Key *after,
+                                                  std::optional<Key> &upper) {
+  upper.reset();
+  auto child = [&](const Node *node) -> std::size_t {
+    return probe ? childIndex(node, *probe) : 0;
+  };
+  std::vector<std::pair<Node *, std::size_t>> path;
+  Node *node = root;
+  while (!node->leaf) {
+    std::size_t c;
+    for (;;) { // until the child's batch is gone, its range may have grown
+      c = child(node);
+      auto &buf = node->buffer;
+      auto lo = c > 0 ? std::lower_bound(buf.begin(), buf.end(),
+                                         node->keys[c - 1], keyLess)
+                      : buf.begin();
+      auto hi = c < node->keys.size()
+                    ? std::lower_bound(lo, buf.end(), node->keys[c], keyLess)
+                    : buf.end();
+      if (lo == hi)
+        break;
+      std::vector<Message> batch(lo, hi);
+      buf.erase(lo, hi);
+      push(node, c, batch.data(), batch.data() + batch.size(), true);
+    }
+    if (c < node->keys.size())
+      upper = node->keys[c]; // deeper pivots are tighter
+    path.emplace_back(node, c);
+    node = node->children[c];
+  }
+
+  std::optional<Key> found;
+  auto it = after ? std::upper_bound(node->keys.begin(), node->keys.end(),
+                                     *after)
+                  : node->keys.begin();
+  if (it != node->keys.end())
+    found = *it;
+
+  // the leaf was settled by its push; above it, splits may have overfilled
+  for (std::size_t i = path.size(); i-- > 1;)
+    fixChild(path[i - 1].first, path[i - 1].second);
+  fixRoot();
+  return found;
+}
+
+template <KeyComparble Key> std::optional<Key> BufferedTree<Key>::minimum() {
+  std::optional<Key> upper, found = firstOnPath(nullptr, nullptr, upper);
+  while (!found && upper) { // an empty leaf; the next one starts at upper
+    Key from = *upper;
+    found = firstOnPath(&from, nullptr, upper);
+  }
+  return found;
+}
+
+template <KeyComparble Key>
+std::optional<Key> BufferedTree<Key>::successor(const Key &key) {
+  std::optional<Key> upper, found = firstOnPath(&key, &key, upper);
+  while (!found && upper) { // everything in the next leaf is above key
+    Key from = *upper;
+    found = firstOnPath(&from, &key, upper);
+  }
+  return found;
+}
+
+template <KeyComparble Key>
+template <typename Fn>
+void BufferedTree<Key>::forEach(Fn &&fn) {
+  flush();
+  std::vector<const Node *> stack{root};
+  while (!stack.empty()) {
+    const Node *node = stack.back();
+    stack.pop_back();
+    if (node->leaf) {
+      for (const Key &k : node->keys)
+        fn(k);
+      continue;
+    }
+    for (auto c = node->children.rbegin(); c != node->children.rend(); ++c)
+      stack.push_back(*c);
+  }
+}
+
+} // namespace BETREE
@@ -1,37 +1,65 @@
 #pragma once
 
-#include <cstdio>
-#include <cstring>
-
-constexpr int MAXN = 9999;
-constexpr int MAXSIZE = 10024;
-constexpr int DLEN = 4;
+#include <string>
+#include <utility>
 
+// Arbitrary-precision integer, sign and magnitude. The magnitude is a
+// little-endian array of 64-bit limbs sized to the value; decimal exists
+// only at the text boundary (the const char * constructor, toString() and
+// print()). Up to INLINE_LIMBS live inside the object, longer values move
+// to a heap block that grows geometrically and is kept (and reused) when
+// the value shrinks or is assigned over. Copying or returning a small
+// number therefore touches no heap at all, and a big one costs in
+// proportion to its length.
 struct BigInt {
-  int value[MAXSIZE], len;
-  bool flag;
-
-  BigInt() {
-    len = 1;
-    memset(value, 0, sizeof(value));
-    flag = false;
-  }
+  using Limb = unsigned long long; // 64 bits, see lib/src/limbs.hpp
+  static constexpr int INLINE_LIMBS = 5; // 320 bits; the object is 64 bytes
 
+  BigInt();
   BigInt(const int);
   BigInt(const char *);
   BigInt(const BigInt &);
+  BigInt(BigInt &&) noexcept;
+  ~BigInt();
 
   BigInt &operator=(const BigInt &);
+  BigInt &operator=(BigInt &&) noexcept;
   BigInt operator+(const BigInt &) const;
   BigInt operator-(const BigInt &) const;
   BigInt operator*(const BigInt &) const;
   BigInt operator/(const BigInt &) const;
-  int operator%(const BigInt &) const;
+  BigInt operator%(const BigInt &) const;
 
-  BigInt operator^(const BigInt &) const;
+  // Quotient and remainder at once. Like the built-in integers the quotient
+  // truncates toward zero and the remainder takes the dividend's sign;
+  // a zero divisor throws std::domain_error.
+  std::pair<BigInt, BigInt> divmod(const BigInt &) const;
+
+  BigInt operator^(const BigInt &) const; // power
 
   bool operator<(const BigInt &) const;
   bool operator<(const int &t) const;
+  bool operator==(const BigInt &) const;
 
+  std::string toString() const; // decimal
   void print() const;
+
+  // limbs in use (at least 1), and how many fit before the next growth
+  int size() const { return len; }
+  int capacity() const { return cap; }
+  bool isInline() const { return value == small; }
+  void reserve(int limbs);
+
+private:
+  Limb *value; // `small` or a heap block of `cap` limbs
+  int len;
+  int cap;
+  bool flag; // negative
+
+  Limb small[INLINE_LIMBS];
+
+  static BigInt addSigned(const BigInt &a, const BigInt &b, bool negateB);
+  void resize(int limbs); // new limbs are zero
+  void trim();            // drop leading zero limbs, keep at least one
+  void release();
 };
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <bit>
 #include <concepts>
+#include <limits>
+#include <type_traits>
 
 template <typename T>
 concept Integer = std::integral<T>;
@@ -40,11 +43,29 @@ template <Integer T> T flapBit(T a, T b) {
   return a ^ (static_cast<T>(1) << b);
 }
 
+// counts the two's complement bits, so negative values terminate too
 template <Integer T> T popcount(T a) {
-  int cnt = 0;
-  while (a) {
-    cnt += a & 1;
-    a >>= 1;
-  }
-  return cnt;
+  return static_cast<T>(std::popcount(static_cast<std::make_unsigned_t<T>>(a)));
+}
+
+// Word-level scans for bitmap summaries. lowestSetBit and highestSetBit
+// need a non-zero word.
+
+template <std::unsigned_integral T> int lowestSetBit(T a) {
+  return std::countr_zero(a);
+}
+
+template <std::unsigned_integral T> int highestSetBit(T a) {
+  return std::bit_width(a) - 1;
+}
+
+// the bits of `a` strictly below / strictly above position `b`
+template <std::unsigned_integral T> T bitsBelow(T a, int b) {
+  return a & ((static_cast<T>(1) << b) - 1);
+}
+
+template <std::unsigned_integral T> T bitsAbove(T a, int b) {
+  return b + 1 >= std::numeric_limits<T>::digits
+             ? 0
+             : a & (~static_cast<T>(0) << (b + 1));
 }
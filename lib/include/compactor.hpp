@@ -0,0 +1,86 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+
+namespace TREE {
+
+//-------------------------------------------------------------------------------
+//                             Background Compactor
+//-------------------------------------------------------------------------------
+
+// Drains a lazily deleting tree's tombstones from a helper thread. The trees
+// are not thread-safe, so the compactor takes the same mutex the owner uses
+// around every tree call, and only holds it for one compactStep() of at most
+// `batch` nodes at a time.
+
+template <typename Tree> class BackgroundCompactor {
+public:
+  BackgroundCompactor(Tree &tree, std::mutex &treeMutex,
+                      std::size_t batch = 64,
+                      std::chrono::milliseconds interval =
+                          std::chrono::milliseconds(1));
+  ~BackgroundCompactor();
+
+  BackgroundCompactor(const BackgroundCompactor &) = delete;
+  BackgroundCompactor &operator=(const BackgroundCompactor &) = delete;
+
+  void stop();
+
+private:
+  Tree &tree;
+  std::mutex &treeMutex;
+  std::size_t batch;
+  std::chrono::milliseconds interval;
+
+  std::mutex stateMutex;
+  std::condition_variable wake;
+  bool stopping{false};
+  std::thread worker;
+
+  void run();
+};
+
+//-------------------------------------------------------------------------------
+//                       BackgroundCompactor Implementation
+//-------------------------------------------------------------------------------
+
+template <typename Tree>
+BackgroundCompactor<Tree>::BackgroundCompactor(
+    Tree &t, std::mutex &m, std::size_t b, std::chrono::milliseconds i)
+    : tree(t), treeMutex(m), batch(b), interval(i),
+      worker(&BackgroundCompactor::run, this) {}
+
+template <typename Tree> BackgroundCompactor<Tree>::~BackgroundCompactor() {
+  stop();
+}
+
+template <typename Tree> void BackgroundCompactor<Tree>::stop() {
+  {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  if (worker.joinable())
+    worker.join();
+}
+
+template <typename Tree> void BackgroundCompactor<Tree>::run() {
+  std::unique_lock<std::mutex> state(stateMutex);
+  while (!stopping) {
+    state.unlock();
+    std::size_t done;
+    {
+      std::lock_guard<std::mutex> lock(treeMutex);
+      done = tree.compactStep(batch);
+    }
+    state.lock();
+    if (done < batch) // queue drained, sleep until the next tick
+      wake.wait_for(state, interval, [this] { return stopping; });
+  }
+}
+
+} // namespace TREE
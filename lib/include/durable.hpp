@@ -0,0 +1,524 @@
+#pragma once
+
+#include "generator.hpp"
+#include "node.hpp"
+#include "tree.hpp"
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+
+namespace STORE {
+
+//-------------------------------------------------------------------------------
+//                               Durable Key Set
+//-------------------------------------------------------------------------------
+
+// A tree used as an in-memory index, made crash safe by files in `dir`:
+//
+//   wal       append-only log of insert/remove records, each
+//             [op:1][key:sizeof(Key)][fnv1a:4]
+//   wal.old   the log a snapshot in progress covers, gone once it is done
+//   snapshot  the whole key set, sorted; integral keys are stored as varint
+//             deltas, so dense keys take about one byte each
+//
+// Records collect in memory and are group committed: one write() and one
+// fdatasync() once `batchOps` records are pending, or from a background
+// thread every `batchDelay`, whichever comes first. A crash loses at most
+// the uncommitted tail; sync() waits for everything appended so far. A
+// failed commit cuts the log back to its last whole batch, so the retry
+// appends the batch exactly once.
+//
+// A snapshot holds the mutex only to copy the keys and move the log aside
+// to wal.old; encoding, writing and syncing the file happen outside it.
+// Automatic snapshots (`snapshotEvery`) run on the background thread, so
+// writers never wait for one.
+//
+// Startup loads the snapshot and replays wal.old, then wal. A torn or
+// corrupt record ends a replay and is cut off. Set operations are
+// last-writer-wins per key, so replaying a log that the latest snapshot
+// already covers (a crash before wal.old was removed) is harmless.
+//
+// I/O failures throw std::system_error. Set operations take one mutex.
+
+struct Options {
+  std::size_t batchOps{256};                  // commit once this many pend
+  std::chrono::microseconds batchDelay{1000}; // 0 disables the timer
+  std::size_t snapshotEvery{0};      // log records per auto snapshot, 0: off
+  bool fsync{true};                  // false: write() only, for benchmarks
+};
+
+template <KeyComparble Key, typename Tree = TREE::AVLTree<Key>>
+class DurableSet {
+  static_assert(std::is_trivially_copyable_v<Key>,
+                "keys are logged as raw bytes");
+
+public:
+  explicit DurableSet(std::string dir, Options options = {});
+  ~DurableSet();
+
+  DurableSet(const DurableSet &) = delete;
+  DurableSet &operator=(const DurableSet &) = delete;
+
+  bool insert(const Key &key);
+  bool remove(const Key &key);
+  bool contains(const Key &key) const;
+  std::size_t size() const;
+
+  void sync();
+  void snapshot();
+
+  std::size_t recoveredKeys() const { return recovered; }
+  std::size_t replayedRecords() const { return replayed; }
+
+private:
+  enum Op : std::uint8_t { INSERT = 1, REMOVE = 2 };
+  static constexpr std::size_t RECORD = 1 + sizeof(Key) + 4;
+  static constexpr char MAGIC[4] = {'T', 'S', 'N', 'P'};
+
+  std::string dir;
+  Options options;
+  mutable Tree tree; // search() is logically const
+  std::size_t count{0};
+  std::size_t recovered{0};
+  std::size_t replayed{0};
+
+  int wal{-1};
+  off_t walSize{0}; // end of the last whole batch in the log
+  std::vector<char> pending;
+  std::size_t logged{0}; // records in the log since it was last moved aside
+  bool rotated{false};   // wal.old still exists
+
+  mutable std::mutex mutex;
+  std::mutex snapshotMutex; // one snapshot at a time, taken before mutex
+  std::condition_variable wake;
+  bool stopping{false};
+  bool snapshotDue{false};
+  std::thread flusher;
+
+  void append(Op op, const Key &key);
+  void commit(); // mutex held
+  void rotate(); // mutex held
+  void writeSnapshot(const std::vector<Key> &keys);
+  void loadSnapshot();
+  std::size_t replayLog(const std::string &file);
+  void openLog();
+  void apply(Op op, const Key &key);
+  void run();
+  void syncDir();
+
+  std::string path(const char *name) const { return dir + "/" + name; }
+
+  static std::uint32_t fnv1a(const char *data, std::size_t size);
+  static void writeAll(int fd, const char *data, std::size_t size);
+  static std::vector<char> readAll(const std::string &file);
+  [[noreturn]] static void fail(const std::string &what, int err = errno);
+};
+
+//-------------------------------------------------------------------------------
+//                           DurableSet Implementation
+//-------------------------------------------------------------------------------
+
+template <KeyComparble Key, typename Tree>
+DurableSet<Key, Tree>::DurableSet(std::string d, Options o)
+    : dir(std::move(d)), options(o) {
+  if (::mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+    fail("mkdir " + dir);
+  loadSnapshot();
+  std::string old = path("wal.old");
+  rotated = ::access(old.c_str(), F_OK) == 0;
+  if (rotated)
+    replayLog(old);
+  walSize = off_t(replayLog(path("wal")));
+  logged = replayed;
+  openLog();
+  if (options.batchDelay.count() > 0 || options.snapshotEvery > 0)
+    flusher = std::thread(&DurableSet::run, this);
+}
+
+template <KeyComparble Key, typename Tree>
+DurableSet<Key, Tree>::~DurableSet() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  if (flusher.joinable())
+    flusher.join();
+  try {
+    std::lock_guard<std::mutex> lock(mutex);
+    commit();
+  } catch (const std::system_error &) {
+    // nothing sensible to do in a destructor; the tail is lost
+  }
+  if (wal >= 0)
+    ::close(wal);
+}
+
+template <KeyComparble Key, typename Tree>
+bool DurableSet<Key, Tree>::insert(const Key &key) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (tree.search(key) != nullptr)
+    return false;
+  tree.insert(key);
+  ++count;
+  append(INSERT, key);
+  return true;
+}
+
+template <KeyComparble Key, typename Tree>
+bool DurableSet<Key, Tree>::remove(const Key &key) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (tree.search(key) == nullptr)
+    return false;
+  tree.remove(key);
+  --count;
+  append(REMOVE, key);
+  return true;
+}
+
+template <KeyComparble Key, typename Tree>
+bool DurableSet<Key, Tree>::contains(const Key &key) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return tree.search(key) != nullptr;
+}
+
+template <KeyComparble Key, typename Tree>
+std::size_t DurableSet<Key, Tree>::size() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return count;
+}
+
+template <KeyComparble Key, typename Tree>
+void DurableSet<Key, Tree>::sync() {
+  std::lock_guard<std::mutex> lock(mutex);
+  commit();
+}
+
+// Copy the keys and move the log aside under the mutex, then write the
+// snapshot and drop the old log without it. If an earlier snapshot failed
+// after its rotation, wal.old is still needed, so the live log stays put
+// and is moved aside next time.
+template <KeyComparble Key, typename Tree>
+void DurableSet<Key, Tree>::snapshot() {
+  std::lock_guard<std::mutex> one(snapshotMutex);
+  std::vector<Key> keys;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    commit();
+    keys.reserve(count);
+    for (const Key &key : TRAVERSE::inOrder(tree.getRoot()))
+      keys.push_back(key);
+    if (!rotated)
+      rotate();
+  }
+
+  writeSnapshot(keys);
+  std::string old = path("wal.old");
+  if (::unlink(old.c_str()) != 0 && errno != ENOENT)
+    fail("unlink " + old);
+  if (options.fsync)
+    syncDir();
+  std::lock_guard<std::mutex> lock(mutex);
+  rotated = false;
+}
+
+template <KeyComparble Key, typename Tree>
+void DurableSet<Key, Tree>::append(Op op, const Key &key) {
+  char record[RECORD];
+  record[0] = char(op);
+  std::memcpy(record + 1, &key, sizeof(Key));
+  std::uint32_t sum = fnv1a(record, 1 + sizeof(Key));
+  std::memcpy(record + 1 + sizeof(Key), &sum, 4);
+  pending.insert(pending.end(), record, record + RECORD);
+
+  if (pending.size() >= options.batchOps * RECORD)
+    commit();
+}
+
+template <KeyComparble Key, typename Tree>
+void DurableSet<Key, Tree>::commit() {
+  if (pending.empty())
+    return;
+  try {
+    writeAll(wal, pending.data(), pending.size());
+    if (options.fsync && ::fdatasync(wal) != 0)
+      fail("fdatasync wal");
+  } catch (const std::system_error &) {
+    // a partial batch would misalign every record after it; the batch
+    // stays pending and is written again from the last good offset. Should
+    // the truncate fail too, replay still stops at the torn record.
+    [[maybe_unused]] int rc = ::ftruncate(wal, walSize);
+    throw;
+  }
+  walSize += off_t(pending.size());
+  logged += pending.size() / RECORD;
+  pending.clear();
+
+  if (options.snapshotEvery && logged >= options.snapshotEvery &&
+      !snapshotDue) {
+    snapshotDue = true; // taken by the background thread
+    wake.notify_all();
+  }
+}
+
+// Move the committed log aside to wal.old and start an empty one
+template <KeyComparble Key, typename Tree>
+void DurableSet<Key, Tree>::rotate() {
+  std::string file = path("wal"), old = path("wal.old");
+  if (::rename(file.c_str(), old.c_str()) != 0)
+    fail("rename " + file);
+  ::close(wal);
+  wal = -1;
+  walSize = 0;
+  logged = 0;
+  snapshotDue = false; // this snapshot covers it
+  rotated = true;
+  openLog();
+}
+
+// Write the sorted key set to snapshot.tmp, make it durable and rename it
+// over the old snapshot
+template <KeyComparble Key, typename Tree>
+void DurableSet<Key, Tree>::writeSnapshot(const std::vector<Key> &keys) {
+  std::vector<char> out(MAGIC, MAGIC + 4);
+  auto put = [&out](const void *p, std::size_t n) {
+    out.insert(out.end(), static_cast<const char *>(p),
+               static_cast<const char *>(p) + n);
+  };
+  std::uint32_t version = 1, keySize = sizeof(Key);
+  std::uint64_t n = keys.size();
+  put(&version, 4);
+  put(&keySize, 4);
+  put(&n, 8);
+
+  std::size_t body = out.size();
+  if constexpr (std::is_integral_v<Key>) {
+    using U = std::make_unsigned_t<Key>;
+    U prev = 0;
+    for (const Key &key : keys) {
+      U delta = U(key) - prev; // ascending, so never wraps past the first
+      prev = U(key);
+      do {
+        out.push_back(char((delta & 0x7f) | (delta > 0x7f ? 0x80 : 0)));
+        delta >>= 7;
+      } while (delta);
+    }
+  } else {
+    for (const Key &key : keys)
+      put(&key, sizeof(Key));
+  }
+  std::uint32_t sum = fnv1a(out.data() + body, out.size() - body);
+  put(&sum, 4);
+
+  std::string tmp = path("snapshot.tmp"), final = path("snapshot");
+  int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    fail("open " + tmp);
+  writeAll(fd, out.data(), out.size());
+  if (options.fsync && ::fsync(fd) != 0)
+    fail("fsync " + tmp);
+  ::close(fd);
+  if (::rename(tmp.c_str(), final.c_str()) != 0)
+    fail("rename " + tmp);
+  if (options.fsync) // make the rename itself durable
+    syncDir();
+}
+
+template <KeyComparble Key, typename Tree>
+void DurableSet<Key, Tree>::loadSnapshot() {
+  std::vector<char> in = readAll(path("snapshot"));
+  if (in.empty())
+    return;
+
+  std::uint32_t version, keySize, sum;
+  std::uint64_t n;
+  if (in.size() < 24 || std::memcmp(in.data(), MAGIC, 4) != 0)
+    fail("bad snapshot header", EIO);
+  std::memcpy(&version, in.data() + 4, 4);
+  std::memcpy(&keySize, in.data() + 8, 4);
+  std::memcpy(&n, in.data() + 12, 8);
+  std::memcpy(&sum, in.data() + in.size() - 4, 4);
+  const char *p = in.data() + 20, *end = in.data() + in.size() - 4;
+  if (version != 1 || keySize != sizeof(Key) || fnv1a(p, end - p) != sum)
+    fail("corrupt snapshot", EIO);
+
+  if constexpr (std::is_integral_v<Key>) {
+    using U = std::make_unsigned_t<Key>;
+    U prev = 0;
+    for (std::uint64_t i = 0; i < n; ++i) {
+      U delta = 0;
+      for (int shift = 0; p < end; shift += 7) {
+        unsigned char byte = *p++;
+        delta |= U(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+          break;
+      }
+      prev += delta;
+      tree.insert(Key(prev));
+    }
+  } else {
+    for (std::uint64_t i = 0; i < n && p + sizeof(Key) <= end;
+         ++i, p += sizeof(Key)) {
+      Key key;
+      std::memcpy(&key, p, sizeof(Key));
+      tree.insert(key);
+    }
+  }
+  count = recovered = n;
+}
+
+// Apply the log's valid records and cut off a torn or corrupt tail;
+// returns the length kept
+template <KeyComparble Key, typename Tree>
+std::size_t DurableSet<Key, Tree>::replayLog(const std::string &file) {
+  std::vector<char> in = readAll(file);
+
+  std::size_t good = 0;
+  for (; good + RECORD <= in.size(); good += RECORD) {
+    const char *record = in.data() + good;
+    std::uint32_t sum;
+    std::memcpy(&sum, record + 1 + sizeof(Key), 4);
+    Op op = Op(record[0]);
+    if ((op != INSERT && op != REMOVE) ||
+        fnv1a(record, 1 + sizeof(Key)) != sum)
+      break;
+    Key key;
+    std::memcpy(&key, record + 1, sizeof(Key));
+    apply(op, key);
+    ++replayed;
+  }
+  if (good != in.size() && ::truncate(file.c_str(), off_t(good)) != 0)
+    fail("truncate torn tail of " + file);
+  return good;
+}
+
+// Open (or create) the live log for appending; a new file's directory
+// entry is synced too, or a crash could lose the log and all it holds
+template <KeyComparble Key, typename Tree>
+void DurableSet<Key, Tree>::openLog() {
+  std::string file = path("wal");
+  wal = ::open(file.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (wal < 0)
+    fail("open " + file);
+  if (options.fsync)
+    syncDir();
+}
+
+template <KeyComparble Key, typename Tree>
+void DurableSet<Key, Tree>::apply(Op op, const Key &key) {
+  bool present = tree.search(key) != nullptr;
+  if (op == INSERT && !present) {
+    tree.insert(key);
+    ++count;
+  } else if (op == REMOVE && present) {
+    tree.remove(key);
+    --count;
+  }
+}
+
+// Timer commits and automatic snapshots
+template <KeyComparble Key, typename Tree> void DurableSet<Key, Tree>::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  auto woken = [this] { return stopping || snapshotDue; };
+  while (!stopping) {
+    if (options.batchDelay.count() > 0)
+      wake.wait_for(lock, options.batchDelay, woken);
+    else
+      wake.wait(lock, woken);
+    try {
+      commit();
+    } catch (const std::system_error &) {
+      // leave the records pending; the next sync() reports the failure
+    }
+    if (snapshotDue && !stopping) {
+      snapshotDue = false;
+      lock.unlock();
+      try {
+        snapshot();
+      } catch (const std::system_error &) {
+        // the logs still hold everything; a later snapshot retries
+      }
+      lock.lock();
+    }
+  }
+}
+
+template <KeyComparble Key, typename Tree>
+void DurableSet<Key, Tree>::syncDir() {
+  int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0)
+    fail("open " + dir);
+  int rc = ::fsync(fd);
+  int err = errno;
+  ::close(fd);
+  if (rc != 0)
+    fail("fsync " + dir, err);
+}
+
+template <KeyComparble Key, typename Tree>
+std::uint32_t DurableSet<Key, Tree>::fnv1a(const char *data, std::size_t size) {
+  std::uint32_t h = 2166136261u;
+  for (std::size_t i = 0; i < size; ++i)
+    h = (h ^ static_cast<unsigned char>(data[i])) * 16777619u;
+  return h;
+}
+
+template <KeyComparble Key, typename Tree>
+void DurableSet<Key, Tree>::writeAll(int fd, const char *data,
+                                     std::size_t size) {
+  while (size > 0) {
+    ssize_t n = ::write(fd, data, size);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      fail("write");
+    }
+    data += n;
+    size -= std::size_t(n);
+  }
+}
+
+template <KeyComparble Key, typename Tree>
+std::vector<char> DurableSet<Key, Tree>::readAll(const std::string &file) {
+  std::vector<char> data;
+  int fd = ::open(file.c_str(), O_RDONLY);
+  if (fd < 0) {
+    if (errno == ENOENT)
+      return data;
+    fail("open " + file);
+  }
+  char chunk[1 << 16];
+  for (;;) {
+    ssize_t n = ::read(fd, chunk, sizeof(chunk));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0) {
+      ::close(fd);
+      fail("read " + file);
+    }
+    if (n == 0)
+      break;
+    data.insert(data.end(), chunk, chunk + n);
+  }
+  ::close(fd);
+  return data;
+}
+
+template <KeyComparble Key, typename Tree>
+void DurableSet<Key, Tree>::fail(const std::string &what, int err) {
+  throw std::system_error(err, std::generic_category(), what);
+}
+
+} // namespace STORE
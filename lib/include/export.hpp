@@ -0,0 +1,267 @@
+#pragma once
+
+#include "node.hpp"
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace EXPORT {
+
+//-------------------------------------------------------------------------------
+//                                 Tree Exporter
+//-------------------------------------------------------------------------------
+
+// Iterative text / Graphviz DOT / JSON dumps of a binary tree. Everything is
+// appended to one buffer owned by the exporter, so exporting the same tree
+// again (or another tree) reuses the already grown buffer and stack.
+//
+// Numeric keys go through std::to_chars, floating point ones in the shortest
+// form that reads back to the same value; anything else is written as it
+// prints. JSON keeps integers and finite floating point keys as numbers and
+// makes anything else an escaped string; DOT escapes quotes, backslashes and
+// newlines inside its quoted labels.
+
+template <BinaryNode NodeT> class TreeExporter {
+public:
+  TreeExporter() = default;
+
+  const std::string &text(const NodeT *root, const std::string &prefix = "",
+                          bool isLeft = false);
+  const std::string &dot(const NodeT *root, const char *name = "Tree");
+  const std::string &json(const NodeT *root);
+
+  const std::string &buffer() const { return buf; }
+  void clear() { buf.clear(); }
+  void write(std::ostream &os) const { os.write(buf.data(), buf.size()); }
+
+private:
+  struct Frame {
+    const NodeT *node;
+    std::size_t aux; // text: prefix length, dot: parent id, json: state
+    bool isLeft;
+  };
+
+  enum class Quoting { NONE, DOT, JSON };
+
+  std::string buf;
+  std::string prefix; // text only, grows and shrinks in place
+  std::vector<Frame> stack;
+
+  void appendKey(const NodeT *node, Quoting quoting = Quoting::NONE);
+  void appendEscaped(std::string_view text, Quoting quoting);
+  void appendNumber(std::size_t n);
+  static constexpr bool hasColor();
+  static bool isRed(const NodeT *node);
+};
+
+//-------------------------------------------------------------------------------
+//                          TreeExporter Implementation
+//-------------------------------------------------------------------------------
+
+template <BinaryNode NodeT> constexpr bool TreeExporter<NodeT>::hasColor() {
+  return requires(const NodeT &n) { n.color == NodeT::RED; };
+}
+
+template <BinaryNode NodeT>
+bool TreeExporter<NodeT>::isRed(const NodeT *node) {
+  if constexpr (hasColor())
+    return node->color == NodeT::RED;
+  else
+    return false;
+}
+
+template <BinaryNode NodeT>
+void TreeExporter<NodeT>::appendNumber(std::size_t n) {
+  char tmp[24];
+  auto res = std::to_chars(tmp, tmp + sizeof(tmp), n);
+  buf.append(tmp, res.ptr);
+}
+
+template <BinaryNode NodeT>
+void TreeExporter<NodeT>::appendKey(const NodeT *node, Quoting quoting) {
+  using Key = std::remove_cv_t<decltype(node->key)>;
+  if constexpr (std::is_integral_v<Key> && !std::is_same_v<Key, bool>) {
+    char tmp[24];
+    auto res = std::to_chars(tmp, tmp + sizeof(tmp), node->key);
+    buf.append(tmp, res.ptr);
+  } else if constexpr (std::is_floating_point_v<Key>) {
+    char tmp[64];
+    auto res = std::to_chars(tmp, tmp + sizeof(tmp), node->key);
+    bool quote = quoting == Quoting::JSON && !std::isfinite(node->key);
+    if (quote) // JSON has no inf or nan
+      buf += '"';
+    buf.append(tmp, res.ptr);
+    if (quote)
+      buf += '"';
+  } else {
+    // slow path for keys that only know operator<<
+    std::ostringstream oss;
+    oss << node->key;
+    if (quoting == Quoting::JSON) {
+      buf += '"';
+      appendEscaped(oss.str(), quoting);
+      buf += '"';
+    } else {
+      appendEscaped(oss.str(), quoting);
+    }
+  }
+}
+
+template <BinaryNode NodeT>
+void TreeExporter<NodeT>::appendEscaped(std::string_view text,
+                                        Quoting quoting) {
+  if (quoting == Quoting::NONE) {
+    buf += text;
+    return;
+  }
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      buf += '\\';
+      buf += c;
+    } else if (c == '\n') {
+      buf += "\\n"; // a line break in a DOT label too
+    } else if (quoting == Quoting::JSON &&
+               static_cast<unsigned char>(c) < 0x20) {
+      static constexpr char hex[] = "0123456789abcdef";
+      buf += "\\u00";
+      buf += hex[(c >> 4) & 0xf];
+      buf += hex[c & 0xf];
+    } else {
+      buf += c;
+    }
+  }
+}
+
+// Same layout as printTree(): pre-order, left child drawn with "├──"
+template <BinaryNode NodeT>
+const std::string &TreeExporter<NodeT>::text(const NodeT *root,
+                                             const std::string &initial,
+                                             bool isLeft) {
+  if (root == nullptr)
+    return buf;
+
+  prefix = initial;
+  stack.clear();
+  stack.push_back({root, prefix.size(), isLeft});
+
+  while (!stack.empty()) {
+    Frame f = stack.back();
+    stack.pop_back();
+
+    // every frame still on the stack owns a prefix no longer than ours, so
+    // truncating never loses anything a pending frame needs
+    prefix.resize(f.aux);
+    buf += prefix;
+    buf += f.isLeft ? "├──" : "└──";
+    appendKey(f.node);
+    buf += '\n';
+
+    prefix += f.isLeft ? "│   " : "    ";
+    if (f.node->right)
+      stack.push_back({f.node->right, prefix.size(), false});
+    if (f.node->left)
+      stack.push_back({f.node->left, prefix.size(), true});
+  }
+  return buf;
+}
+
+template <BinaryNode NodeT>
+const std::string &TreeExporter<NodeT>::dot(const NodeT *root,
+                                            const char *name) {
+  buf += "digraph ";
+  buf += name;
+  buf += " {\n  node [shape=circle];\n";
+
+  constexpr std::size_t noParent = static_cast<std::size_t>(-1);
+  std::size_t nextId = 0;
+  stack.clear();
+  if (root)
+    stack.push_back({root, noParent, false});
+
+  while (!stack.empty()) {
+    Frame f = stack.back();
+    stack.pop_back();
+    std::size_t id = nextId++;
+
+    buf += "  n";
+    appendNumber(id);
+    buf += " [label=\"";
+    appendKey(f.node, Quoting::DOT);
+    buf += '"';
+    if constexpr (hasColor())
+      buf += isRed(f.node) ? ", color=red" : ", color=black";
+    buf += "];\n";
+
+    if (f.aux != noParent) {
+      buf += "  n";
+      appendNumber(f.aux);
+      buf += " -> n";
+      appendNumber(id);
+      buf += f.isLeft ? " [label=\"L\"];\n" : " [label=\"R\"];\n";
+    }
+
+    if (f.node->right)
+      stack.push_back({f.node->right, id, false});
+    if (f.node->left)
+      stack.push_back({f.node->left, id, true});
+  }
+
+  buf += "}\n";
+  return buf;
+}
+
+// Nested objects: {"key":k,"left":{...}|null,"right":{...}|null}
+template <BinaryNode NodeT>
+const std::string &TreeExporter<NodeT>::json(const NodeT *root) {
+  if (root == nullptr) {
+    buf += "null\n";
+    return buf;
+  }
+
+  enum State : std::size_t { OPEN, RIGHT, CLOSE };
+  stack.clear();
+  stack.push_back({root, OPEN, false});
+
+  while (!stack.empty()) {
+    Frame &f = stack.back();
+    const NodeT *node = f.node;
+
+    switch (f.aux) {
+    case OPEN:
+      buf += "{\"key\":";
+      appendKey(node, Quoting::JSON);
+      if constexpr (hasColor())
+        buf += isRed(node) ? ",\"color\":\"red\"" : ",\"color\":\"black\"";
+      buf += ",\"left\":";
+      f.aux = RIGHT;
+      if (node->left)
+        stack.push_back({node->left, OPEN, true}); // invalidates f
+      else
+        buf += "null";
+      break;
+    case RIGHT:
+      buf += ",\"right\":";
+      f.aux = CLOSE;
+      if (node->right)
+        stack.push_back({node->right, OPEN, false}); // invalidates f
+      else
+        buf += "null";
+      break;
+    default:
+      buf += '}';
+      stack.pop_back();
+      break;
+    }
+  }
+
+  buf += '\n';
+  return buf;
+}
+
+} // namespace EXPORT
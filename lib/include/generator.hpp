@@ -0,0 +1,297 @@
+#pragma once
+
+#include "node.hpp"
+#include <compare>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace TRAVERSE {
+
+//-------------------------------------------------------------------------------
+//                                  Generator
+//-------------------------------------------------------------------------------
+
+// Minimal lazy sequence for C++20 (std::generator only arrives in C++23).
+// Values are yielded by reference: the pointer stays valid until the
+// generator is resumed, which is all a range-for needs.
+//
+// Coroutine frames come from a small per-thread cache, so the common
+// "open a traversal, read a few keys, drop it" pattern stops allocating
+// after the first call.
+
+class FrameCache {
+public:
+  static void *allocate(std::size_t size) {
+    for (Slot &slot : slots())
+      if (slot.block && slot.size == size)
+        return std::exchange(slot.block, nullptr);
+    return ::operator new(size);
+  }
+
+  static void release(void *block, std::size_t size) {
+    for (Slot &slot : slots())
+      if (!slot.block) {
+        slot = {block, size};
+        return;
+      }
+    ::operator delete(block);
+  }
+
+private:
+  struct Slot {
+    void *block{nullptr};
+    std::size_t size{0};
+  };
+  struct Slots {
+    Slot slot[4];
+    Slot *begin() { return slot; }
+    Slot *end() { return slot + 4; }
+    ~Slots() {
+      for (Slot &s : slot)
+        ::operator delete(s.block);
+    }
+  };
+  static Slots &slots() {
+    thread_local Slots cache;
+    return cache;
+  }
+};
+
+template <typename T> class Generator {
+public:
+  struct promise_type {
+    const T *current{nullptr};
+    std::exception_ptr error;
+
+    Generator get_return_object() {
+      return Generator(
+          std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    std::suspend_always yield_value(const T &value) noexcept {
+      current = &value;
+      return {};
+    }
+    void return_void() noexcept {}
+    void unhandled_exception() { error = std::current_exception(); }
+
+    static void *operator new(std::size_t size) {
+      return FrameCache::allocate(size);
+    }
+    static void operator delete(void *block, std::size_t size) {
+      FrameCache::release(block, size);
+    }
+  };
+
+  using handle_type = std::coroutine_handle<promise_type>;
+
+  class iterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T *;
+    using reference = const T &;
+
+    iterator() = default;
+    explicit iterator(handle_type h) : handle(h) {}
+
+    reference operator*() const { return *handle.promise().current; }
+    pointer operator->() const { return handle.promise().current; }
+    iterator &operator++() {
+      handle.resume();
+      rethrow();
+      return *this;
+    }
+    void operator++(int) { ++*this; }
+    bool operator==(std::default_sentinel_t) const {
+      return !handle || handle.done();
+    }
+
+  private:
+    handle_type handle{};
+
+    void rethrow() const {
+      if (handle.done() && handle.promise().error)
+        std::rethrow_exception(handle.promise().error);
+    }
+    friend class Generator;
+  };
+
+  Generator() = default;
+  Generator(Generator &&other) noexcept
+      : handle(std::exchange(other.handle, {})) {}
+  Generator &operator=(Generator &&other) noexcept {
+    if (this != &other) {
+      reset();
+      handle = std::exchange(other.handle, {});
+    }
+    return *this;
+  }
+  Generator(const Generator &) = delete;
+  Generator &operator=(const Generator &) = delete;
+  ~Generator() { reset(); }
+
+  // starts (or continues) the sequence; call once per generator
+  iterator begin() {
+    iterator it(handle);
+    if (handle && !handle.done())
+      ++it;
+    return it;
+  }
+  std::default_sentinel_t end() const { return {}; }
+
+private:
+  handle_type handle{};
+
+  explicit Generator(handle_type h) : handle(h) {}
+  void reset() {
+    if (handle)
+      handle.destroy();
+    handle = {};
+  }
+};
+
+//-------------------------------------------------------------------------------
+//                                 Traversals
+//-------------------------------------------------------------------------------
+
+// All walks follow parent links instead of keeping a stack, so their frame
+// is a few pointers no matter how deep the tree is. Lazily deleted
+// (tombstoned) nodes are skipped.
+
+template <BinaryNode NodeT> NodeT *leftmost(NodeT *node) {
+  while (node && node->left)
+    node = node->left;
+  return node;
+}
+
+template <BinaryNode NodeT> NodeT *rightmost(NodeT *node) {
+  while (node && node->right)
+    node = node->right;
+  return node;
+}
+
+// in-order neighbours, nullptr past either end
+template <BinaryNode NodeT> NodeT *next(NodeT *node) {
+  if (node->right)
+    return leftmost(node->right);
+  while (node->parent && node->parent->right == node)
+    node = node->parent;
+  return node->parent;
+}
+
+template <BinaryNode NodeT> NodeT *prev(NodeT *node) {
+  if (node->left)
+    return rightmost(node->left);
+  while (node->parent && node->parent->left == node)
+    node = node->parent;
+  return node->parent;
+}
+
+// first node whose key is not less than `key`; walks that look keys up
+// take the tree's three-way comparator, natural order by default
+template <BinaryNode NodeT, typename Key,
+          typename Compare = std::compare_three_way>
+NodeT *lowerBound(NodeT *node, const Key &key, Compare cmp = {}) {
+  NodeT *best = nullptr;
+  while (node) {
+    if (cmp(node->key, key) < 0) {
+      node = node->right;
+    } else {
+      best = node;
+      node = node->left;
+    }
+  }
+  return best;
+}
+
+template <BinaryNode NodeT>
+Generator<typename NodeT::key_type> inOrder(NodeT *root) {
+  for (NodeT *node = leftmost(root); node; node = next(node))
+    if (!NODE::isTombstone(node))
+      co_yield node->key;
+}
+
+template <BinaryNode NodeT>
+Generator<typename NodeT::key_type> reverseOrder(NodeT *root) {
+  for (NodeT *node = rightmost(root); node; node = prev(node))
+    if (!NODE::isTombstone(node))
+      co_yield node->key;
+}
+
+// keys in [lo, hi)
+template <BinaryNode NodeT, typename Compare = std::compare_three_way>
+Generator<typename NodeT::key_type> range(NodeT *root,
+                                          typename NodeT::key_type lo,
+                                          typename NodeT::key_type hi,
+                                          Compare cmp = {}) {
+  for (NodeT *node = lowerBound(root, lo, cmp); node && cmp(node->key, hi) < 0;
+       node = next(node))
+    if (!NODE::isTombstone(node))
+      co_yield node->key;
+}
+
+// keys >= lo, unbounded above ("first 100 keys >= x")
+template <BinaryNode NodeT, typename Compare = std::compare_three_way>
+Generator<typename NodeT::key_type>
+from(NodeT *root, typename NodeT::key_type lo, Compare cmp = {}) {
+  for (NodeT *node = lowerBound(root, lo, cmp); node; node = next(node))
+    if (!NODE::isTombstone(node))
+      co_yield node->key;
+}
+
+// breadth first; the only walk that needs a queue, which holds at most
+// two levels at a time
+template <BinaryNode NodeT>
+Generator<typename NodeT::key_type> levelOrder(NodeT *root) {
+  std::vector<NodeT *> level, nextLevel;
+  if (root)
+    level.push_back(root);
+  while (!level.empty()) {
+    nextLevel.clear();
+    for (NodeT *node : level) {
+      if (!NODE::isTombstone(node))
+        co_yield node->key;
+      if (node->left)
+        nextLevel.push_back(node->left);
+      if (node->right)
+        nextLevel.push_back(node->right);
+    }
+    level.swap(nextLevel);
+  }
+}
+
+// Lazily merge two ascending sequences, e.g. an AVL walk and a red-black
+// walk. Keys present in both are yielded once.
+template <typename Key, typename Compare = std::compare_three_way>
+Generator<Key> merge(Generator<Key> a, Generator<Key> b, Compare cmp = {}) {
+  auto ia = a.begin();
+  auto ib = b.begin();
+  while (ia != a.end() && ib != b.end()) {
+    auto order = cmp(*ia, *ib);
+    if (order < 0) {
+      co_yield *ia;
+      ++ia;
+    } else if (order > 0) {
+      co_yield *ib;
+      ++ib;
+    } else {
+      co_yield *ia;
+      ++ia;
+      ++ib;
+    }
+  }
+  for (; ia != a.end(); ++ia)
+    co_yield *ia;
+  for (; ib != b.end(); ++ib)
+    co_yield *ib;
+}
+
+} // namespace TRAVERSE
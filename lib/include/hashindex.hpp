@@ -0,0 +1,191 @@
+#pragma once
+
+#include "generator.hpp"
+#include "node.hpp"
+#include "rbtree.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+namespace TREE {
+
+//-------------------------------------------------------------------------------
+//                            Hash-Indexed Ordered Set
+//-------------------------------------------------------------------------------
+
+// A balanced tree for order plus an open-addressing (linear probing) index
+// from key to tree node. Point lookups never touch the tree: the slot holds
+// the key itself, so a hit or miss costs one hash and usually one cache
+// line. Ordered operations go through the tree; successor() of a stored
+// key starts from its node via the index instead of descending from the
+// root. Both sides change together in insert()/remove().
+//
+// Tree nodes never move during insert/remove (deletion relinks nodes, it
+// does not copy keys), which is what keeps the indexed pointers valid.
+
+template <KeyComparble Key, typename Tree = RBTREE::RedBlackTree<Key>>
+class HashIndexedSet {
+public:
+  using NodeT =
+      std::remove_pointer_t<decltype(std::declval<Tree &>().getRoot())>;
+
+  explicit HashIndexedSet(std::size_t expected = 16);
+
+  HashIndexedSet(const HashIndexedSet &) = delete;
+  HashIndexedSet &operator=(const HashIndexedSet &) = delete;
+
+  bool insert(const Key &key);
+  bool contains(const Key &key) const;
+  NodeT *find(const Key &key) const;
+  bool remove(const Key &key);
+
+  std::optional<Key> minimum();
+  std::optional<Key> successor(const Key &key);
+
+  // ascending keys in [lo, hi), and everything from lo upwards
+  TRAVERSE::Generator<Key> range(const Key &lo, const Key &hi);
+  TRAVERSE::Generator<Key> from(const Key &lo);
+
+  std::size_t size() const { return count; }
+  std::size_t capacity() const { return slots.size(); }
+
+private:
+  struct Slot {
+    Key key{};
+    NodeT *node{nullptr}; // nullptr marks an empty slot
+  };
+
+  Tree tree;
+  std::vector<Slot> slots;
+  std::size_t count{0};
+  unsigned shift{64};
+
+  std::size_t home(const Key &key) const;
+  std::size_t probe(const Key &key) const; // key's slot, or the empty one
+  void grow();
+};
+
+//-------------------------------------------------------------------------------
+//                         HashIndexedSet Implementation
+//-------------------------------------------------------------------------------
+
+template <KeyComparble Key, typename Tree>
+HashIndexedSet<Key, Tree>::HashIndexedSet(std::size_t expected) {
+  std::size_t cap = 16;
+  while (cap < 2 * expected) // load factor stays at or below 1/2
+    cap *= 2;
+  slots.resize(cap);
+  for (shift = 64; cap > 1; cap >>= 1)
+    --shift;
+}
+
+// Fibonacci hashing: spreads std::hash's identity for integers across the
+// top bits, which pick the slot
+template <KeyComparble Key, typename Tree>
+std::size_t HashIndexedSet<Key, Tree>::home(const Key &key) const {
+  std::uint64_t h = std::hash<Key>{}(key);
+  return std::size_t((h * 0x9e3779b97f4a7c15ull) >> shift);
+}
+
+template <KeyComparble Key, typename Tree>
+std::size_t HashIndexedSet<Key, Tree>::probe(const Key &key) const {
+  std::size_t mask = slots.size() - 1;
+  std::size_t i = home(key);
+  while (slots[i].node != nullptr && !(slots[i].key == key))
+    i = (i + 1) & mask;
+  return i;
+}
+
+template <KeyComparble Key, typename Tree>
+void HashIndexedSet<Key, Tree>::grow() {
+  std::vector<Slot> old(slots.size() * 2);
+  old.swap(slots);
+  --shift;
+  for (const Slot &slot : old)
+    if (slot.node != nullptr)
+      slots[probe(slot.key)] = slot;
+}
+
+template <KeyComparble Key, typename Tree>
+bool HashIndexedSet<Key, Tree>::insert(const Key &key) {
+  std::size_t i = probe(key);
+  if (slots[i].node != nullptr)
+    return false;
+
+  // a null hint still takes the append path, and otherwise the tree's
+  // single descent; either way the node comes back without a search
+  slots[i] = {key, tree.insert(nullptr, key)};
+  if (++count * 2 > slots.size())
+    grow();
+  return true;
+}
+
+template <KeyComparble Key, typename Tree>
+bool HashIndexedSet<Key, Tree>::contains(const Key &key) const {
+  return slots[probe(key)].node != nullptr;
+}
+
+template <KeyComparble Key, typename Tree>
+typename HashIndexedSet<Key, Tree>::NodeT *
+HashIndexedSet<Key, Tree>::find(const Key &key) const {
+  return slots[probe(key)].node;
+}
+
+// Backward-shift deletion keeps probe chains intact without tombstones
+template <KeyComparble Key, typename Tree>
+bool HashIndexedSet<Key, Tree>::remove(const Key &key) {
+  std::size_t i = probe(key);
+  if (slots[i].node == nullptr)
+    return false;
+
+  tree.remove(key);
+  --count;
+
+  std::size_t mask = slots.size() - 1;
+  for (std::size_t j = (i + 1) & mask; slots[j].node != nullptr;
+       j = (j + 1) & mask) {
+    std::size_t k = home(slots[j].key);
+    // move j back into the hole unless its home lies in (i, j]
+    bool stays = i <= j ? (i < k && k <= j) : (i < k || k <= j);
+    if (!stays) {
+      slots[i] = slots[j];
+      i = j;
+    }
+  }
+  slots[i] = Slot{};
+  return true;
+}
+
+template <KeyComparble Key, typename Tree>
+std::optional<Key> HashIndexedSet<Key, Tree>::minimum() {
+  NodeT *node = TRAVERSE::leftmost(tree.getRoot());
+  return node ? std::optional<Key>(node->key) : std::nullopt;
+}
+
+// Smallest key strictly greater than `key`, which need not be stored
+template <KeyComparble Key, typename Tree>
+std::optional<Key> HashIndexedSet<Key, Tree>::successor(const Key &key) {
+  NodeT *node = find(key);
+  if (node != nullptr) {
+    node = TRAVERSE::next(node);
+  } else {
+    node = TRAVERSE::lowerBound(tree.getRoot(), key, tree.comparator());
+  }
+  return node ? std::optional<Key>(node->key) : std::nullopt;
+}
+
+template <KeyComparble Key, typename Tree>
+TRAVERSE::Generator<Key> HashIndexedSet<Key, Tree>::range(const Key &lo,
+                                                          const Key &hi) {
+  return TRAVERSE::range(tree.getRoot(), lo, hi, tree.comparator());
+}
+
+template <KeyComparble Key, typename Tree>
+TRAVERSE::Generator<Key> HashIndexedSet<Key, Tree>::from(const Key &lo) {
+  return TRAVERSE::from(tree.getRoot(), lo, tree.comparator());
+}
+
+} // namespace TREE
@@ -0,0 +1,196 @@
+#pragma once
+
+#include "node.hpp"
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace LAYOUT {
+
+//-------------------------------------------------------------------------------
+//                                 Node Layout
+//-------------------------------------------------------------------------------
+
+// BFS puts every level next to each other; van Emde Boas recursively stores
+// the top half of the tree and then each bottom subtree as one block, so a
+// root-to-leaf walk touches O(log_B n) cache lines for any block size B
+enum class Order { BFS, VEB };
+
+template <BinaryNode NodeT> int height(NodeT *root) {
+  int levels = 0;
+  std::vector<NodeT *> level, next;
+  if (root)
+    level.push_back(root);
+  while (!level.empty()) {
+    ++levels;
+    next.clear();
+    for (NodeT *node : level) {
+      if (node->left)
+        next.push_back(node->left);
+      if (node->right)
+        next.push_back(node->right);
+    }
+    level.swap(next);
+  }
+  return levels;
+}
+
+template <BinaryNode NodeT> std::vector<NodeT *> bfsOrder(NodeT *root) {
+  std::vector<NodeT *> out;
+  if (root)
+    out.push_back(root);
+  for (std::size_t i = 0; i < out.size(); ++i) {
+    if (out[i]->left)
+      out.push_back(out[i]->left);
+    if (out[i]->right)
+      out.push_back(out[i]->right);
+  }
+  return out;
+}
+
+// emit the nodes of node's subtree that are less than `levels` deep
+template <BinaryNode NodeT>
+void vebFill(NodeT *node, int levels, std::vector<NodeT *> &out) {
+  if (node == nullptr)
+    return;
+  if (levels == 1) {
+    out.push_back(node);
+    return;
+  }
+
+  int top = levels / 2;
+  vebFill(node, top, out);
+
+  // the roots of the bottom subtrees sit exactly `top` levels down
+  std::vector<std::pair<NodeT *, int>> stack{{node, 0}};
+  std::vector<NodeT *> bottoms;
+  while (!stack.empty()) {
+    auto [cur, depth] = stack.back();
+    stack.pop_back();
+    if (depth == top) {
+      bottoms.push_back(cur);
+      continue;
+    }
+    if (cur->right)
+      stack.push_back({cur->right, depth + 1});
+    if (cur->left)
+      stack.push_back({cur->left, depth + 1});
+  }
+  for (NodeT *bottom : bottoms)
+    vebFill(bottom, levels - top, out);
+}
+
+template <BinaryNode NodeT> std::vector<NodeT *> vebOrder(NodeT *root) {
+  std::vector<NodeT *> out;
+  vebFill(root, height(root), out);
+  return out;
+}
+
+//-------------------------------------------------------------------------------
+//                                  Node Arena
+//-------------------------------------------------------------------------------
+
+// One contiguous block holding a tree's nodes after relayout(). Nodes that
+// were inserted later still come from the heap, so the owning tree frees
+// every node through release(), which knows which is which.
+
+template <BinaryNode NodeT> class Arena {
+public:
+  Arena() = default;
+  ~Arena() { free(); }
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+  Arena(Arena &&other) noexcept { swap(other); }
+  Arena &operator=(Arena &&other) noexcept {
+    swap(other);
+    return *this;
+  }
+
+  bool owns(const NodeT *node) const {
+    return node >= slots && node < slots + capacity;
+  }
+  std::size_t size() const { return live; }
+
+  void release(NodeT *node);
+
+  // Move every node reachable from root into a fresh block in `order`,
+  // patch left/right/parent, redirect `refs` and free the old copies.
+  // Returns the new root.
+  NodeT *relayout(NodeT *root, Order order, std::vector<NodeT *> &refs);
+
+private:
+  NodeT *slots{nullptr};
+  std::size_t capacity{0};
+  std::size_t live{0};
+
+  void free();
+  void swap(Arena &other) noexcept {
+    std::swap(slots, other.slots);
+    std::swap(capacity, other.capacity);
+    std::swap(live, other.live);
+  }
+};
+
+//-------------------------------------------------------------------------------
+//                             Arena Implementation
+//-------------------------------------------------------------------------------
+
+template <BinaryNode NodeT> void Arena<NodeT>::free() {
+  if (slots)
+    std::allocator<NodeT>().deallocate(slots, capacity);
+  slots = nullptr;
+  capacity = live = 0;
+}
+
+template <BinaryNode NodeT> void Arena<NodeT>::release(NodeT *node) {
+  if (!owns(node)) {
+    delete node;
+    return;
+  }
+  std::destroy_at(node);
+  if (--live == 0) // the block is empty, give it back
+    free();
+}
+
+template <BinaryNode NodeT>
+NodeT *Arena<NodeT>::relayout(NodeT *root, Order order,
+                              std::vector<NodeT *> &refs) {
+  std::vector<NodeT *> seq =
+      order == Order::BFS ? bfsOrder(root) : vebOrder(root);
+  if (seq.empty())
+    return root;
+
+  std::size_t n = seq.size();
+  NodeT *block = std::allocator<NodeT>().allocate(n);
+  for (std::size_t i = 0; i < n; ++i)
+    std::construct_at(block + i, std::move(*seq[i]));
+
+  // the old nodes are dead now; their parent field becomes a forwarding
+  // address, so fixing a link is one load instead of a hash lookup
+  for (std::size_t i = 0; i < n; ++i)
+    seq[i]->parent = block + i;
+  auto forward = [](NodeT *old) { return old ? old->parent : nullptr; };
+  for (std::size_t i = 0; i < n; ++i) {
+    block[i].left = forward(block[i].left);
+    block[i].right = forward(block[i].right);
+    block[i].parent = forward(block[i].parent);
+  }
+  for (NodeT *&ref : refs)
+    ref = forward(ref);
+  NodeT *newRoot = forward(root);
+
+  for (NodeT *old : seq) {
+    if (owns(old))
+      std::destroy_at(old);
+    else
+      delete old;
+  }
+  free(); // every node of the previous block was in the tree
+  slots = block;
+  capacity = live = n;
+  return newRoot;
+}
+
+} // namespace LAYOUT
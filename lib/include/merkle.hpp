@@ -0,0 +1,178 @@
+#pragma once
+
+#include "node.hpp"
+#include <compare>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+namespace MERKLE {
+
+//-------------------------------------------------------------------------------
+//                               Subtree Hashing
+//-------------------------------------------------------------------------------
+
+// Every node caches the hash of the key multiset below it:
+//   hash(node) = hash(left) + hash(right) + count * keyHash(key)  (mod 2^64)
+// A sum is independent of tree shape, so two trees holding the same keys
+// agree on the root hash even if they were built in different orders, and
+// rotations only need to re-pull the two rotated nodes. Tombstoned nodes
+// contribute nothing.
+//
+// diff() walks tree A and, for each subtree it visits, asks B for the hash
+// of the same open key range in O(log n). Subtrees whose hashes match are
+// skipped, so d differences cost O(d log^2 n).
+
+inline std::uint64_t mix(std::uint64_t x) {
+  // splitmix64 finaliser
+  x += 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+template <typename Key> std::uint64_t keyHash(const Key &key) {
+  return mix(std::hash<Key>{}(key));
+}
+
+// copies of the node's key the tree holds, 0 for a tombstone
+template <BinaryNode NodeT> std::uint64_t liveCount(const NodeT *node) {
+  return NODE::isTombstone(node) ? 0 : NODE::copies(node);
+}
+
+template <BinaryNode NodeT> std::uint64_t ownHash(const NodeT *node) {
+  return liveCount(node) * keyHash(node->key);
+}
+
+template <BinaryNode NodeT> std::uint64_t subtreeHash(const NodeT *node) {
+  return node ? node->hash : 0;
+}
+
+// recompute one node from its (already correct) children
+template <BinaryNode NodeT> void pull(NodeT *node) {
+  if (node)
+    node->hash = subtreeHash(node->left) + subtreeHash(node->right) +
+                 ownHash(node);
+}
+
+template <BinaryNode NodeT> void pullToRoot(NodeT *node) {
+  for (; node != nullptr; node = node->parent)
+    pull(node);
+}
+
+// recompute every node, children before parents
+template <BinaryNode NodeT> void rehash(NodeT *root) {
+  std::vector<NodeT *> order, stack;
+  if (root)
+    stack.push_back(root);
+  while (!stack.empty()) {
+    NodeT *node = stack.back();
+    stack.pop_back();
+    order.push_back(node);
+    if (node->left)
+      stack.push_back(node->left);
+    if (node->right)
+      stack.push_back(node->right);
+  }
+  for (auto it = order.rbegin(); it != order.rend(); ++it)
+    pull(*it);
+}
+
+// Key walks below take the tree's three-way comparator; the default is the
+// natural order.
+
+// hash of live keys k with k < bound (or k <= bound when inclusive)
+template <BinaryNode NodeT, typename Key,
+          typename Compare = std::compare_three_way>
+std::uint64_t hashBelow(const NodeT *node, const Key &bound, bool inclusive,
+                        Compare cmp = {}) {
+  std::uint64_t acc = 0;
+  while (node) {
+    auto order = cmp(node->key, bound);
+    bool take = inclusive ? order <= 0 : order < 0;
+    if (take) {
+      acc += subtreeHash(node->left) + ownHash(node);
+      node = node->right;
+    } else {
+      node = node->left;
+    }
+  }
+  return acc;
+}
+
+// hash of live keys in the open range (lo, hi); null bounds are unbounded
+template <BinaryNode NodeT, typename Key,
+          typename Compare = std::compare_three_way>
+std::uint64_t rangeHash(const NodeT *root, const Key *lo, const Key *hi,
+                        Compare cmp = {}) {
+  std::uint64_t upto =
+      hi ? hashBelow(root, *hi, false, cmp) : subtreeHash(root);
+  std::uint64_t below = lo ? hashBelow(root, *lo, true, cmp) : 0;
+  return upto - below;
+}
+
+template <BinaryNode NodeT, typename Key,
+          typename Compare = std::compare_three_way>
+std::uint64_t countLive(const NodeT *node, const Key &key, Compare cmp = {}) {
+  while (node) {
+    auto order = cmp(key, node->key);
+    if (order == 0)
+      return liveCount(node);
+    node = order < 0 ? node->left : node->right;
+  }
+  return 0;
+}
+
+// append live keys of `root` inside (lo, hi) in order
+template <BinaryNode NodeT, typename Key,
+          typename Compare = std::compare_three_way>
+void collectRange(const NodeT *node, const Key *lo, const Key *hi,
+                  std::vector<Key> &out, Compare cmp = {}) {
+  if (!node)
+    return;
+  bool aboveLo = !lo || cmp(*lo, node->key) < 0;
+  bool belowHi = !hi || cmp(node->key, *hi) < 0;
+  if (aboveLo)
+    collectRange(node->left, lo, hi, out, cmp);
+  if (aboveLo && belowHi && !NODE::isTombstone(node))
+    out.push_back(node->key);
+  if (belowHi)
+    collectRange(node->right, lo, hi, out, cmp);
+}
+
+template <BinaryNode ANode, BinaryNode BNode, typename Key,
+          typename Compare = std::compare_three_way>
+void diffRange(const ANode *a, const BNode *bRoot, const Key *lo, const Key *hi,
+               std::vector<Key> &out, Compare cmp = {}) {
+  std::uint64_t theirs = rangeHash(bRoot, lo, hi, cmp);
+  if (subtreeHash(a) == theirs)
+    return;
+  if (!a) { // everything B has in this range is missing from A
+    collectRange(bRoot, lo, hi, out, cmp);
+    return;
+  }
+
+  diffRange(a->left, bRoot, lo, &a->key, out, cmp);
+  if (liveCount(a) != countLive(bRoot, a->key, cmp))
+    out.push_back(a->key);
+  diffRange(a->right, bRoot, &a->key, hi, out, cmp);
+}
+
+// keys whose live multiplicity differs between the two trees (for sets:
+// keys present in exactly one of them), in the trees' order
+template <BinaryNode ANode, BinaryNode BNode,
+          typename Compare = std::compare_three_way>
+auto diff(const ANode *a, const BNode *b, Compare cmp = {}) {
+  using Key = std::remove_cv_t<decltype(a->key)>;
+  std::vector<Key> out;
+  diffRange<ANode, BNode, Key>(a, b, nullptr, nullptr, out, cmp);
+  return out;
+}
+
+template <BinaryNode ANode, BinaryNode BNode>
+bool equals(const ANode *a, const BNode *b) {
+  return subtreeHash(a) == subtreeHash(b);
+}
+
+} // namespace MERKLE
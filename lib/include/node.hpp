@@ -1,20 +1,123 @@
 #pragma once
+#include "nodepool.hpp"
+#include <compare>
 #include <concepts>
+#include <cstddef>
+#include <cstdint>
 
 template <typename Key>
 concept KeyComparble = std::totally_ordered<Key>;
 
-template <KeyComparble Key> struct BSTNode {
+// Three-way comparator for a tree's keys: cmp(a, b) orders a against b in
+// one call, the way `a <=> b` does. std::compare_three_way is the natural
+// order; anything returning a std::*_ordering (descending, collated,
+// case-insensitive...) plugs in the same way.
+template <typename Compare, typename Key>
+concept ThreeWayComparator = requires(const Compare &cmp, const Key &a) {
+  { cmp(a, a) } -> std::convertible_to<std::partial_ordering>;
+};
+
+// Reverse any three-way order, e.g. Descending<> for largest-first trees
+template <typename Compare = std::compare_three_way> struct Descending {
+  [[no_unique_address]] Compare cmp{};
+
+  template <typename A, typename B>
+  constexpr auto operator()(const A &a, const B &b) const {
+    return cmp(b, a);
+  }
+};
+
+// Any linked binary tree node: BSTNode, RBTNode and friends
+template <typename NodeT>
+concept BinaryNode = requires(NodeT *n) {
+  n->key;
+  { n->left } -> std::convertible_to<NodeT *>;
+  { n->right } -> std::convertible_to<NodeT *>;
+  { n->parent } -> std::convertible_to<NodeT *>;
+};
+
+//-------------------------------------------------------------------------------
+//                               Optional Fields
+//-------------------------------------------------------------------------------
+
+// Features a tree can be declared with, or-ed into its Features parameter,
+// e.g. AVLTree<int, std::compare_three_way, NODE::HASHING>. Nodes store only
+// the fields for the features their tree was declared with, so a plain tree
+// pays nothing for lazy deletion, hashing or multisets.
+namespace NODE {
+
+inline constexpr unsigned LAZY_DELETE = 1; // tombstone + queued flags
+inline constexpr unsigned HASHING = 2;     // 64-bit subtree hash
+inline constexpr unsigned MULTISET = 4;    // 32-bit multiplicity
+inline constexpr unsigned ALL = LAZY_DELETE | HASHING | MULTISET;
+
+template <bool> struct Hash {};
+template <> struct Hash<true> {
+  std::uint64_t hash{0}; // subtree hash, kept only while the tree hashes
+};
+
+template <bool> struct Count {};
+template <> struct Count<true> {
+  std::uint32_t count{1}; // multiplicity in multiset mode
+};
+
+template <bool> struct Lazy {};
+template <> struct Lazy<true> {
+  bool tombstone{false}; // lazily deleted, still linked
+  bool queued{false};    // sitting in the tree's compaction queue
+};
+
+// widest first, so the fields pack into as few words as they can
+template <unsigned Features>
+struct Extras : Hash<(Features & HASHING) != 0>,
+                Count<(Features & MULTISET) != 0>,
+                Lazy<(Features & LAZY_DELETE) != 0> {};
+
+// Readable on any node: without LAZY_DELETE nothing is a tombstone, without
+// MULTISET every key is held once
+template <typename NodeT> constexpr bool isTombstone(const NodeT *node) {
+  if constexpr (requires { node->tombstone; })
+    return node->tombstone;
+  else
+    return false;
+}
+
+template <typename NodeT> constexpr std::uint32_t copies(const NodeT *node) {
+  if constexpr (requires { node->count; })
+    return node->count;
+  else
+    return 1;
+}
+
+} // namespace NODE
+
+//-------------------------------------------------------------------------------
+//                                  Tree Nodes
+//-------------------------------------------------------------------------------
+
+// The small fields sit right after the key, so with int keys and no
+// features a node is 32 bytes
+
+template <KeyComparble Key, unsigned Features = 0>
+struct BSTNode : NODE::Extras<Features> {
   using key_type = Key;
 
   key_type key;
+  int height{1};
   BSTNode *left{nullptr};
   BSTNode *right{nullptr};
   BSTNode *parent{nullptr};
-  int height{1};
 
   explicit BSTNode(const key_type &k) noexcept : key(k) {}
 
+  // nodes come from per-thread slab caches, see nodepool.hpp
+  static void *operator new(std::size_t size) {
+    return POOL::Pooled<BSTNode>::allocate(size);
+  }
+  static void operator delete(void *ptr, std::size_t size) {
+    POOL::Pooled<BSTNode>::release(ptr, size);
+  }
+
   BSTNode(const BSTNode &) = delete;
   BSTNode &operator=(const BSTNode &) = delete;
   BSTNode(BSTNode &&) noexcept = default;
@@ -23,19 +126,28 @@ template <KeyComparble Key> struct BSTNode {
   ~BSTNode() = default;
 };
 
-template <KeyComparble Key> struct RBTNode {
+template <KeyComparble Key, unsigned Features = 0>
+struct RBTNode : NODE::Extras<Features> {
   using key_type = Key;
 
   enum Color { RED, BLACK };
 
   key_type key;
+  Color color{RED}; // New node default red
   RBTNode *left{nullptr};
   RBTNode *right{nullptr};
   RBTNode *parent{nullptr};
-  Color color{RED}; // New node default red
 
   explicit RBTNode(const key_type &k) noexcept : key(k) {}
 
+  // nodes come from per-thread slab caches, see nodepool.hpp
+  static void *operator new(std::size_t size) {
+    return POOL::Pooled<RBTNode>::allocate(size);
+  }
+  static void operator delete(void *ptr, std::size_t size) {
+    POOL::Pooled<RBTNode>::release(ptr, size);
+  }
+
   RBTNode(const RBTNode &) = delete;
   RBTNode &operator=(const RBTNode &) = delete;
   RBTNode(RBTNode &&) noexcept = default;
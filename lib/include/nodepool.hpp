@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace POOL {
+
+//-------------------------------------------------------------------------------
+//                                  Node Pool
+//-------------------------------------------------------------------------------
+
+// Fixed-size blocks for tree nodes, one pool per 16-byte size class, so
+// BSTNode<int> and RBTNode<int> (both 32 bytes in a plain tree) draw from
+// the same slabs.
+//
+// Every thread keeps its own free list and only touches the shared pool
+// once per BATCH blocks: an empty list takes a whole batch, a list holding
+// 2 * BATCH gives one back. Blocks may be freed by another thread than the
+// one that allocated them; they simply join the freeing thread's list. A
+// thread's leftovers go back to the shared pool when it exits.
+//
+// Slabs are carved from ::operator new and kept for the life of the
+// process; freed nodes are reused, never handed back to the system.
+
+inline constexpr std::size_t sizeClass(std::size_t bytes) {
+  return (bytes + 15) / 16 * 16;
+}
+
+template <std::size_t Bytes> class NodePool {
+public:
+  static constexpr std::size_t BATCH = 64;
+  static constexpr std::size_t SLAB_BYTES = 64 * 1024;
+
+  static_assert(Bytes % 16 == 0 && Bytes >= sizeof(void *));
+
+  static void *allocate() {
+    Local &local = mine();
+    if (local.head == nullptr)
+      local.refill();
+    Block *block = local.head;
+    local.head = block->next;
+    --local.count;
+    return block;
+  }
+
+  static void release(void *ptr) {
+    Local &local = mine();
+    auto *block = static_cast<Block *>(ptr);
+    block->next = local.head;
+    local.head = block;
+    if (++local.count >= 2 * BATCH)
+      local.spill();
+  }
+
+  // bytes obtained from the system so far, across all threads
+  static std::size_t reserved() {
+    Shared &pool = shared();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    return pool.slabs * SLAB_BYTES;
+  }
+
+private:
+  struct Block {
+    Block *next;
+  };
+
+  struct Batch {
+    Block *head;
+    std::size_t count;
+  };
+
+  struct Shared {
+    std::mutex mutex;
+    std::vector<Batch> batches;
+    std::size_t slabs{0};
+  };
+
+  struct Local {
+    Block *head{nullptr};
+    std::size_t count{0};
+
+    void refill();
+    void spill();
+    ~Local();
+  };
+
+  // never destroyed: thread-exit handlers may run after static destructors
+  static Shared &shared() {
+    static Shared *pool = new Shared;
+    return *pool;
+  }
+
+  static Local &mine() {
+    thread_local Local local;
+    return local;
+  }
+
+  static Batch carve();
+};
+
+//-------------------------------------------------------------------------------
+//                             NodePool Implementation
+//-------------------------------------------------------------------------------
+
+// Called with the shared mutex held; one slab yields several batches
+template <std::size_t Bytes>
+typename NodePool<Bytes>::Batch NodePool<Bytes>::carve() {
+  Shared &pool = shared();
+  auto *slab = static_cast<char *>(::operator new(SLAB_BYTES));
+  ++pool.slabs;
+
+  Batch batch{nullptr, 0};
+  for (std::size_t off = 0; off + Bytes <= SLAB_BYTES; off += Bytes) {
+    auto *block = reinterpret_cast<Block *>(slab + off);
+    block->next = batch.head;
+    batch.head = block;
+    if (++batch.count == BATCH) {
+      pool.batches.push_back(batch);
+      batch = {nullptr, 0};
+    }
+  }
+  if (batch.count == 0) {
+    batch = pool.batches.back();
+    pool.batches.pop_back();
+  }
+  return batch;
+}
+
+template <std::size_t Bytes> void NodePool<Bytes>::Local::refill() {
+  Shared &pool = shared();
+  std::lock_guard<std::mutex> lock(pool.mutex);
+  Batch batch;
+  if (pool.batches.empty()) {
+    batch = carve();
+  } else {
+    batch = pool.batches.back();
+    pool.batches.pop_back();
+  }
+  head = batch.head;
+  count = batch.count;
+}
+
+// Keep the BATCH most recently freed (cache-warm) blocks, hand the older
+// half over in one push
+template <std::size_t Bytes> void NodePool<Bytes>::Local::spill() {
+  Block *last = head;
+  for (std::size_t i = 1; i < BATCH; ++i)
+    last = last->next;
+  Batch batch{std::exchange(last->next, nullptr), count - BATCH};
+  count = BATCH;
+
+  Shared &pool = shared();
+  std::lock_guard<std::mutex> lock(pool.mutex);
+  pool.batches.push_back(batch);
+}
+
+template <std::size_t Bytes> NodePool<Bytes>::Local::~Local() {
+  if (head == nullptr)
+    return;
+  Shared &pool = shared();
+  std::lock_guard<std::mutex> lock(pool.mutex);
+  pool.batches.push_back({head, count});
+}
+
+// Class-level operator new/delete for a node type
+template <typename NodeT> struct Pooled {
+  using Pool = NodePool<sizeClass(sizeof(NodeT))>;
+
+  static_assert(alignof(NodeT) <= 16);
+
+  static void *allocate(std::size_t size) {
+    if (size != sizeof(NodeT)) // a derived type; not ours to serve
+      return ::operator new(size);
+    return Pool::allocate();
+  }
+  static void release(void *ptr, std::size_t size) {
+    if (size != sizeof(NodeT))
+      ::operator delete(ptr);
+    else
+      Pool::release(ptr);
+  }
+};
+
+} // namespace POOL
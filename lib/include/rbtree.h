@@ -1,9 +1,13 @@
 #pragma once
 
+#include "layout.hpp"
+#include "merkle.hpp"
 #include "node.hpp"
 #include "util.hpp"
+#include <cstddef>
 #include <initializer_list>
 #include <string>
+#include <vector>
 
 namespace RBTREE {
 
@@ -11,19 +15,28 @@ namespace RBTREE {
 //                              Red-Black Trees
 //-------------------------------------------------------------------------------
 
-template <KeyComparble Key> class RedBlackTree {
+template <KeyComparble Key,
+          ThreeWayComparator<Key> Compare = std::compare_three_way,
+          unsigned Features = 0>
+class RedBlackTree {
 protected:
-  using NodeT = RBTNode<Key>;
-  using Color = typename RBTNode<Key>::Color;
+  using NodeT = RBTNode<Key, Features>;
+  using Color = typename RBTNode<Key, Features>::Color;
   NodeT *root;
+  [[no_unique_address]] Compare cmp; // cmp(a, b) < 0 sends a to the left
+
+  // the optional node fields this tree was declared with, see NODE
+  static constexpr bool LAZY = (Features & NODE::LAZY_DELETE) != 0;
+  static constexpr bool HASHED = (Features & NODE::HASHING) != 0;
+  static constexpr bool COUNTED = (Features & NODE::MULTISET) != 0;
 
   // Basic BST operations
-  NodeT *insertNode(NodeT *node, int key, NodeT *parent);
-  NodeT *searchNode(NodeT *node, int key);
+  NodeT *searchNode(NodeT *node, const Key &key);
   NodeT *deleteNode(NodeT *root, NodeT *node);
   NodeT *minimumNode(NodeT *node);
   NodeT *maximumNode(NodeT *node);
   NodeT *successorNode(NodeT *node);
+  NodeT *predecessorNode(NodeT *node);
   void transplant(NodeT *u, NodeT *v);
 
   // Red-Black Tree specific operations
@@ -38,80 +51,131 @@ protected:
   Color getColor(NodeT *node);
   NodeT *getSibling(NodeT *node);
 
+  // Lazy deletion: remove() only marks a tombstone and queues the node;
+  // compactStep()/compact() unlink them later in batches
+  bool lazyDelete{false};
+  std::size_t tombstones{0};
+  std::vector<NodeT *> graveyard;
+
+  bool bury(NodeT *node);
+  bool revive(NodeT *node);
+  NodeT *liveFrom(NodeT *node);
+
+  // Subtree hashing: while enabled every node carries MERKLE's hash of its
+  // subtree; rotations re-pull the two nodes they move, structural changes
+  // re-pull the path above them. hashNode()/hashPath() do nothing while
+  // hashing is off.
+  bool hashing{false};
+
+  void hashNode(NodeT *node);
+  void hashPath(NodeT *node);
+
+  // Nodes moved into one block by defragment(); everything is freed
+  // through arena.release(), heap nodes included
+  LAYOUT::Arena<NodeT> arena;
+
+  // Multiset mode: an equal key bumps the node's count instead of being
+  // dropped
+  bool multiset{false};
+
+  std::size_t addCopy(NodeT *node);
+
+  // Cached maximum, so appends (key above everything stored) attach
+  // without a descent. nullptr means "unknown"; maxNode() refills it.
+  NodeT *rightmost{nullptr};
+
+  NodeT *maxNode();
+  NodeT *attach(NodeT *parent, bool right, const Key &key);
+  NodeT *place(const Key &key);
+
 public:
   virtual ~RedBlackTree() = default;
 
   // Constructor
   RedBlackTree();
-  RedBlackTree(std::initializer_list<int> list);
-  virtual RedBlackTree &operator=(std::initializer_list<int> list);
+  explicit RedBlackTree(const Compare &compare);
+  RedBlackTree(std::initializer_list<Key> list);
+  virtual RedBlackTree &operator=(std::initializer_list<Key> list);
 
   NodeT *getRoot();
-  virtual void insert(int key);
-  virtual NodeT *search(int key);
-  virtual void remove(int key);
+  const Compare &comparator() const;
+  virtual std::size_t insert(const Key &key);
+  NodeT *insert(NodeT *hint, const Key &key);
+  virtual NodeT *search(const Key &key);
+  virtual void remove(const Key &key);
   NodeT *minimum();
   NodeT *maximum();
-  NodeT *successor(int key);
+  NodeT *successor(const Key &key);
   void printWithoutPrefix(NodeT *node);
   void printWithPrefix(const std::string &prefix, NodeT *node);
+
+  // need the matching NODE feature in the tree type
+  void setLazyDelete(bool enabled);
+  std::size_t tombstoneCount() const;
+  std::size_t compactStep(std::size_t budget);
+  void compact();
+
+  void setHashing(bool enabled);
+  bool equals(RedBlackTree &other);
+  std::vector<Key> diff(RedBlackTree &other);
+
+  void defragment(LAYOUT::Order order = LAYOUT::Order::VEB);
+
+  void setMultiset(bool enabled);
+  std::size_t count(const Key &key);
+  std::size_t removeOne(const Key &key);
 };
 
 //-------------------------------------------------------------------------------
 //                        RedBlackTree Implementation
 //-------------------------------------------------------------------------------
 
-template <KeyComparble Key> RedBlackTree<Key>::RedBlackTree() : root(nullptr) {}
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+RedBlackTree<Key, Compare, Features>::RedBlackTree() : root(nullptr) {}
 
-template <KeyComparble Key>
-RedBlackTree<Key>::RedBlackTree(std::initializer_list<int> list) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+RedBlackTree<Key, Compare, Features>::RedBlackTree(const Compare &compare)
+    : root(nullptr), cmp(compare) {}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+RedBlackTree<Key, Compare, Features>::RedBlackTree(
+    std::initializer_list<Key> list) {
   root = nullptr;
-  for (int key : list) {
+  for (const Key &key : list) {
     insert(key);
   }
 }
 
-template <KeyComparble Key>
-RedBlackTree<Key> &
-RedBlackTree<Key>::operator=(std::initializer_list<int> list) {
-  for (int key : list) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+RedBlackTree<Key, Compare, Features> &
+RedBlackTree<Key, Compare, Features>::operator=(
+    std::initializer_list<Key> list) {
+  for (const Key &key : list) {
     insert(key);
   }
   return *this;
 }
 
-template <KeyComparble Key>
-RBTNode<Key> *RedBlackTree<Key>::insertNode(NodeT *node, int key,
-                                            NodeT *parent) {
-  if (node == nullptr) {
-    NodeT *newNode = new NodeT(key);
-    newNode->parent = parent;
-    newNode->color = Color::RED; // New nodes are always red
-    return newNode;
-  }
-
-  if (key < node->key) {
-    node->left = insertNode(node->left, key, node);
-  } else if (key > node->key) {
-    node->right = insertNode(node->right, key, node);
-  }
-
-  return node;
-}
-
-template <KeyComparble Key>
-RBTNode<Key> *RedBlackTree<Key>::searchNode(NodeT *node, int key) {
-  if (node == nullptr || node->key == key) {
-    return node;
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+RBTNode<Key, Features> *
+RedBlackTree<Key, Compare, Features>::searchNode(NodeT *node, const Key &key) {
+  while (node != nullptr) { // one three-way comparison per level
+    auto order = cmp(key, node->key);
+    if (order == 0)
+      return node;
+    node = order < 0 ? node->left : node->right;
   }
-  if (key < node->key)
-    return searchNode(node->left, key);
-  else
-    return searchNode(node->right, key);
+  return nullptr;
 }
 
-template <KeyComparble Key>
-void RedBlackTree<Key>::transplant(NodeT *u, NodeT *v) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void RedBlackTree<Key, Compare, Features>::transplant(NodeT *u, NodeT *v) {
   if (u->parent == nullptr) {
     root = v;
   } else if (u == u->parent->left) {
@@ -125,15 +189,20 @@ void RedBlackTree<Key>::transplant(NodeT *u, NodeT *v) {
   }
 }
 
-template <KeyComparble Key>
-RBTNode<Key> *RedBlackTree<Key>::deleteNode(NodeT *root, NodeT *node) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+RBTNode<Key, Features> *
+RedBlackTree<Key, Compare, Features>::deleteNode(NodeT *root, NodeT *node) {
   if (node == nullptr) {
     return root;
   }
+  if (node == rightmost)
+    rightmost = nullptr;
 
   NodeT *toDelete = node;
   NodeT *replacement = nullptr;
   Color originalColor = toDelete->color;
+  NodeT *changed = node->parent; // deepest node whose subtree shrank
 
   if (node->left == nullptr) {
     replacement = node->right;
@@ -173,31 +242,40 @@ RBTNode<Key> *RedBlackTree<Key>::deleteNode(NodeT *root, NodeT *node) {
     toDelete->left->parent = toDelete;
     toDelete->color = node->color;
 
+    changed = replacementParent;
     if (originalColor == Color::BLACK) {
       fixDelete(replacement, replacementParent);
     }
   }
 
-  delete node;
+  // fixDelete's rotations keep every stale node on changed's root path
+  hashPath(changed);
+  arena.release(node);
   return this->root;
 }
 
-template <KeyComparble Key>
-RBTNode<Key> *RedBlackTree<Key>::minimumNode(NodeT *node) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+RBTNode<Key, Features> *
+RedBlackTree<Key, Compare, Features>::minimumNode(NodeT *node) {
   while (node->left != nullptr)
     node = node->left;
   return node;
 }
 
-template <KeyComparble Key>
-RBTNode<Key> *RedBlackTree<Key>::maximumNode(NodeT *node) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+RBTNode<Key, Features> *
+RedBlackTree<Key, Compare, Features>::maximumNode(NodeT *node) {
   while (node->right != nullptr)
     node = node->right;
   return node;
 }
 
-template <KeyComparble Key>
-RBTNode<Key> *RedBlackTree<Key>::successorNode(NodeT *node) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+RBTNode<Key, Features> *
+RedBlackTree<Key, Compare, Features>::successorNode(NodeT *node) {
   if (node == nullptr)
     return nullptr;
 
@@ -215,8 +293,28 @@ RBTNode<Key> *RedBlackTree<Key>::successorNode(NodeT *node) {
   return parent;
 }
 
-template <KeyComparble Key>
-RBTNode<Key> *RedBlackTree<Key>::rotateLeft(NodeT *z) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+RBTNode<Key, Features> *
+RedBlackTree<Key, Compare, Features>::predecessorNode(NodeT *node) {
+  if (node == nullptr)
+    return nullptr;
+
+  if (node->left != nullptr)
+    return maximumNode(node->left);
+
+  NodeT *parent = node->parent;
+  while (parent != nullptr && parent->left == node) {
+    node = parent;
+    parent = parent->parent;
+  }
+  return parent;
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+RBTNode<Key, Features> *
+RedBlackTree<Key, Compare, Features>::rotateLeft(NodeT *z) {
   NodeT *y = z->right;
   NodeT *T2 = y->left;
 
@@ -239,11 +337,17 @@ RBTNode<Key> *RedBlackTree<Key>::rotateLeft(NodeT *z) {
     y->parent->right = y;
   }
 
+  hashNode(z);
+
+  hashNode(y);
+
   return y;
 }
 
-template <KeyComparble Key>
-RBTNode<Key> *RedBlackTree<Key>::rotateRight(NodeT *z) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+RBTNode<Key, Features> *
+RedBlackTree<Key, Compare, Features>::rotateRight(NodeT *z) {
   NodeT *y = z->left;
   NodeT *T3 = y->right;
 
@@ -266,10 +370,16 @@ RBTNode<Key> *RedBlackTree<Key>::rotateRight(NodeT *z) {
     y->parent->right = y;
   }
 
+  hashNode(z);
+
+  hashNode(y);
+
   return y;
 }
 
-template <KeyComparble Key> void RedBlackTree<Key>::fixInsert(NodeT *node) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void RedBlackTree<Key, Compare, Features>::fixInsert(NodeT *node) {
   while (node != root && isRed(node->parent)) {
     if (node->parent == node->parent->parent->left) {
       // Parent is left child
@@ -318,8 +428,10 @@ template <KeyComparble Key> void RedBlackTree<Key>::fixInsert(NodeT *node) {
   setColor(root, Color::BLACK);
 }
 
-template <KeyComparble Key>
-void RedBlackTree<Key>::fixDelete(NodeT *node, NodeT *parent) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void RedBlackTree<Key, Compare, Features>::fixDelete(NodeT *node,
+                                                     NodeT *parent) {
   while (node != root && getColor(node) == Color::BLACK) {
     if (node == (parent ? parent->left : nullptr)) {
       NodeT *sibling = parent ? parent->right : nullptr;
@@ -389,24 +501,31 @@ void RedBlackTree<Key>::fixDelete(NodeT *node, NodeT *parent) {
   setColor(node, Color::BLACK);
 }
 
-template <KeyComparble Key> bool RedBlackTree<Key>::isRed(NodeT *node) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+bool RedBlackTree<Key, Compare, Features>::isRed(NodeT *node) {
   return node != nullptr && node->color == Color::RED;
 }
 
-template <KeyComparble Key>
-void RedBlackTree<Key>::setColor(NodeT *node, Color color) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void RedBlackTree<Key, Compare, Features>::setColor(NodeT *node, Color color) {
   if (node != nullptr) {
     node->color = color;
   }
 }
 
-template <KeyComparble Key>
-typename RedBlackTree<Key>::Color RedBlackTree<Key>::getColor(NodeT *node) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+typename RedBlackTree<Key, Compare, Features>::Color
+RedBlackTree<Key, Compare, Features>::getColor(NodeT *node) {
   return node ? node->color : Color::BLACK;
 }
 
-template <KeyComparble Key>
-RBTNode<Key> *RedBlackTree<Key>::getSibling(NodeT *node) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+RBTNode<Key, Features> *
+RedBlackTree<Key, Compare, Features>::getSibling(NodeT *node) {
   if (node == nullptr || node->parent == nullptr)
     return nullptr;
 
@@ -416,54 +535,378 @@ RBTNode<Key> *RedBlackTree<Key>::getSibling(NodeT *node) {
     return node->parent->left;
 }
 
-template <KeyComparble Key> RBTNode<Key> *RedBlackTree<Key>::getRoot() {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+RBTNode<Key, Features> *RedBlackTree<Key, Compare, Features>::getRoot() {
   return root;
 }
 
-template <KeyComparble Key> void RedBlackTree<Key>::insert(int key) {
-  root = insertNode(root, key, nullptr);
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+const Compare &RedBlackTree<Key, Compare, Features>::comparator() const {
+  return cmp;
+}
 
-  // Find the newly inserted node
-  NodeT *newNode = searchNode(root, key);
-  if (newNode) {
-    fixInsert(newNode);
+// Returns the key's multiplicity afterwards, always 1 outside multiset mode
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+std::size_t RedBlackTree<Key, Compare, Features>::insert(const Key &key) {
+  NodeT *node = place(key);
+  return multiset ? NODE::copies(node) : 1;
+}
+
+// Insert next to `hint` when key belongs right before or after it, which
+// skips the descent from the root; any other hint (or an equal key) falls
+// back to insert(key). Returns the node holding key.
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+RBTNode<Key, Features> *
+RedBlackTree<Key, Compare, Features>::insert(NodeT *hint, const Key &key) {
+  NodeT *last = maxNode();
+  if (last && cmp(key, last->key) > 0) // an append, wherever the hint points
+    return attach(last, true, key);
+
+  NodeT *at = nullptr;
+  bool right = false;
+  auto order = cmp(key, hint ? hint->key : key); // equal without a hint
+  if (order > 0) {
+    NodeT *next = successorNode(hint); // hint itself when it is the maximum
+    if (next == hint || cmp(key, next->key) < 0) {
+      right = hint->right == nullptr;
+      at = right ? hint : next; // next is leftmost under hint->right
+    }
+  } else if (order < 0) {
+    NodeT *prev = predecessorNode(hint); // nullptr when it is the minimum
+    if (prev == nullptr || cmp(key, prev->key) > 0) {
+      right = hint->left != nullptr;
+      at = right ? prev : hint; // prev is rightmost under hint->left
+    }
   }
+  if (at == nullptr)
+    return place(key);
+  return attach(at, right, key);
 }
 
-template <KeyComparble Key> RBTNode<Key> *RedBlackTree<Key>::search(int key) {
-  return searchNode(root, key);
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+RBTNode<Key, Features> *RedBlackTree<Key, Compare, Features>::maxNode() {
+  if (rightmost == nullptr && root != nullptr)
+    rightmost = maximumNode(root);
+  return rightmost;
+}
+
+// insert(key) in one descent: it finds either the key, which a tombstone
+// takes back and multiset mode counts, or the empty slot it belongs in.
+// Returns the node holding key.
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+RBTNode<Key, Features> *
+RedBlackTree<Key, Compare, Features>::place(const Key &key) {
+  NodeT *last = maxNode();
+  if (last && cmp(key, last->key) > 0) // append: nothing to revive or count
+    return attach(last, true, key);
+
+  NodeT *parent = nullptr;
+  NodeT *node = root;
+  bool right = false;
+  while (node != nullptr) {
+    auto order = cmp(key, node->key);
+    if (order == 0)
+      break;
+    parent = node;
+    right = order > 0;
+    node = right ? node->right : node->left;
+  }
+  if (node == nullptr)
+    return attach(parent, right, key);
+  if (lazyDelete && revive(node))
+    return node;
+  if (multiset)
+    addCopy(node);
+  return node; // counted, or already present and left alone
+}
+
+// Link a new red leaf under parent (an empty child slot) and fix colors;
+// fixInsert() does amortized O(1) work, so appends cost O(1) amortized
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+RBTNode<Key, Features> *
+RedBlackTree<Key, Compare, Features>::attach(NodeT *parent, bool right,
+                                             const Key &key) {
+  NodeT *node = new NodeT(key);
+  node->parent = parent;
+  if (parent == nullptr)
+    root = node;
+  else if (right)
+    parent->right = node;
+  else
+    parent->left = node;
+  if (right && parent == rightmost)
+    rightmost = node;
+  hashPath(node);
+  fixInsert(node);
+  return node;
 }
 
-template <KeyComparble Key> void RedBlackTree<Key>::remove(int key) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+RBTNode<Key, Features> *
+RedBlackTree<Key, Compare, Features>::search(const Key &key) {
   NodeT *node = searchNode(root, key);
+  return (node && !NODE::isTombstone(node)) ? node : nullptr;
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void RedBlackTree<Key, Compare, Features>::remove(const Key &key) {
+  NodeT *node = searchNode(root, key);
+  if (lazyDelete) {
+    bury(node);
+    return;
+  }
   if (node) {
     deleteNode(root, node);
   }
 }
 
-template <KeyComparble Key> RBTNode<Key> *RedBlackTree<Key>::minimum() {
-  return minimumNode(root);
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+RBTNode<Key, Features> *RedBlackTree<Key, Compare, Features>::minimum() {
+  return liveFrom(minimumNode(root));
 }
 
-template <KeyComparble Key> RBTNode<Key> *RedBlackTree<Key>::maximum() {
-  return maximumNode(root);
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+RBTNode<Key, Features> *RedBlackTree<Key, Compare, Features>::maximum() {
+  NodeT *node = maximumNode(root);
+  while (node && NODE::isTombstone(node))
+    node = predecessorNode(node);
+  return node;
 }
 
-template <KeyComparble Key>
-RBTNode<Key> *RedBlackTree<Key>::successor(int key) {
-  NodeT *node = search(key);
-  return successorNode(node);
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+RBTNode<Key, Features> *
+RedBlackTree<Key, Compare, Features>::successor(const Key &key) {
+  NodeT *node = searchNode(root, key);
+  return liveFrom(successorNode(node));
 }
 
-template <KeyComparble Key>
-void RedBlackTree<Key>::printWithoutPrefix(NodeT *node) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void RedBlackTree<Key, Compare, Features>::printWithoutPrefix(NodeT *node) {
   printTree("", node, false);
 }
 
-template <KeyComparble Key>
-void RedBlackTree<Key>::printWithPrefix(const std::string &prefix,
-                                        NodeT *node) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void RedBlackTree<Key, Compare, Features>::printWithPrefix(
+    const std::string &prefix, NodeT *node) {
   printTree(prefix, node, false);
 }
 
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+bool RedBlackTree<Key, Compare, Features>::bury(NodeT *node) {
+  if constexpr (LAZY) {
+    if (node == nullptr || node->tombstone)
+      return false;
+    node->tombstone = true;
+    ++tombstones;
+    hashPath(node);
+    if (!node->queued) { // a revived node may still be queued from before
+      node->queued = true;
+      graveyard.push_back(node);
+    }
+    return true;
+  }
+  return false;
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+bool RedBlackTree<Key, Compare, Features>::revive(NodeT *node) {
+  if constexpr (LAZY) {
+    if (node == nullptr || !node->tombstone)
+      return false;
+    node->tombstone = false; // stays queued, compactStep() skips it
+    if constexpr (COUNTED)
+      node->count = 1;
+    --tombstones;
+    hashPath(node);
+    return true;
+  }
+  return false;
+}
+
+// first live node at or after node, nullptr if there is none
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+RBTNode<Key, Features> *
+RedBlackTree<Key, Compare, Features>::liveFrom(NodeT *node) {
+  while (node && NODE::isTombstone(node)) {
+    NodeT *next = successorNode(node);
+    if (next == node) // successorNode() hands back the maximum itself
+      return nullptr;
+    node = next;
+  }
+  return node;
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void RedBlackTree<Key, Compare, Features>::setLazyDelete(bool enabled) {
+  static_assert(LAZY, "declare the tree with NODE::LAZY_DELETE");
+  if (lazyDelete && !enabled)
+    compact();
+  lazyDelete = enabled;
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+std::size_t RedBlackTree<Key, Compare, Features>::tombstoneCount() const {
+  return tombstones;
+}
+
+// Physically unlink up to `budget` queued nodes through the regular
+// deleteNode()/fixDelete() path; returns how many queue entries were consumed.
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+std::size_t
+RedBlackTree<Key, Compare, Features>::compactStep(std::size_t budget) {
+  static_assert(LAZY, "declare the tree with NODE::LAZY_DELETE");
+  std::size_t done = 0;
+  while (done < budget && !graveyard.empty()) {
+    NodeT *node = graveyard.back();
+    graveyard.pop_back();
+    node->queued = false;
+    ++done;
+    if (!node->tombstone)
+      continue; // revived since it was queued
+    node->tombstone = false;
+    --tombstones;
+    deleteNode(root, node);
+  }
+  return done;
+}
+
+// Unlink every queued tombstone now, one compactStep() at a time: O(k log n)
+// for k tombstones, no allocation, and the rest of the tree keeps its shape
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void RedBlackTree<Key, Compare, Features>::compact() {
+  static_assert(LAZY, "declare the tree with NODE::LAZY_DELETE");
+  compactStep(graveyard.size());
+}
+
+// Re-allocate every node into one contiguous block in the given order,
+// keeping the shape. Pointers to nodes obtained earlier are invalidated.
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void RedBlackTree<Key, Compare, Features>::defragment(LAYOUT::Order order) {
+  root = arena.relayout(root, order, graveyard);
+  rightmost = nullptr;
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+std::size_t RedBlackTree<Key, Compare, Features>::addCopy(NodeT *node) {
+  if constexpr (COUNTED) {
+    ++node->count;
+    hashPath(node);
+    return node->count;
+  }
+  return 1;
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void RedBlackTree<Key, Compare, Features>::setMultiset(bool enabled) {
+  static_assert(COUNTED, "declare the tree with NODE::MULTISET");
+  multiset = enabled;
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+std::size_t RedBlackTree<Key, Compare, Features>::count(const Key &key) {
+  NodeT *node = search(key);
+  return node ? NODE::copies(node) : 0;
+}
+
+// Drop one copy of key; the node goes only with its last copy. Returns the
+// multiplicity left.
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+std::size_t RedBlackTree<Key, Compare, Features>::removeOne(const Key &key) {
+  NodeT *node = search(key);
+  if (node == nullptr)
+    return 0;
+  if constexpr (COUNTED) {
+    if (node->count > 1) {
+      --node->count;
+      hashPath(node);
+      return node->count;
+    }
+  }
+  remove(key);
+  return 0;
+}
+
+// Turning hashing on hashes the existing tree once, O(n)
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void RedBlackTree<Key, Compare, Features>::setHashing(bool enabled) {
+  static_assert(HASHED, "declare the tree with NODE::HASHING");
+  if (enabled && !hashing)
+    MERKLE::rehash(root);
+  hashing = enabled;
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void RedBlackTree<Key, Compare, Features>::hashNode(NodeT *node) {
+  if constexpr (HASHED)
+    if (hashing)
+      MERKLE::pull(node);
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void RedBlackTree<Key, Compare, Features>::hashPath(NodeT *node) {
+  if constexpr (HASHED)
+    if (hashing)
+      MERKLE::pullToRoot(node);
+}
+
+// Probabilistic: equal root hashes mean equal live key sets unless two
+// different sets collide in 64 bits. A tree that is not hashing is hashed
+// for this call only, O(n); keep hashing on to compare repeatedly.
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+bool RedBlackTree<Key, Compare, Features>::equals(RedBlackTree &other) {
+  bool mine = hashing, theirs = other.hashing;
+  setHashing(true);
+  other.setHashing(true);
+  bool same = MERKLE::equals(root, other.root);
+  other.setHashing(theirs);
+  setHashing(mine);
+  return same;
+}
+
+// Live keys whose multiplicity differs between the two trees, ascending:
+// for plain sets the keys held by exactly one of them. Hashing is switched
+// on for the call only, as in equals().
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+std::vector<Key>
+RedBlackTree<Key, Compare, Features>::diff(RedBlackTree &other) {
+  bool mine = hashing, theirs = other.hashing;
+  setHashing(true);
+  other.setHashing(true);
+  std::vector<Key> keys = MERKLE::diff(root, other.root, cmp);
+  other.setHashing(theirs);
+  setHashing(mine);
+  return keys;
+}
+
 } // namespace RBTREE
@@ -0,0 +1,379 @@
+#pragma once
+
+#include "node.hpp"
+#include "nodepool.hpp"
+#include <algorithm>
+#include <compare>
+#include <cstddef>
+#include <initializer_list>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace SCAPEGOAT {
+
+//-------------------------------------------------------------------------------
+//                                 Lean Node
+//-------------------------------------------------------------------------------
+
+// Key and two children, nothing else: no parent, height, colour, count or
+// hash. 24 bytes for an int key against 32 for a plain BSTNode/RBTNode.
+template <KeyComparble Key> struct LeanNode {
+  using key_type = Key;
+
+  key_type key;
+  LeanNode *left{nullptr};
+  LeanNode *right{nullptr};
+
+  explicit LeanNode(const key_type &k) noexcept : key(k) {}
+
+  // nodes come from per-thread slab caches, see nodepool.hpp
+  static void *operator new(std::size_t size) {
+    return POOL::Pooled<LeanNode>::allocate(size);
+  }
+  static void operator delete(void *ptr, std::size_t size) {
+    POOL::Pooled<LeanNode>::release(ptr, size);
+  }
+
+  LeanNode(const LeanNode &) = delete;
+  LeanNode &operator=(const LeanNode &) = delete;
+};
+
+//-------------------------------------------------------------------------------
+//                               Scapegoat Tree
+//-------------------------------------------------------------------------------
+
+// Galperin and Rivest's scapegoat tree: a balanced ordered set that keeps no
+// balance information in its nodes. The tree as a whole remembers only its
+// size and the largest size since the last full rebuild.
+//
+// An insert that lands deeper than log_{1/alpha}(maxSize) walks back up its
+// path to the first ancestor whose child holds more than alpha of its keys
+// (the scapegoat) and rebuilds that subtree into perfect balance. Remove is
+// a plain BST delete; once size drops below alpha * maxSize the whole tree
+// is rebuilt. Rebuilds are linear: the subtree is flattened into a scratch
+// vector of node pointers that the tree keeps between calls, then relinked
+// from the middle out, so no node is allocated or copied.
+//
+// Insert and remove are O(log n) amortised, lookups O(log n) worst case.
+// Smaller alpha means shallower trees and more frequent rebuilds. Random
+// inserts alone leave a tree about 1.4 times deeper than AVL's, under the
+// 0.7 bound often quoted, so the default of 0.6 rebuilds them down to
+// AVL-like depth. Ascending inserts are the expensive case: the right spine
+// keeps hitting the bound and small subtrees are rebuilt every few inserts.
+//
+// Without parent pointers the node does not satisfy BinaryNode, so the
+// TRAVERSE walks do not apply; forEach() visits keys in order.
+
+template <KeyComparble Key,
+          ThreeWayComparator<Key> Compare = std::compare_three_way>
+class ScapegoatTree {
+public:
+  using NodeT = LeanNode<Key>;
+
+  ScapegoatTree() : ScapegoatTree(0.6) {}
+  explicit ScapegoatTree(double alpha, const Compare &compare = {});
+  ScapegoatTree(std::initializer_list<Key> list);
+  ~ScapegoatTree();
+
+  ScapegoatTree(const ScapegoatTree &) = delete;
+  ScapegoatTree &operator=(const ScapegoatTree &) = delete;
+
+  bool insert(const Key &key); // false if already present
+  bool remove(const Key &key); // false if absent
+  NodeT *search(const Key &key) const;
+
+  std::optional<Key> minimum() const;
+  std::optional<Key> successor(const Key &key) const; // smallest key > key
+  template <typename Fn> void forEach(Fn &&fn) const;
+
+  NodeT *getRoot() const { return root; }
+  const Compare &comparator() const { return cmp; }
+  std::size_t size() const { return count; }
+  int height() const;
+  std::size_t rebuilds() const { return rebuildCount; }
+  std::size_t bytes() const; // nodes at their pool size class plus buffers
+
+private:
+  NodeT *root{nullptr};
+  [[no_unique_address]] Compare cmp;
+  double alpha;
+  std::size_t count{0};
+  std::size_t maxCount{0};
+  int depthLimit{0};   // floor(log_{1/alpha} maxCount)
+  double nextLimitAt;  // (1/alpha)^(depthLimit + 1)
+  std::size_t rebuildCount{0};
+
+  std::vector<NodeT *> path;    // root-to-leaf path of the last insert
+  std::vector<NodeT *> scratch; // flattened subtree during a rebuild
+
+  // a bigger scratch buffer is freed after use; the rebuild that needs it
+  // again is linear anyway, so an allocation more hardly shows
+  static constexpr std::size_t KEEP_SCRATCH = 1024;
+
+  void resetLimit(std::size_t n);
+  void grewTo(std::size_t n);
+  static std::size_t sizeOf(const NodeT *node);
+  NodeT *rebuild(NodeT *node, std::size_t n);
+  static NodeT *build(NodeT *const *nodes, std::size_t n);
+  static void destroy(NodeT *node);
+};
+
+//-------------------------------------------------------------------------------
+//                          ScapegoatTree Implementation
+//-------------------------------------------------------------------------------
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare>
+ScapegoatTree<Key, Compare>::ScapegoatTree(double alpha,
+                                           const Compare &compare)
+    : cmp(compare), alpha(std::clamp(alpha, 0.55, 0.95)),
+      nextLimitAt(1 / this->alpha) {}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare>
+ScapegoatTree<Key, Compare>::ScapegoatTree(std::initializer_list<Key> list)
+    : ScapegoatTree() {
+  for (const Key &key : list)
+    insert(key);
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare>
+ScapegoatTree<Key, Compare>::~ScapegoatTree() {
+  destroy(root);
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare>
+void ScapegoatTree<Key, Compare>::destroy(NodeT *node) {
+  while (node) { // recurse left only; the height is logarithmic
+    destroy(node->left);
+    NodeT *right = node->right;
+    delete node;
+    node = right;
+  }
+}
+
+// Track depthLimit incrementally instead of taking a logarithm per insert.
+// The bound uses maxCount, not count: the two differ by at most a factor of
+// alpha, which costs at most one level.
+template <KeyComparble Key, ThreeWayComparator<Key> Compare>
+void ScapegoatTree<Key, Compare>::grewTo(std::size_t n) {
+  if (n <= maxCount)
+    return;
+  maxCount = n;
+  while (double(maxCount) >= nextLimitAt) {
+    ++depthLimit;
+    nextLimitAt /= alpha;
+  }
+}
+
+// after a full rebuild maxCount starts over from the current size
+template <KeyComparble Key, ThreeWayComparator<Key> Compare>
+void ScapegoatTree<Key, Compare>::resetLimit(std::size_t n) {
+  maxCount = 0;
+  depthLimit = 0;
+  nextLimitAt = 1 / alpha;
+  grewTo(n);
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare>
+std::size_t ScapegoatTree<Key, Compare>::sizeOf(const NodeT *node) {
+  std::size_t n = 0;
+  for (; node; node = node->right)
+    n += 1 + sizeOf(node->left);
+  return n;
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare>
+typename ScapegoatTree<Key, Compare>::NodeT *
+ScapegoatTree<Key, Compare>::search(const Key &key) const {
+  NodeT *node = root;
+  while (node) {
+    auto order = cmp(key, node->key);
+    if (order == 0)
+      return node;
+    node = order < 0 ? node->left : node->right;
+  }
+  return nullptr;
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare>
+bool ScapegoatTree<Key, Compare>::insert(const Key &key) {
+  path.clear();
+  NodeT **link = &root;
+  while (*link) {
+    auto order = cmp(key, (*link)->key);
+    if (order == 0)
+      return false;
+    path.push_back(*link);
+    link = order < 0 ? &(*link)->left : &(*link)->right;
+  }
+  NodeT *added = new NodeT(key);
+  *link = added;
+  grewTo(++count);
+  if (int(path.size()) <= depthLimit)
+    return true;
+
+  // Too deep: climb until a child outweighs alpha of its parent. Sizes are
+  // counted on the way up, each step adding the sibling subtree.
+  NodeT *child = added;
+  std::size_t childSize = 1;
+  for (std::size_t i = path.size(); i-- > 0;) {
+    NodeT *node = path[i];
+    NodeT *sibling = node->left == child ? node->right : node->left;
+    std::size_t nodeSize = childSize + 1 + sizeOf(sibling);
+    if (double(childSize) > alpha * double(nodeSize) || i == 0) {
+      NodeT *parent = i > 0 ? path[i - 1] : nullptr; // rebuild reuses path
+      NodeT *rebuilt = rebuild(node, nodeSize);
+      if (!parent)
+        root = rebuilt;
+      else if (parent->left == node)
+        parent->left = rebuilt;
+      else
+        parent->right = rebuilt;
+      break;
+    }
+    child = node;
+    childSize = nodeSize;
+  }
+  return true;
+}
+
+// Deletion relinks nodes rather than copying keys, so a NodeT * handed out
+// by search() stays valid until its own key is removed.
+template <KeyComparble Key, ThreeWayComparator<Key> Compare>
+bool ScapegoatTree<Key, Compare>::remove(const Key &key) {
+  NodeT **link = &root;
+  while (*link) {
+    auto order = cmp(key, (*link)->key);
+    if (order == 0)
+      break;
+    link = order < 0 ? &(*link)->left : &(*link)->right;
+  }
+  NodeT *node = *link;
+  if (!node)
+    return false;
+
+  if (!node->left) {
+    *link = node->right;
+  } else if (!node->right) {
+    *link = node->left;
+  } else { // splice out the in-order successor and put it in node's place
+    NodeT **succLink = &node->right;
+    while ((*succLink)->left)
+      succLink = &(*succLink)->left;
+    NodeT *succ = *succLink;
+    *succLink = succ->right;
+    succ->left = node->left;
+    succ->right = node->right;
+    *link = succ;
+  }
+  delete node;
+
+  if (double(--count) < alpha * double(maxCount)) {
+    if (count > 0)
+      root = rebuild(root, count);
+    resetLimit(count);
+  }
+  return true;
+}
+
+// Flatten the n-node subtree into scratch (in order, iteratively) and relink
+// it perfectly balanced
+template <KeyComparble Key, ThreeWayComparator<Key> Compare>
+typename ScapegoatTree<Key, Compare>::NodeT *
+ScapegoatTree<Key, Compare>::rebuild(NodeT *node, std::size_t n) {
+  ++rebuildCount;
+  scratch.clear();
+  scratch.reserve(n);
+  path.clear(); // reused as the walk's stack
+  while (node || !path.empty()) {
+    for (; node; node = node->left)
+      path.push_back(node);
+    node = path.back();
+    path.pop_back();
+    scratch.push_back(node);
+    node = node->right;
+  }
+  NodeT *top = build(scratch.data(), scratch.size());
+  if (scratch.capacity() > KEEP_SCRATCH)
+    std::vector<NodeT *>().swap(scratch);
+  return top;
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare>
+typename ScapegoatTree<Key, Compare>::NodeT *
+ScapegoatTree<Key, Compare>::build(NodeT *const *nodes, std::size_t n) {
+  if (n == 0)
+    return nullptr;
+  std::size_t mid = n / 2;
+  NodeT *node = nodes[mid];
+  node->left = build(nodes, mid);
+  node->right = build(nodes + mid + 1, n - mid - 1);
+  return node;
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare>
+std::optional<Key> ScapegoatTree<Key, Compare>::minimum() const {
+  NodeT *node = root;
+  if (!node)
+    return std::nullopt;
+  while (node->left)
+    node = node->left;
+  return node->key;
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare>
+std::optional<Key>
+ScapegoatTree<Key, Compare>::successor(const Key &key) const {
+  const NodeT *best = nullptr;
+  for (const NodeT *node = root; node;) {
+    if (cmp(key, node->key) < 0) {
+      best = node;
+      node = node->left;
+    } else {
+      node = node->right;
+    }
+  }
+  return best ? std::optional<Key>(best->key) : std::nullopt;
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare>
+template <typename Fn>
+void ScapegoatTree<Key, Compare>::forEach(Fn &&fn) const {
+  std::vector<const NodeT *> stack;
+  const NodeT *node = root;
+  while (node || !stack.empty()) {
+    for (; node; node = node->left)
+      stack.push_back(node);
+    node = stack.back();
+    stack.pop_back();
+    fn(node->key);
+    node = node->right;
+  }
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare>
+std::size_t ScapegoatTree<Key, Compare>::bytes() const {
+  return sizeof(*this) + count * POOL::sizeClass(sizeof(NodeT)) +
+         (path.capacity() + scratch.capacity()) * sizeof(NodeT *);
+}
+
+// levels on the longest root-to-leaf path; 0 when empty
+template <KeyComparble Key, ThreeWayComparator<Key> Compare>
+int ScapegoatTree<Key, Compare>::height() const {
+  int best = 0;
+  std::vector<std::pair<const NodeT *, int>> stack;
+  if (root)
+    stack.push_back({root, 1});
+  while (!stack.empty()) {
+    auto [node, depth] = stack.back();
+    stack.pop_back();
+    best = std::max(best, depth);
+    if (node->left)
+      stack.push_back({node->left, depth + 1});
+    if (node->right)
+      stack.push_back({node->right, depth + 1});
+  }
+  return best;
+}
+
+} // namespace SCAPEGOAT
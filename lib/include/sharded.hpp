@@ -0,0 +1,367 @@
+#pragma once
+
+#include "node.hpp"
+#include "tree.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace TREE {
+
+//-------------------------------------------------------------------------------
+//                               Sharded Ordered Set
+//-------------------------------------------------------------------------------
+
+// N balanced trees, each covering a contiguous key range [splitter[i-1],
+// splitter[i]) and guarded by its own lock, so writers to different ranges
+// never contend. The splitters are recomputed from a strided key sample
+// whenever one shard grows past skewLimit times the average shard size.
+// They start from the caller's splitters, from an even split of a key range,
+// or, with neither, from the data once minRebalance keys are in.
+// Because shards are range partitioned, walking them in index order yields
+// the globally ordered sequence. Every key comparison, splitters included,
+// goes through the shard trees' comparator, so the order is the tree's.
+
+template <KeyComparble Key, typename Tree = AVLTree<Key>> class ShardedSet {
+public:
+  class const_iterator;
+
+  explicit ShardedSet(
+      std::size_t shards = std::max(1u, std::thread::hardware_concurrency()));
+  ShardedSet(std::size_t shards, std::vector<Key> initialSplitters);
+  // splitters spread evenly over [lo, hi), where most keys are expected
+  ShardedSet(std::size_t shards, const Key &lo, const Key &hi)
+    requires std::is_arithmetic_v<Key>;
+
+  ShardedSet(const ShardedSet &) = delete;
+  ShardedSet &operator=(const ShardedSet &) = delete;
+
+  bool insert(const Key &key);
+  bool contains(const Key &key) const;
+  bool remove(const Key &key);
+
+  std::size_t size() const { return total.load(std::memory_order_relaxed); }
+  std::size_t shardCount() const { return shards.size(); }
+  std::size_t shardSize(std::size_t i) const;
+  std::vector<Key> splitters() const;
+
+  void rebalance();
+
+  // Visit every key in ascending order. Each shard is read under its shared
+  // lock; keys inserted concurrently into an already visited shard are missed.
+  template <typename Fn> void forEach(Fn &&fn) const;
+
+  const_iterator begin() const { return const_iterator(this); }
+  const_iterator end() const { return const_iterator(); }
+
+  double skewLimit{2.0};           // rebalance when a shard exceeds this x avg
+  std::size_t minRebalance{256};   // ... and the set holds at least this many
+  std::size_t samplePerShard{128}; // splitter sample size per target shard
+
+private:
+  struct Shard {
+    mutable std::shared_mutex lock;
+    mutable Tree tree; // search() is logically const
+    std::size_t size{0};
+  };
+
+  std::vector<std::unique_ptr<Shard>> shards;
+  std::vector<Key> bounds; // shards.size() - 1 ascending splitters
+  mutable std::shared_mutex topology; // exclusive only while rebalancing
+  std::atomic<std::size_t> total{0};
+  std::atomic<bool> rebalancing{false};
+
+  // a before b in the trees' order; every shard shares one comparator
+  bool before(const Key &a, const Key &b) const {
+    return shards.front()->tree.comparator()(a, b) < 0;
+  }
+  std::size_t shardFor(const Key &key) const;
+  void maybeRebalance(std::size_t shardSize);
+
+  // collect up to `limit` keys strictly after `after` (or all keys when
+  // `after` is null) from one subtree, in order
+  template <typename N>
+  void collectAfter(N *root, const Key *after, std::size_t limit,
+                    std::vector<Key> &out) const;
+};
+
+//-------------------------------------------------------------------------------
+//                                 Merged Iterator
+//-------------------------------------------------------------------------------
+
+// Forward iterator across all shards. It pulls keys in small batches and
+// resumes from the last key it returned, so it stays ordered (weakly
+// consistent) even if shards change or are rebalanced between batches.
+template <KeyComparble Key, typename Tree>
+class ShardedSet<Key, Tree>::const_iterator {
+public:
+  using iterator_category = std::input_iterator_tag;
+  using value_type = Key;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const Key *;
+  using reference = const Key &;
+
+  const_iterator() = default;
+  explicit const_iterator(const ShardedSet *set) : owner(set) { fill(); }
+
+  reference operator*() const { return batch[pos]; }
+  pointer operator->() const { return &batch[pos]; }
+
+  const_iterator &operator++() {
+    if (++pos == batch.size())
+      fill();
+    return *this;
+  }
+
+  bool operator==(const const_iterator &other) const {
+    if (owner != other.owner)
+      return false;
+    return owner == nullptr ||
+           (!owner->before(batch[pos], other.batch[other.pos]) &&
+            !owner->before(other.batch[other.pos], batch[pos]));
+  }
+  bool operator!=(const const_iterator &other) const {
+    return !(*this == other);
+  }
+
+private:
+  static constexpr std::size_t batchSize = 256;
+
+  const ShardedSet *owner{nullptr};
+  std::vector<Key> batch;
+  std::size_t pos{0};
+  std::size_t shard{0};
+
+  void fill();
+};
+
+template <KeyComparble Key, typename Tree>
+void ShardedSet<Key, Tree>::const_iterator::fill() {
+  bool resumed = !batch.empty();
+  Key last = resumed ? batch.back() : Key{};
+  batch.clear();
+  pos = 0;
+
+  std::shared_lock<std::shared_mutex> topo(owner->topology);
+  if (resumed) // the last key may have moved to another shard
+    shard = owner->shardFor(last);
+
+  for (; shard < owner->shards.size(); ++shard) {
+    const Shard &s = *owner->shards[shard];
+    std::shared_lock<std::shared_mutex> lock(s.lock);
+    owner->collectAfter(s.tree.getRoot(), resumed ? &last : nullptr,
+                        batchSize, batch);
+    if (!batch.empty())
+      return;
+  }
+  owner = nullptr; // exhausted, compare equal to end()
+}
+
+//-------------------------------------------------------------------------------
+//                           ShardedSet Implementation
+//-------------------------------------------------------------------------------
+
+template <KeyComparble Key, typename Tree>
+ShardedSet<Key, Tree>::ShardedSet(std::size_t n) {
+  for (std::size_t i = 0; i < std::max<std::size_t>(n, 1); ++i)
+    shards.push_back(std::make_unique<Shard>());
+  // placeholder splitters: keys pile up in one shard until the first
+  // rebalance, at minRebalance keys, derives real ones from the data
+  bounds.assign(shards.size() - 1, Key{});
+  minRebalance = std::max<std::size_t>(minRebalance, shards.size());
+}
+
+template <KeyComparble Key, typename Tree>
+ShardedSet<Key, Tree>::ShardedSet(std::size_t n,
+                                  std::vector<Key> initialSplitters)
+    : ShardedSet(n) {
+  std::sort(initialSplitters.begin(), initialSplitters.end(),
+            [this](const Key &a, const Key &b) { return before(a, b); });
+  initialSplitters.resize(shards.size() - 1,
+                          initialSplitters.empty() ? Key{}
+                                                   : initialSplitters.back());
+  bounds = std::move(initialSplitters);
+}
+
+template <KeyComparble Key, typename Tree>
+ShardedSet<Key, Tree>::ShardedSet(std::size_t n, const Key &lo, const Key &hi)
+  requires std::is_arithmetic_v<Key>
+    : ShardedSet(n) {
+  // in long double, so neither hi - lo nor the products overflow Key
+  long double step = ((long double)hi - (long double)lo) / shards.size();
+  for (std::size_t i = 1; i < shards.size(); ++i)
+    bounds[i - 1] = Key((long double)lo + step * i);
+  std::sort(bounds.begin(), bounds.end(),
+            [this](const Key &a, const Key &b) { return before(a, b); });
+}
+
+template <KeyComparble Key, typename Tree>
+std::size_t ShardedSet<Key, Tree>::shardFor(const Key &key) const {
+  return std::upper_bound(bounds.begin(), bounds.end(), key,
+                          [this](const Key &a, const Key &b) {
+                            return before(a, b);
+                          }) -
+         bounds.begin();
+}
+
+template <KeyComparble Key, typename Tree>
+bool ShardedSet<Key, Tree>::insert(const Key &key) {
+  std::size_t grown;
+  {
+    std::shared_lock<std::shared_mutex> topo(topology);
+    Shard &s = *shards[shardFor(key)];
+    std::unique_lock<std::shared_mutex> lock(s.lock);
+    if (s.tree.search(key) != nullptr)
+      return false;
+    s.tree.insert(key);
+    grown = ++s.size;
+  }
+  total.fetch_add(1, std::memory_order_relaxed);
+  maybeRebalance(grown);
+  return true;
+}
+
+template <KeyComparble Key, typename Tree>
+bool ShardedSet<Key, Tree>::contains(const Key &key) const {
+  std::shared_lock<std::shared_mutex> topo(topology);
+  Shard &s = *shards[shardFor(key)];
+  std::shared_lock<std::shared_mutex> lock(s.lock);
+  return s.tree.search(key) != nullptr;
+}
+
+template <KeyComparble Key, typename Tree>
+bool ShardedSet<Key, Tree>::remove(const Key &key) {
+  std::shared_lock<std::shared_mutex> topo(topology);
+  Shard &s = *shards[shardFor(key)];
+  std::unique_lock<std::shared_mutex> lock(s.lock);
+  if (s.tree.search(key) == nullptr)
+    return false;
+  s.tree.remove(key);
+  --s.size;
+  total.fetch_sub(1, std::memory_order_relaxed);
+  return true;
+}
+
+template <KeyComparble Key, typename Tree>
+std::size_t ShardedSet<Key, Tree>::shardSize(std::size_t i) const {
+  std::shared_lock<std::shared_mutex> topo(topology);
+  std::shared_lock<std::shared_mutex> lock(shards[i]->lock);
+  return shards[i]->size;
+}
+
+template <KeyComparble Key, typename Tree>
+std::vector<Key> ShardedSet<Key, Tree>::splitters() const {
+  std::shared_lock<std::shared_mutex> topo(topology);
+  return bounds;
+}
+
+template <KeyComparble Key, typename Tree>
+void ShardedSet<Key, Tree>::maybeRebalance(std::size_t shardSize) {
+  std::size_t n = size();
+  if (shards.size() < 2 || n < minRebalance ||
+      shardSize <= skewLimit * n / shards.size())
+    return;
+  if (rebalancing.exchange(true)) // somebody else is already on it
+    return;
+  rebalance();
+  rebalancing = false;
+}
+
+template <KeyComparble Key, typename Tree>
+void ShardedSet<Key, Tree>::rebalance() {
+  std::unique_lock<std::shared_mutex> topo(topology);
+
+  std::size_t n = size();
+  if (shards.size() < 2 || n == 0)
+    return;
+
+  // 1. strided sample over the (already ordered) concatenation of shards
+  std::size_t want = samplePerShard * shards.size();
+  std::size_t stride = std::max<std::size_t>(1, n / want);
+  std::vector<Key> sample, keys;
+  sample.reserve(want + shards.size());
+  std::size_t seen = 0;
+  for (auto &s : shards) {
+    keys.clear();
+    collectAfter(s->tree.getRoot(), nullptr, s->size, keys);
+    for (const Key &k : keys)
+      if (seen++ % stride == 0)
+        sample.push_back(k);
+  }
+
+  // 2. equal-count quantiles of the sample become the new splitters
+  std::vector<Key> next;
+  for (std::size_t i = 1; i < shards.size(); ++i)
+    next.push_back(sample[i * sample.size() / shards.size()]);
+  bounds = std::move(next);
+
+  // 3. move only the keys that now belong to a different shard
+  for (std::size_t i = 0; i < shards.size(); ++i) {
+    Shard &from = *shards[i];
+    keys.clear();
+    collectAfter(from.tree.getRoot(), nullptr, from.size, keys);
+    for (const Key &k : keys) {
+      std::size_t j = shardFor(k);
+      if (j == i)
+        continue;
+      from.tree.remove(k);
+      --from.size;
+      shards[j]->tree.insert(k);
+      ++shards[j]->size;
+    }
+  }
+}
+
+template <KeyComparble Key, typename Tree>
+template <typename Fn>
+void ShardedSet<Key, Tree>::forEach(Fn &&fn) const {
+  std::shared_lock<std::shared_mutex> topo(topology);
+  std::vector<Key> keys;
+  for (const auto &s : shards) {
+    keys.clear();
+    {
+      std::shared_lock<std::shared_mutex> lock(s->lock);
+      collectAfter(s->tree.getRoot(), nullptr, s->size, keys);
+    }
+    for (const Key &k : keys)
+      fn(k);
+  }
+}
+
+template <KeyComparble Key, typename Tree>
+template <typename N>
+void ShardedSet<Key, Tree>::collectAfter(N *root, const Key *after,
+                                         std::size_t limit,
+                                         std::vector<Key> &out) const {
+  std::vector<N *> stack;
+  N *node = root;
+
+  // seed the stack with the path to the first key after *after
+  while (node != nullptr) {
+    if (after == nullptr || before(*after, node->key)) {
+      stack.push_back(node);
+      node = node->left;
+    } else {
+      node = node->right;
+    }
+  }
+
+  std::size_t taken = 0;
+  while (!stack.empty() && taken < limit) {
+    node = stack.back();
+    stack.pop_back();
+    out.push_back(node->key);
+    ++taken;
+    for (node = node->right; node != nullptr; node = node->left)
+      stack.push_back(node);
+  }
+}
+
+} // namespace TREE
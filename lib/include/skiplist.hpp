@@ -0,0 +1,515 @@
+#pragma once
+
+#include "node.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace SKIPLIST {
+
+//-------------------------------------------------------------------------------
+//                             Lock-Free Skip List
+//-------------------------------------------------------------------------------
+
+// Harris/Herlihy-Shavit style skip list: towers are linked with CAS and
+// removed by first marking every next pointer (low pointer bit), then
+// physically snipped by any traversal that walks past them.
+//
+// Memory is reclaimed with epochs: every operation runs inside a guard that
+// publishes the global epoch it observed, unlinked towers are retired into the
+// caller's bucket for that epoch, and a bucket is recycled once the global
+// epoch has moved two steps past it (no thread can still hold a reference).
+// Recycled towers go to a per-thread pool keyed by tower height, so steady
+// state insert/remove traffic does not touch the global allocator.
+
+template <KeyComparble Key, int MaxLevel = 24> class LockFreeSkipList {
+public:
+  LockFreeSkipList();
+  ~LockFreeSkipList();
+
+  LockFreeSkipList(const LockFreeSkipList &) = delete;
+  LockFreeSkipList &operator=(const LockFreeSkipList &) = delete;
+
+  bool insert(const Key &key);
+  bool search(const Key &key);
+  bool remove(const Key &key);
+  std::optional<Key> successor(const Key &key);
+  std::optional<Key> minimum();
+
+  std::size_t size() const { return count.load(std::memory_order_relaxed); }
+
+private:
+  struct Node {
+    Key key;
+    int topLevel;             // tower spans levels [0, topLevel)
+    std::atomic<int> owners;  // inserter + remover, last one retires
+    std::atomic<std::uintptr_t> next[1]; // really next[topLevel]
+
+    static std::size_t bytes(int levels) {
+      return sizeof(Node) + (levels - 1) * sizeof(std::atomic<std::uintptr_t>);
+    }
+  };
+
+  // one per (thread, list); never freed before the list itself
+  struct Record {
+    std::atomic<std::uint64_t> epoch{0};
+    std::atomic<bool> active{false};
+    std::atomic<bool> inUse{true};
+    Record *nextRecord{nullptr};
+    std::array<std::vector<Node *>, 3> retired;
+    std::array<std::vector<Node *>, MaxLevel + 1> pool; // by tower height
+    std::size_t sinceAdvance{0};
+    std::uint64_t rng;
+  };
+
+  class Guard {
+  public:
+    explicit Guard(LockFreeSkipList &list);
+    ~Guard();
+    Record *rec;
+  };
+
+  static constexpr std::uintptr_t MARK = 1;
+  static constexpr std::size_t retireBatch = 64;
+
+  Node *head;
+  std::atomic<std::size_t> count{0};
+  std::atomic<int> levels{1}; // levels in use, raised before any link
+  std::atomic<std::uint64_t> globalEpoch{0};
+  std::atomic<Record *> records{nullptr};
+  std::uint64_t id;
+
+  static Node *ptr(std::uintptr_t v) {
+    return reinterpret_cast<Node *>(v & ~MARK);
+  }
+  static bool marked(std::uintptr_t v) { return v & MARK; }
+  static std::uintptr_t raw(Node *n) {
+    return reinterpret_cast<std::uintptr_t>(n);
+  }
+
+  bool find(const Key &key, Node **preds, Node **succs);
+  int randomLevel(Record *rec);
+
+  Node *allocate(Record *rec, const Key &key, int levels);
+  void release(Node *node);
+  void retire(Record *rec, Node *node);
+  void dropOwner(Record *rec, Node *node);
+  bool tryAdvance();
+
+  Record *acquireRecord();
+
+  // registry of live lists, so exiting threads only release their record in
+  // lists that still exist
+  static std::mutex &registryMutex();
+  static std::unordered_set<std::uint64_t> &registry();
+  struct ThreadRecords {
+    std::vector<std::pair<std::uint64_t, Record *>> entries;
+    ~ThreadRecords();
+  };
+  static ThreadRecords &threadRecords();
+};
+
+//-------------------------------------------------------------------------------
+//                         Epoch / Record Implementation
+//-------------------------------------------------------------------------------
+
+template <KeyComparble Key, int MaxLevel>
+std::mutex &LockFreeSkipList<Key, MaxLevel>::registryMutex() {
+  static std::mutex m;
+  return m;
+}
+
+template <KeyComparble Key, int MaxLevel>
+std::unordered_set<std::uint64_t> &LockFreeSkipList<Key, MaxLevel>::registry() {
+  static std::unordered_set<std::uint64_t> live;
+  return live;
+}
+
+template <KeyComparble Key, int MaxLevel>
+LockFreeSkipList<Key, MaxLevel>::ThreadRecords::~ThreadRecords() {
+  std::lock_guard<std::mutex> lock(registryMutex());
+  for (auto &[listId, rec] : entries)
+    if (registry().count(listId))
+      rec->inUse.store(false, std::memory_order_release);
+}
+
+template <KeyComparble Key, int MaxLevel>
+typename LockFreeSkipList<Key, MaxLevel>::ThreadRecords &
+LockFreeSkipList<Key, MaxLevel>::threadRecords() {
+  thread_local ThreadRecords mine;
+  return mine;
+}
+
+template <KeyComparble Key, int MaxLevel>
+typename LockFreeSkipList<Key, MaxLevel>::Record *
+LockFreeSkipList<Key, MaxLevel>::acquireRecord() {
+  auto &mine = threadRecords().entries;
+  for (auto &[listId, rec] : mine)
+    if (listId == id)
+      return rec;
+
+  // adopt a record left behind by an exited thread, else publish a new one
+  Record *rec = records.load(std::memory_order_acquire);
+  for (; rec != nullptr; rec = rec->nextRecord) {
+    bool expected = false;
+    if (!rec->inUse.load(std::memory_order_relaxed) &&
+        rec->inUse.compare_exchange_strong(expected, true))
+      break;
+  }
+  if (rec == nullptr) {
+    rec = new Record;
+    rec->rng = reinterpret_cast<std::uintptr_t>(rec) | 1;
+    Record *top = records.load(std::memory_order_relaxed);
+    do {
+      rec->nextRecord = top;
+    } while (!records.compare_exchange_weak(top, rec,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed));
+  }
+  mine.emplace_back(id, rec);
+  return rec;
+}
+
+template <KeyComparble Key, int MaxLevel>
+LockFreeSkipList<Key, MaxLevel>::Guard::Guard(LockFreeSkipList &list)
+    : rec(list.acquireRecord()) {
+  std::uint64_t seen = rec->epoch.load(std::memory_order_relaxed);
+  rec->active.store(true, std::memory_order_seq_cst);
+  std::uint64_t now = list.globalEpoch.load(std::memory_order_seq_cst);
+  rec->epoch.store(now, std::memory_order_seq_cst);
+
+  if (now != seen) {
+    // bucket (now + 1) % 3 only holds towers stamped <= now - 2
+    auto &bucket = rec->retired[(now + 1) % 3];
+    for (Node *node : bucket) {
+      node->key.~Key();
+      rec->pool[node->topLevel].push_back(node);
+    }
+    bucket.clear();
+  }
+}
+
+template <KeyComparble Key, int MaxLevel>
+LockFreeSkipList<Key, MaxLevel>::Guard::~Guard() {
+  rec->active.store(false, std::memory_order_release);
+}
+
+template <KeyComparble Key, int MaxLevel>
+bool LockFreeSkipList<Key, MaxLevel>::tryAdvance() {
+  std::uint64_t e = globalEpoch.load(std::memory_order_seq_cst);
+  for (Record *r = records.load(std::memory_order_acquire); r != nullptr;
+       r = r->nextRecord) {
+    if (r->active.load(std::memory_order_seq_cst) &&
+        r->epoch.load(std::memory_order_seq_cst) != e)
+      return false;
+  }
+  return globalEpoch.compare_exchange_strong(e, e + 1);
+}
+
+template <KeyComparble Key, int MaxLevel>
+void LockFreeSkipList<Key, MaxLevel>::retire(Record *rec, Node *node) {
+  // stamp with the global epoch, not ours: a reader that still sees the
+  // tower entered no later than this epoch, and the global epoch can only
+  // move two steps past it once that reader has left
+  std::uint64_t stamp = globalEpoch.load(std::memory_order_seq_cst);
+  rec->retired[stamp % 3].push_back(node);
+  if (++rec->sinceAdvance >= retireBatch) {
+    rec->sinceAdvance = 0;
+    tryAdvance();
+  }
+}
+
+template <KeyComparble Key, int MaxLevel>
+void LockFreeSkipList<Key, MaxLevel>::dropOwner(Record *rec, Node *node) {
+  if (node->owners.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    retire(rec, node);
+}
+
+template <KeyComparble Key, int MaxLevel>
+typename LockFreeSkipList<Key, MaxLevel>::Node *
+LockFreeSkipList<Key, MaxLevel>::allocate(Record *rec, const Key &key,
+                                          int levels) {
+  void *mem;
+  auto &free = rec->pool[levels];
+  if (!free.empty()) {
+    mem = free.back();
+    free.pop_back();
+  } else {
+    mem = ::operator new(Node::bytes(levels));
+  }
+
+  Node *node = static_cast<Node *>(mem);
+  new (&node->key) Key(key);
+  node->topLevel = levels;
+  new (&node->owners) std::atomic<int>(2);
+  for (int i = 0; i < levels; ++i)
+    new (&node->next[i]) std::atomic<std::uintptr_t>(0);
+  return node;
+}
+
+template <KeyComparble Key, int MaxLevel>
+void LockFreeSkipList<Key, MaxLevel>::release(Node *node) {
+  node->key.~Key();
+  ::operator delete(node);
+}
+
+template <KeyComparble Key, int MaxLevel>
+int LockFreeSkipList<Key, MaxLevel>::randomLevel(Record *rec) {
+  // xorshift64, one level per trailing one bit: P(level > k) = 2^-k
+  std::uint64_t x = rec->rng;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  rec->rng = x;
+
+  int level = 1;
+  while ((x & 1) && level < MaxLevel) {
+    ++level;
+    x >>= 1;
+  }
+  return level;
+}
+
+//-------------------------------------------------------------------------------
+//                        LockFreeSkipList Implementation
+//-------------------------------------------------------------------------------
+
+template <KeyComparble Key, int MaxLevel>
+LockFreeSkipList<Key, MaxLevel>::LockFreeSkipList() {
+  static std::atomic<std::uint64_t> nextId{1};
+  id = nextId.fetch_add(1);
+  {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    registry().insert(id);
+  }
+
+  // the head sentinel never has its key read
+  head = static_cast<Node *>(::operator new(Node::bytes(MaxLevel)));
+  head->topLevel = MaxLevel;
+  for (int i = 0; i < MaxLevel; ++i)
+    new (&head->next[i]) std::atomic<std::uintptr_t>(0);
+}
+
+template <KeyComparble Key, int MaxLevel>
+LockFreeSkipList<Key, MaxLevel>::~LockFreeSkipList() {
+  {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    registry().erase(id);
+  }
+
+  // no concurrent users left: free live towers, retired towers and pools
+  Node *node = ptr(head->next[0].load(std::memory_order_relaxed));
+  while (node != nullptr) {
+    Node *next = ptr(node->next[0].load(std::memory_order_relaxed));
+    release(node);
+    node = next;
+  }
+  ::operator delete(head);
+
+  Record *rec = records.load(std::memory_order_relaxed);
+  while (rec != nullptr) {
+    for (auto &bucket : rec->retired)
+      for (Node *n : bucket)
+        release(n);
+    for (auto &free : rec->pool)
+      for (Node *n : free)
+        ::operator delete(n);
+    Record *next = rec->nextRecord;
+    delete rec;
+    rec = next;
+  }
+}
+
+// Fill preds/succs with the neighbours of `key` at every level, snipping any
+// marked tower on the way. Returns true when an unmarked `key` is at level 0.
+template <KeyComparble Key, int MaxLevel>
+bool LockFreeSkipList<Key, MaxLevel>::find(const Key &key, Node **preds,
+                                           Node **succs) {
+  int top = levels.load(std::memory_order_acquire);
+  for (int level = top; level < MaxLevel; ++level) {
+    preds[level] = head;
+    succs[level] = ptr(head->next[level].load(std::memory_order_acquire));
+  }
+
+retry:
+  Node *pred = head;
+  for (int level = top - 1; level >= 0; --level) {
+    Node *curr = ptr(pred->next[level].load(std::memory_order_acquire));
+    while (curr != nullptr) {
+      std::uintptr_t succ = curr->next[level].load(std::memory_order_acquire);
+      while (marked(succ)) {
+        std::uintptr_t expected = raw(curr);
+        if (!pred->next[level].compare_exchange_strong(
+                expected, succ & ~MARK, std::memory_order_acq_rel))
+          goto retry; // pred changed or got marked itself
+        curr = ptr(succ);
+        if (curr == nullptr)
+          break;
+        succ = curr->next[level].load(std::memory_order_acquire);
+      }
+      if (curr == nullptr || !(curr->key < key))
+        break;
+      pred = curr;
+      curr = ptr(succ);
+    }
+    preds[level] = pred;
+    succs[level] = curr;
+  }
+  return succs[0] != nullptr && !(key < succs[0]->key);
+}
+
+template <KeyComparble Key, int MaxLevel>
+bool LockFreeSkipList<Key, MaxLevel>::insert(const Key &key) {
+  Guard guard(*this);
+  Node *preds[MaxLevel], *succs[MaxLevel];
+  Node *node = nullptr;
+
+  for (;;) {
+    if (find(key, preds, succs)) {
+      if (node != nullptr) { // never published, hand it straight back
+        node->key.~Key();
+        guard.rec->pool[node->topLevel].push_back(node);
+      }
+      return false;
+    }
+    if (node == nullptr) {
+      node = allocate(guard.rec, key, randomLevel(guard.rec));
+      int top = levels.load(std::memory_order_relaxed);
+      while (top < node->topLevel &&
+             !levels.compare_exchange_weak(top, node->topLevel,
+                                           std::memory_order_acq_rel))
+        ;
+      if (top < node->topLevel) // levels grew: neighbours must cover them
+        continue;
+    }
+    for (int i = 0; i < node->topLevel; ++i)
+      node->next[i].store(raw(succs[i]), std::memory_order_relaxed);
+
+    std::uintptr_t expected = raw(succs[0]);
+    if (preds[0]->next[0].compare_exchange_strong(expected, raw(node),
+                                                  std::memory_order_release))
+      break;
+  }
+  count.fetch_add(1, std::memory_order_relaxed);
+
+  // link the upper levels; give up as soon as a remover marks the tower
+  for (int level = 1; level < node->topLevel; ++level) {
+    for (;;) {
+      std::uintptr_t mine = node->next[level].load(std::memory_order_acquire);
+      if (marked(mine))
+        goto linked;
+      if (ptr(mine) != succs[level] &&
+          !node->next[level].compare_exchange_strong(
+              mine, raw(succs[level]), std::memory_order_acq_rel))
+        goto linked; // marked under us
+
+      std::uintptr_t expected = raw(succs[level]);
+      if (preds[level]->next[level].compare_exchange_strong(
+              expected, raw(node), std::memory_order_release))
+        break;
+      find(key, preds, succs);
+      if (succs[0] != node)
+        goto linked; // already removed at level 0
+    }
+  }
+
+linked:
+  if (marked(node->next[0].load(std::memory_order_acquire)))
+    find(key, preds, succs); // unlink levels we linked after the remover ran
+  dropOwner(guard.rec, node);
+  return true;
+}
+
+template <KeyComparble Key, int MaxLevel>
+bool LockFreeSkipList<Key, MaxLevel>::search(const Key &key) {
+  Guard guard(*this);
+  Node *pred = head;
+  Node *curr = nullptr;
+  for (int level = levels.load(std::memory_order_acquire) - 1; level >= 0;
+       --level) {
+    curr = ptr(pred->next[level].load(std::memory_order_acquire));
+    while (curr != nullptr && curr->key < key) {
+      pred = curr;
+      curr = ptr(curr->next[level].load(std::memory_order_acquire));
+    }
+  }
+  return curr != nullptr && !(key < curr->key) &&
+         !marked(curr->next[0].load(std::memory_order_acquire));
+}
+
+template <KeyComparble Key, int MaxLevel>
+bool LockFreeSkipList<Key, MaxLevel>::remove(const Key &key) {
+  Guard guard(*this);
+  Node *preds[MaxLevel], *succs[MaxLevel];
+
+  if (!find(key, preds, succs))
+    return false;
+  Node *victim = succs[0];
+
+  // mark top-down; level 0 decides who owns the removal
+  for (int level = victim->topLevel - 1; level >= 1; --level) {
+    std::uintptr_t succ = victim->next[level].load(std::memory_order_acquire);
+    while (!marked(succ))
+      victim->next[level].compare_exchange_weak(succ, succ | MARK,
+                                                std::memory_order_acq_rel);
+  }
+  std::uintptr_t succ = victim->next[0].load(std::memory_order_acquire);
+  for (;;) {
+    if (marked(succ))
+      return false; // another remover won
+    if (victim->next[0].compare_exchange_weak(succ, succ | MARK,
+                                              std::memory_order_acq_rel))
+      break;
+  }
+
+  count.fetch_sub(1, std::memory_order_relaxed);
+  find(key, preds, succs); // physically unlink every level
+  dropOwner(guard.rec, victim);
+  return true;
+}
+
+// smallest key strictly greater than `key`
+template <KeyComparble Key, int MaxLevel>
+std::optional<Key> LockFreeSkipList<Key, MaxLevel>::successor(const Key &key) {
+  Guard guard(*this);
+  Node *pred = head;
+  for (int level = levels.load(std::memory_order_acquire) - 1; level >= 0;
+       --level) {
+    Node *curr = ptr(pred->next[level].load(std::memory_order_acquire));
+    while (curr != nullptr && !(key < curr->key)) {
+      pred = curr;
+      curr = ptr(curr->next[level].load(std::memory_order_acquire));
+    }
+  }
+
+  Node *curr = ptr(pred->next[0].load(std::memory_order_acquire));
+  while (curr != nullptr) {
+    std::uintptr_t next = curr->next[0].load(std::memory_order_acquire);
+    if (!marked(next) && key < curr->key)
+      return curr->key;
+    curr = ptr(next);
+  }
+  return std::nullopt;
+}
+
+template <KeyComparble Key, int MaxLevel>
+std::optional<Key> LockFreeSkipList<Key, MaxLevel>::minimum() {
+  Guard guard(*this);
+  Node *curr = ptr(head->next[0].load(std::memory_order_acquire));
+  while (curr != nullptr) {
+    std::uintptr_t next = curr->next[0].load(std::memory_order_acquire);
+    if (!marked(next))
+      return curr->key;
+    curr = ptr(next);
+  }
+  return std::nullopt;
+}
+
+} // namespace SKIPLIST
@@ -1,10 +1,14 @@
 #pragma once
 
+#include "layout.hpp"
+#include "merkle.hpp"
 #include "node.hpp"
 #include "util.hpp"
 #include <algorithm>
+#include <cstddef>
 #include <initializer_list>
 #include <string>
+#include <vector>
 
 namespace TREE {
 
@@ -12,40 +16,105 @@ namespace TREE {
 //                              Binary Search Trees
 //-------------------------------------------------------------------------------
 
-template <KeyComparble Key> class BinarySearchTree {
+template <KeyComparble Key,
+          ThreeWayComparator<Key> Compare = std::compare_three_way,
+          unsigned Features = 0>
+class BinarySearchTree {
 protected:
-  using NodeT = BSTNode<Key>;
+  using NodeT = BSTNode<Key, Features>;
   NodeT *root;
+  [[no_unique_address]] Compare cmp; // cmp(a, b) < 0 sends a to the left
 
-  virtual NodeT *insertNode(NodeT *node, int key, NodeT *parent);
-  NodeT *searchNode(NodeT *node, int key);
+  // the optional node fields this tree was declared with, see NODE
+  static constexpr bool LAZY = (Features & NODE::LAZY_DELETE) != 0;
+  static constexpr bool HASHED = (Features & NODE::HASHING) != 0;
+  static constexpr bool COUNTED = (Features & NODE::MULTISET) != 0;
+
+  NodeT *searchNode(NodeT *node, const Key &key);
   void transplant(NodeT *u, NodeT *v);
   virtual NodeT *deleteNode(NodeT *root, NodeT *node);
   NodeT *minimumNode(NodeT *node);
   NodeT *maximumNode(NodeT *node);
   NodeT *successorNode(NodeT *node);
+  NodeT *predecessorNode(NodeT *node);
 
   NodeT *rotateLeft(NodeT *z);
   NodeT *rotateRight(NodeT *z);
 
+  // Lazy deletion: remove() only marks a tombstone and queues the node;
+  // compactStep()/compact() unlink them later in batches
+  bool lazyDelete{false};
+  std::size_t tombstones{0};
+  std::vector<NodeT *> graveyard;
+
+  bool bury(NodeT *node);
+  bool revive(NodeT *node);
+  NodeT *liveFrom(NodeT *node);
+
+  // Subtree hashing: while enabled every node carries MERKLE's hash of its
+  // subtree, refreshed wherever heights are. hashNode()/hashPath() re-pull
+  // one node or the path above it, and do nothing while hashing is off.
+  bool hashing{false};
+
+  void hashNode(NodeT *node);
+  void hashPath(NodeT *node);
+
+  // Nodes moved into one block by defragment(); everything is freed
+  // through arena.release(), heap nodes included
+  LAYOUT::Arena<NodeT> arena;
+
+  // Multiset mode: an equal key bumps the node's count instead of adding
+  // (BST) or dropping (AVL, RB) a node
+  bool multiset{false};
+
+  std::size_t addCopy(NodeT *node);
+
+  // Cached maximum, so appends (key above everything stored) attach
+  // without a descent. nullptr means "unknown"; maxNode() refills it.
+  NodeT *rightmost{nullptr};
+
+  NodeT *maxNode();
+  NodeT *attach(NodeT *parent, bool right, const Key &key);
+  virtual NodeT *place(const Key &key);
+  virtual void retrace(NodeT *node);
+
 public:
   virtual ~BinarySearchTree() = default;
 
   // Constructor
   BinarySearchTree();
-  BinarySearchTree(std::initializer_list<int> list);
-  virtual BinarySearchTree &operator=(std::initializer_list<int> list);
+  explicit BinarySearchTree(const Compare &compare);
+  BinarySearchTree(std::initializer_list<Key> list);
+  virtual BinarySearchTree &operator=(std::initializer_list<Key> list);
 
   NodeT *getRoot();
-  virtual void insert(int key);
-  virtual NodeT *search(int key);
-  virtual void remove(int key);
+  const Compare &comparator() const;
+  virtual std::size_t insert(const Key &key);
+  NodeT *insert(NodeT *hint, const Key &key);
+  virtual NodeT *search(const Key &key);
+  virtual void remove(const Key &key);
   NodeT *minimum();
   NodeT *maximum();
-  NodeT *successor(int key);
+  NodeT *successor(const Key &key);
   void printWithoutPrefix(NodeT *node);
   void printWithPrefix(const std::string &prefix, NodeT *node);
 
+  // need the matching NODE feature in the tree type
+  void setLazyDelete(bool enabled);
+  std::size_t tombstoneCount() const;
+  std::size_t compactStep(std::size_t budget);
+  void compact();
+
+  void setHashing(bool enabled);
+  bool equals(BinarySearchTree &other);
+  std::vector<Key> diff(BinarySearchTree &other);
+
+  void defragment(LAYOUT::Order order = LAYOUT::Order::VEB);
+
+  void setMultiset(bool enabled);
+  std::size_t count(const Key &key);
+  std::size_t removeOne(const Key &key);
+
   int getHeight(NodeT *node);
   int getBalance(NodeT *node);
   void updateHeight(NodeT *node);
@@ -55,85 +124,82 @@ public:
 //                                   AVL Trees
 //-------------------------------------------------------------------------------
 
-template <KeyComparble Key> class AVLTree : public BinarySearchTree<Key> {
+template <KeyComparble Key,
+          ThreeWayComparator<Key> Compare = std::compare_three_way,
+          unsigned Features = 0>
+class AVLTree : public BinarySearchTree<Key, Compare, Features> {
 protected:
-  using NodeT = BSTNode<Key>;
-  NodeT *balance(NodeT *node, int key);
+  using NodeT = BSTNode<Key, Features>;
+  NodeT *balance(NodeT *node);
 
-  NodeT *insertNode(NodeT *node, int key, NodeT *parent) override;
   NodeT *deleteNode(NodeT *root, NodeT *node) override;
+  NodeT *place(const Key &key) override;
+  void retrace(NodeT *node) override;
 
 public:
   AVLTree();
-  AVLTree(std::initializer_list<int> list);
-  AVLTree &operator=(std::initializer_list<int> list) override;
+  explicit AVLTree(const Compare &compare);
+  AVLTree(std::initializer_list<Key> list);
+  AVLTree &operator=(std::initializer_list<Key> list) override;
 
-  void insert(int key) override;
-  NodeT *search(int key) override;
-  void remove(int key) override;
+  NodeT *search(const Key &key) override;
+  void remove(const Key &key) override;
 };
 
 //-------------------------------------------------------------------------------
 //                        BinarySearchTree Implementation
 //-------------------------------------------------------------------------------
 
-template <KeyComparble Key>
-BinarySearchTree<Key>::BinarySearchTree() : root(nullptr) {}
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+BinarySearchTree<Key, Compare, Features>::BinarySearchTree() : root(nullptr) {}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+BinarySearchTree<Key, Compare, Features>::BinarySearchTree(
+    const Compare &compare)
+    : root(nullptr), cmp(compare) {}
 
-template <KeyComparble Key>
-BinarySearchTree<Key>::BinarySearchTree(std::initializer_list<int> list) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+BinarySearchTree<Key, Compare, Features>::BinarySearchTree(
+    std::initializer_list<Key> list) {
   root = nullptr;
-  for (int key : list) {
+  for (const Key &key : list) {
     BinarySearchTree::insert(key);
   }
 }
 
-template <KeyComparble Key>
-BinarySearchTree<Key> &
-BinarySearchTree<Key>::operator=(std::initializer_list<int> list) {
-  for (int key : list) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+BinarySearchTree<Key, Compare, Features> &
+BinarySearchTree<Key, Compare, Features>::operator=(
+    std::initializer_list<Key> list) {
+  for (const Key &key : list) {
     BinarySearchTree::insert(key);
   }
 
   return *this;
 }
 
-template <KeyComparble Key>
-BSTNode<Key> *BinarySearchTree<Key>::insertNode(NodeT *node, int key,
-                                                NodeT *parent) {
-  if (node == nullptr) { // check value, if not exist, create it
-    NodeT *newNode = new NodeT(key);
-    newNode->parent = parent;
-    if (!root)
-      root = newNode; // maintain the root
-    return newNode;
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+BSTNode<Key, Features> *
+BinarySearchTree<Key, Compare, Features>::searchNode(NodeT *node,
+                                                     const Key &key) {
+  while (node != nullptr) { // one three-way comparison per level
+    auto order = cmp(key, node->key);
+    if (order == 0)
+      return node;
+    node = order < 0 ? node->left : node->right;
   }
-
-  // recursively search for appropriate place
-  if (key < node->key) {
-    node->left = insertNode(node->left, key, node);
-    node->left->parent = node;
-  } else {
-    node->right = insertNode(node->right, key, node);
-    node->right->parent = node;
-  }
-  return node; // return parent node, recursively return root
-}
-
-template <KeyComparble Key>
-BSTNode<Key> *BinarySearchTree<Key>::searchNode(NodeT *node, int key) {
-  if (node == nullptr || node->key == key) { // check value
-    return node;
-  }
-  if (key < node->key) // search left subtree
-    return searchNode(node->left, key);
-  else // search right subtree
-    return searchNode(node->right, key);
+  return nullptr;
 }
 
-template <KeyComparble Key>
-void BinarySearchTree<Key>::transplant(NodeT *u,
-                                       NodeT *v) { // used to replace u with v
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void BinarySearchTree<Key, Compare, Features>::transplant(
+    NodeT *u, NodeT *v) { // used to replace u with v
   if (u->parent == nullptr)
     // if u is the root
     this->root = v;
@@ -148,11 +214,16 @@ void BinarySearchTree<Key>::transplant(NodeT *u,
   }
 }
 
-template <KeyComparble Key>
-BSTNode<Key> *BinarySearchTree<Key>::deleteNode(NodeT *root, NodeT *node) {
-  if (root == nullptr) // nothing to delete
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+BSTNode<Key, Features> *
+BinarySearchTree<Key, Compare, Features>::deleteNode(NodeT *root, NodeT *node) {
+  if (root == nullptr || node == nullptr) // nothing to delete
     return root;
+  if (node == rightmost)
+    rightmost = nullptr;
 
+  NodeT *changed = node->parent; // deepest node whose subtree shrank
   if (node->left == nullptr)
     // cases on node doesn't have left subtrees
     transplant(node, node->right);
@@ -162,7 +233,9 @@ BSTNode<Key> *BinarySearchTree<Key>::deleteNode(NodeT *root, NodeT *node) {
   else {
     // cases on node both have left and right child
     NodeT *sec = minimumNode(node->right); // successor
+    changed = sec;
     if (sec->parent != node) {
+      changed = sec->parent;
       transplant(sec, sec->right);
       sec->right = node->right;
       sec->right->parent = sec;
@@ -171,25 +244,33 @@ BSTNode<Key> *BinarySearchTree<Key>::deleteNode(NodeT *root, NodeT *node) {
     sec->left = node->left;
     sec->left->parent = sec;
   }
+  hashPath(changed);
+  arena.release(node);
   return root;
 }
 
-template <KeyComparble Key>
-BSTNode<Key> *BinarySearchTree<Key>::minimumNode(NodeT *node) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+BSTNode<Key, Features> *
+BinarySearchTree<Key, Compare, Features>::minimumNode(NodeT *node) {
   while (node->left != nullptr)
     node = node->left;
   return node;
 }
 
-template <KeyComparble Key>
-BSTNode<Key> *BinarySearchTree<Key>::maximumNode(NodeT *node) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+BSTNode<Key, Features> *
+BinarySearchTree<Key, Compare, Features>::maximumNode(NodeT *node) {
   while (node->right != nullptr)
     node = node->right;
   return node;
 }
 
-template <KeyComparble Key>
-BSTNode<Key> *BinarySearchTree<Key>::successorNode(NodeT *node) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+BSTNode<Key, Features> *
+BinarySearchTree<Key, Compare, Features>::successorNode(NodeT *node) {
   if (node == nullptr)
     return nullptr;
 
@@ -208,15 +289,37 @@ BSTNode<Key> *BinarySearchTree<Key>::successorNode(NodeT *node) {
   return parent;
 }
 
-template <KeyComparble Key>
-BSTNode<Key> *BinarySearchTree<Key>::rotateLeft(NodeT *z) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+BSTNode<Key, Features> *
+BinarySearchTree<Key, Compare, Features>::predecessorNode(NodeT *node) {
+  if (node == nullptr)
+    return nullptr;
+
+  if (node->left != nullptr)
+    return maximumNode(node->left);
+
+  NodeT *parent = node->parent;
+  while (parent != nullptr && parent->left == node) {
+    node = parent;
+    parent = parent->parent;
+  }
+  return parent;
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+BSTNode<Key, Features> *
+BinarySearchTree<Key, Compare, Features>::rotateLeft(NodeT *z) {
   NodeT *y = z->right;
   NodeT *T2 = y->left;
 
   // Perform rotation
+  y->left = z;
   z->right = T2;
 
   // Update parents
+  y->parent = z->parent;
   z->parent = y;
   if (T2)
     T2->parent = z;
@@ -237,15 +340,19 @@ BSTNode<Key> *BinarySearchTree<Key>::rotateLeft(NodeT *z) {
   return y; // y becomes the new root of the subtree
 }
 
-template <KeyComparble Key>
-BSTNode<Key> *BinarySearchTree<Key>::rotateRight(NodeT *z) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+BSTNode<Key, Features> *
+BinarySearchTree<Key, Compare, Features>::rotateRight(NodeT *z) {
   NodeT *y = z->left;
   NodeT *T3 = y->right;
 
   // Perform rotation
+  y->right = z;
   z->left = T3;
 
   // Update parents
+  y->parent = z->parent;
   z->parent = y;
   if (T3)
     T3->parent = z;
@@ -266,110 +373,462 @@ BSTNode<Key> *BinarySearchTree<Key>::rotateRight(NodeT *z) {
   return y; // y becomes the new root of the subtree
 }
 
-template <KeyComparble Key> BSTNode<Key> *BinarySearchTree<Key>::getRoot() {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+BSTNode<Key, Features> *BinarySearchTree<Key, Compare, Features>::getRoot() {
   return root;
 }
 
-template <KeyComparble Key> void BinarySearchTree<Key>::insert(int key) {
-  root = insertNode(root, key, nullptr);
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+const Compare &BinarySearchTree<Key, Compare, Features>::comparator() const {
+  return cmp;
+}
+
+// Returns the key's multiplicity afterwards, always 1 outside multiset mode
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+std::size_t BinarySearchTree<Key, Compare, Features>::insert(const Key &key) {
+  NodeT *node = place(key);
+  return multiset ? NODE::copies(node) : 1;
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+BSTNode<Key, Features> *
+BinarySearchTree<Key, Compare, Features>::search(const Key &key) {
+  NodeT *node = searchNode(root, key);
+  return (node && !NODE::isTombstone(node)) ? node : nullptr;
+}
+
+// Insert next to `hint` when key belongs right before or after it, which
+// skips the descent from the root; any other hint (or an equal key) falls
+// back to insert(key). Returns the node holding key.
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+BSTNode<Key, Features> *
+BinarySearchTree<Key, Compare, Features>::insert(NodeT *hint, const Key &key) {
+  NodeT *last = maxNode();
+  if (last && cmp(key, last->key) > 0) // an append, wherever the hint points
+    return attach(last, true, key);
+
+  NodeT *at = nullptr;
+  bool right = false;
+  auto order = cmp(key, hint ? hint->key : key); // equal without a hint
+  if (order > 0) {
+    NodeT *next = successorNode(hint); // hint itself when it is the maximum
+    if (next == hint || cmp(key, next->key) < 0) {
+      right = hint->right == nullptr;
+      at = right ? hint : next; // next is leftmost under hint->right
+    }
+  } else if (order < 0) {
+    NodeT *prev = predecessorNode(hint); // nullptr when it is the minimum
+    if (prev == nullptr || cmp(key, prev->key) > 0) {
+      right = hint->left != nullptr;
+      at = right ? prev : hint; // prev is rightmost under hint->left
+    }
+  }
+  if (at == nullptr)
+    return place(key);
+  return attach(at, right, key);
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+BSTNode<Key, Features> *BinarySearchTree<Key, Compare, Features>::maxNode() {
+  if (rightmost == nullptr && root != nullptr)
+    rightmost = maximumNode(root);
+  return rightmost;
+}
+
+// insert(key) in one descent: it ends at an empty slot, where the key is
+// linked, or at a node holding the key that takes it back (a tombstone) or
+// counts it (multiset mode). Returns the node holding key.
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+BSTNode<Key, Features> *
+BinarySearchTree<Key, Compare, Features>::place(const Key &key) {
+  NodeT *last = maxNode();
+  if (last && cmp(key, last->key) > 0) // append: nothing to revive or count
+    return attach(last, true, key);
+
+  NodeT *parent = nullptr;
+  NodeT *node = root;
+  bool right = false;
+  while (node != nullptr) {
+    auto order = cmp(key, node->key);
+    if (order == 0) {
+      if (lazyDelete && revive(node))
+        return node;
+      if (multiset) {
+        addCopy(node);
+        return node;
+      }
+    }
+    parent = node;
+    right = order >= 0; // the plain BST keeps duplicates, to the right
+    node = right ? node->right : node->left;
+  }
+  return attach(parent, right, key);
+}
+
+// Link a new leaf under parent (an empty child slot) and rebalance
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+BSTNode<Key, Features> *
+BinarySearchTree<Key, Compare, Features>::attach(NodeT *parent, bool right,
+                                                 const Key &key) {
+  NodeT *node = new NodeT(key);
+  node->parent = parent;
+  if (parent == nullptr)
+    root = node;
+  else if (right)
+    parent->right = node;
+  else
+    parent->left = node;
+  if (right && parent == rightmost)
+    rightmost = node;
+  retrace(node);
+  return node;
 }
 
-template <KeyComparble Key>
-BSTNode<Key> *BinarySearchTree<Key>::search(int key) {
-  return searchNode(root, key);
+// No balancing here; only the hashes above the new leaf go stale
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void BinarySearchTree<Key, Compare, Features>::retrace(NodeT *node) {
+  hashPath(node);
 }
 
-template <KeyComparble Key> void BinarySearchTree<Key>::remove(int key) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void BinarySearchTree<Key, Compare, Features>::remove(const Key &key) {
+  if (lazyDelete) {
+    bury(searchNode(root, key));
+    return;
+  }
   deleteNode(root, searchNode(root, key));
 }
 
-template <KeyComparble Key> BSTNode<Key> *BinarySearchTree<Key>::minimum() {
-  return minimumNode(root);
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+BSTNode<Key, Features> *BinarySearchTree<Key, Compare, Features>::minimum() {
+  return liveFrom(minimumNode(root));
 }
 
-template <KeyComparble Key> BSTNode<Key> *BinarySearchTree<Key>::maximum() {
-  return maximumNode(root);
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+BSTNode<Key, Features> *BinarySearchTree<Key, Compare, Features>::maximum() {
+  NodeT *node = maximumNode(root);
+  while (node && NODE::isTombstone(node))
+    node = predecessorNode(node);
+  return node;
 }
 
-template <KeyComparble Key>
-BSTNode<Key> *BinarySearchTree<Key>::successor(int key) {
-  NodeT *node = search(key);
-  return successorNode(node);
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+BSTNode<Key, Features> *
+BinarySearchTree<Key, Compare, Features>::successor(const Key &key) {
+  NodeT *node = searchNode(root, key);
+  return liveFrom(successorNode(node));
 }
 
-template <KeyComparble Key>
-void BinarySearchTree<Key>::printWithoutPrefix(NodeT *node) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void BinarySearchTree<Key, Compare, Features>::printWithoutPrefix(NodeT *node) {
   printTree("", node, false);
 }
 
-template <KeyComparble Key>
-void BinarySearchTree<Key>::printWithPrefix(const std::string &string,
-                                            NodeT *node) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void BinarySearchTree<Key, Compare, Features>::printWithPrefix(
+    const std::string &string, NodeT *node) {
   printTree(string, node, false);
 }
 
-template <KeyComparble Key> int BinarySearchTree<Key>::getHeight(NodeT *node) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+bool BinarySearchTree<Key, Compare, Features>::bury(NodeT *node) {
+  if constexpr (LAZY) {
+    if (node == nullptr || node->tombstone)
+      return false;
+    node->tombstone = true;
+    ++tombstones;
+    hashPath(node);
+    if (!node->queued) { // a revived node may still be queued from before
+      node->queued = true;
+      graveyard.push_back(node);
+    }
+    return true;
+  }
+  return false;
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+bool BinarySearchTree<Key, Compare, Features>::revive(NodeT *node) {
+  if constexpr (LAZY) {
+    if (node == nullptr || !node->tombstone)
+      return false;
+    node->tombstone = false; // stays queued, compactStep() skips it
+    if constexpr (COUNTED)
+      node->count = 1;
+    --tombstones;
+    hashPath(node);
+    return true;
+  }
+  return false;
+}
+
+// first live node at or after node, nullptr if there is none
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+BSTNode<Key, Features> *
+BinarySearchTree<Key, Compare, Features>::liveFrom(NodeT *node) {
+  while (node && NODE::isTombstone(node)) {
+    NodeT *next = successorNode(node);
+    if (next == node) // successorNode() hands back the maximum itself
+      return nullptr;
+    node = next;
+  }
+  return node;
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void BinarySearchTree<Key, Compare, Features>::setLazyDelete(bool enabled) {
+  static_assert(LAZY, "declare the tree with NODE::LAZY_DELETE");
+  if (lazyDelete && !enabled)
+    compact();
+  lazyDelete = enabled;
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+std::size_t BinarySearchTree<Key, Compare, Features>::tombstoneCount() const {
+  return tombstones;
+}
+
+// Physically unlink up to `budget` queued nodes through the regular
+// deleteNode() path; returns how many queue entries were consumed.
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+std::size_t
+BinarySearchTree<Key, Compare, Features>::compactStep(std::size_t budget) {
+  static_assert(LAZY, "declare the tree with NODE::LAZY_DELETE");
+  std::size_t done = 0;
+  while (done < budget && !graveyard.empty()) {
+    NodeT *node = graveyard.back();
+    graveyard.pop_back();
+    node->queued = false;
+    ++done;
+    if (!node->tombstone)
+      continue; // revived since it was queued
+    node->tombstone = false;
+    --tombstones;
+    deleteNode(root, node);
+  }
+  return done;
+}
+
+// Unlink every queued tombstone now, one compactStep() at a time: O(k log n)
+// for k tombstones, no allocation, and the rest of the tree keeps its shape
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void BinarySearchTree<Key, Compare, Features>::compact() {
+  static_assert(LAZY, "declare the tree with NODE::LAZY_DELETE");
+  compactStep(graveyard.size());
+}
+
+// Re-allocate every node into one contiguous block in the given order,
+// keeping the shape. Pointers to nodes obtained earlier are invalidated.
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void BinarySearchTree<Key, Compare, Features>::defragment(LAYOUT::Order order) {
+  root = arena.relayout(root, order, graveyard);
+  rightmost = nullptr;
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+std::size_t BinarySearchTree<Key, Compare, Features>::addCopy(NodeT *node) {
+  if constexpr (COUNTED) {
+    ++node->count;
+    hashPath(node);
+    return node->count;
+  }
+  return 1;
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void BinarySearchTree<Key, Compare, Features>::setMultiset(bool enabled) {
+  static_assert(COUNTED, "declare the tree with NODE::MULTISET");
+  multiset = enabled;
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+std::size_t BinarySearchTree<Key, Compare, Features>::count(const Key &key) {
+  NodeT *node = search(key);
+  return node ? NODE::copies(node) : 0;
+}
+
+// Drop one copy of key; the node goes only with its last copy. Returns the
+// multiplicity left.
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+std::size_t
+BinarySearchTree<Key, Compare, Features>::removeOne(const Key &key) {
+  NodeT *node = search(key);
+  if (node == nullptr)
+    return 0;
+  if constexpr (COUNTED) {
+    if (node->count > 1) {
+      --node->count;
+      hashPath(node);
+      return node->count;
+    }
+  }
+  remove(key);
+  return 0;
+}
+
+// Turning hashing on hashes the existing tree once, O(n)
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void BinarySearchTree<Key, Compare, Features>::setHashing(bool enabled) {
+  static_assert(HASHED, "declare the tree with NODE::HASHING");
+  if (enabled && !hashing)
+    MERKLE::rehash(root);
+  hashing = enabled;
+}
+
+// Probabilistic: equal root hashes mean equal live key sets unless two
+// different sets collide in 64 bits. A tree that is not hashing is hashed
+// for this call only, O(n); keep hashing on to compare repeatedly.
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+bool BinarySearchTree<Key, Compare, Features>::equals(BinarySearchTree &other) {
+  bool mine = hashing, theirs = other.hashing;
+  setHashing(true);
+  other.setHashing(true);
+  bool same = MERKLE::equals(root, other.root);
+  other.setHashing(theirs);
+  setHashing(mine);
+  return same;
+}
+
+// Live keys whose multiplicity differs between the two trees, ascending:
+// for plain sets the keys held by exactly one of them. Hashing is switched
+// on for the call only, as in equals().
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+std::vector<Key>
+BinarySearchTree<Key, Compare, Features>::diff(BinarySearchTree &other) {
+  bool mine = hashing, theirs = other.hashing;
+  setHashing(true);
+  other.setHashing(true);
+  std::vector<Key> keys = MERKLE::diff(root, other.root, cmp);
+  other.setHashing(theirs);
+  setHashing(mine);
+  return keys;
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+int BinarySearchTree<Key, Compare, Features>::getHeight(NodeT *node) {
   return node ? node->height : 0;
 }
 
-template <KeyComparble Key> int BinarySearchTree<Key>::getBalance(NodeT *node) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+int BinarySearchTree<Key, Compare, Features>::getBalance(NodeT *node) {
   return node ? getHeight(node->left) - getHeight(node->right) : 0;
 }
 
-template <KeyComparble Key>
-void BinarySearchTree<Key>::updateHeight(NodeT *node) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void BinarySearchTree<Key, Compare, Features>::updateHeight(NodeT *node) {
   if (!node)
     return;
   node->height = std::max(getHeight(node->left), getHeight(node->right)) + 1;
+  hashNode(node);
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void BinarySearchTree<Key, Compare, Features>::hashNode(NodeT *node) {
+  if constexpr (HASHED)
+    if (hashing)
+      MERKLE::pull(node);
+}
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void BinarySearchTree<Key, Compare, Features>::hashPath(NodeT *node) {
+  if constexpr (HASHED)
+    if (hashing)
+      MERKLE::pullToRoot(node);
 }
 
 //-------------------------------------------------------------------------------
 //                            AVLTree Implementation
 //-------------------------------------------------------------------------------
 
-template <KeyComparble Key> AVLTree<Key>::AVLTree() { this->root = nullptr; }
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+AVLTree<Key, Compare, Features>::AVLTree() { this->root = nullptr; }
+
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+AVLTree<Key, Compare, Features>::AVLTree(const Compare &compare)
+    : BinarySearchTree<Key, Compare, Features>(compare) {}
 
-template <KeyComparble Key>
-AVLTree<Key>::AVLTree(std::initializer_list<int> list) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+AVLTree<Key, Compare, Features>::AVLTree(std::initializer_list<Key> list) {
   this->root = nullptr;
   for (auto key : list)
     AVLTree::insert(key);
 }
 
-template <KeyComparble Key>
-AVLTree<Key> &AVLTree<Key>::operator=(std::initializer_list<int> list) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+AVLTree<Key, Compare, Features> &
+AVLTree<Key, Compare, Features>::operator=(std::initializer_list<Key> list) {
   for (auto key : list)
     AVLTree::insert(key);
 
   return *this;
 }
 
-template <KeyComparble Key>
-BSTNode<Key> *AVLTree<Key>::balance(NodeT *node, int key) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+BSTNode<Key, Features> *AVLTree<Key, Compare, Features>::balance(NodeT *node) {
   int balance = this->getBalance(node);
 
-  // LL case： left tree is higher. and the insertion point is on the left side
-  // of the left subtree
-  if (balance > 1 && key < node->left->key) {
+  // Cases are picked by the taller child's own balance, which works for
+  // deletions too (there the child can be even)
+
+  // LL case： left tree is higher, and so is the left side of the left subtree
+  if (balance > 1 && this->getBalance(node->left) >= 0) {
     return this->rotateRight(node);
   }
 
-  // RR case： right subtree is higher, and insertion point is on the right side
-  // of the right subtree
-  if (balance < -1 && key < node->right->key) {
+  // RR case： right subtree is higher, and so is the right side of the right
+  // subtree
+  if (balance < -1 && this->getBalance(node->right) <= 0) {
     return this->rotateLeft(node);
   }
 
-  // LR case： left subtree is higher, but insertion point is on the right of
-  // the left subtree
-  if (balance > 1 && key > node->left->key) {
+  // LR case： left subtree is higher, but its right side is the taller one
+  if (balance > 1) {
     node->left = this->rotateLeft(node->left);
     return this->rotateRight(node);
   }
 
-  // RL case： right subtree is higher, but insertion point is on the left side
-  // of the right subtree
-  if (balance < -1 && key < node->right->key) {
+  // RL case： right subtree is higher, but its left side is the taller one
+  if (balance < -1) {
     node->right = this->rotateRight(node->right);
     return this->rotateLeft(node);
   }
@@ -377,37 +836,16 @@ BSTNode<Key> *AVLTree<Key>::balance(NodeT *node, int key) {
   return node;
 }
 
-template <KeyComparble Key>
-BSTNode<Key> *AVLTree<Key>::insertNode(NodeT *node, int key, NodeT *parent) {
-  if (node == nullptr) { // check value, if not exist, create it
-    NodeT *newNode = new NodeT(key);
-    newNode->parent = parent;
-    if (this->root == nullptr)
-      this->root = newNode; // maintain the root
-    return newNode;
-  }
-
-  // recursively search for appropriate place
-  if (key < node->key) {
-    node->left = insertNode(node->left, key, node);
-    node->left->parent = node;
-  } else if (key > node->key) {
-    node->right = insertNode(node->right, key, node);
-    node->right->parent = node;
-  } else
-    return node;
-
-  this->updateHeight(node);
-
-  return balance(node, key);
-}
-
-template <KeyComparble Key>
-BSTNode<Key> *AVLTree<Key>::deleteNode(NodeT *root, NodeT *node) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+BSTNode<Key, Features> *
+AVLTree<Key, Compare, Features>::deleteNode(NodeT *root, NodeT *node) {
   if (node == nullptr) {
     // Node to be deleted not found, just return root
     return root;
   }
+  if (node == this->rightmost)
+    this->rightmost = nullptr;
 
   NodeT *parent =
       node->parent; // keep track of the parent for later rebalancing
@@ -418,18 +856,18 @@ BSTNode<Key> *AVLTree<Key>::deleteNode(NodeT *root, NodeT *node) {
     // No children
     rebalanceStart = node->parent;
     this->transplant(node, nullptr);
-    delete node;
+    this->arena.release(node);
   } else if (node->left == nullptr) {
     // One child (right)
     rebalanceStart = node->right; // after deletion, we will start rebalancing
                                   // from here or its parent
     this->transplant(node, node->right);
-    delete node;
+    this->arena.release(node);
   } else if (node->right == nullptr) {
     // One child (left)
     rebalanceStart = node->left;
     this->transplant(node, node->left);
-    delete node;
+    this->arena.release(node);
   } else {
     // Two children
     NodeT *sec = this->minimumNode(node->right); // successor
@@ -450,7 +888,7 @@ BSTNode<Key> *AVLTree<Key>::deleteNode(NodeT *root, NodeT *node) {
     if (sec->left)
       sec->left->parent = sec;
 
-    delete node;
+    this->arena.release(node);
   }
 
   // Now rebalance the tree starting from rebalanceStart and moving upwards
@@ -461,7 +899,7 @@ BSTNode<Key> *AVLTree<Key>::deleteNode(NodeT *root, NodeT *node) {
   while (cur != nullptr) {
     this->updateHeight(cur);
     // Use cur->key as the reference key for balancing
-    cur = balance(cur, cur->key);
+    cur = balance(cur);
     if (cur->parent == nullptr) {
       // If this is now the root after balancing, update the class's root
       // pointer
@@ -473,15 +911,69 @@ BSTNode<Key> *AVLTree<Key>::deleteNode(NodeT *root, NodeT *node) {
   return this->root; // Return the (possibly new) root of this subtree
 }
 
-template <KeyComparble Key> void AVLTree<Key>::insert(int key) {
-  this->root = insertNode(this->root, key, nullptr);
+// Fix heights upwards from a new leaf; once a subtree's height is
+// unchanged (always the case after a rotation) nothing above can change
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void AVLTree<Key, Compare, Features>::retrace(NodeT *node) {
+  this->hashNode(node);
+  NodeT *cur = node->parent;
+  while (cur != nullptr) {
+    int before = cur->height;
+    this->updateHeight(cur);
+    cur = balance(cur);
+    if (cur->height == before)
+      break;
+    cur = cur->parent;
+  }
+  if (cur) // the path above the stop is still stale
+    this->hashPath(cur->parent);
+}
+
+// As BinarySearchTree::place(), except that an equal key stops the descent:
+// the AVL tree holds each key once
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+BSTNode<Key, Features> *
+AVLTree<Key, Compare, Features>::place(const Key &key) {
+  NodeT *last = this->maxNode();
+  if (last && this->cmp(key, last->key) > 0) // append: nothing to revive
+    return this->attach(last, true, key);
+
+  NodeT *parent = nullptr;
+  NodeT *node = this->root;
+  bool right = false;
+  while (node != nullptr) {
+    auto order = this->cmp(key, node->key);
+    if (order == 0) {
+      if (this->lazyDelete && this->revive(node))
+        return node;
+      if (this->multiset)
+        this->addCopy(node);
+      return node; // counted, or already present and left alone
+    }
+    parent = node;
+    right = order > 0;
+    node = right ? node->right : node->left;
+  }
+  return this->attach(parent, right, key);
 }
 
-template <KeyComparble Key> BSTNode<Key> *AVLTree<Key>::search(int key) {
-  return this->searchNode(this->root, key);
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+BSTNode<Key, Features> *
+AVLTree<Key, Compare, Features>::search(const Key &key) {
+  NodeT *node = this->searchNode(this->root, key);
+  return (node && !NODE::isTombstone(node)) ? node : nullptr;
 }
 
-template <KeyComparble Key> void AVLTree<Key>::remove(int key) {
+template <KeyComparble Key, ThreeWayComparator<Key> Compare,
+          unsigned Features>
+void AVLTree<Key, Compare, Features>::remove(const Key &key) {
+  if (this->lazyDelete) {
+    this->bury(this->searchNode(this->root, key));
+    return;
+  }
   deleteNode(this->root, this->searchNode(this->root, key));
 }
 
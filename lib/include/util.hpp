@@ -1,5 +1,6 @@
 #pragma once
 
+#include "export.hpp"
 #include "node.hpp"
 #include <string>
 #include <iostream>
@@ -8,16 +9,13 @@ void swap(int *i, int *j);
 
 void printArray(int arr[], int size);
 
-template <KeyComparble Key>
-void printTree(const std::string &prefix, BSTNode<Key> *node, bool isLeft) {
+// Builds the whole dump in one buffer and writes it with a single call;
+// see EXPORT::TreeExporter for DOT/JSON output and buffer reuse.
+template <BinaryNode NodeT>
+void printTree(const std::string &prefix, NodeT *node, bool isLeft) {
   if (node == nullptr)
     return;
-  else {
-    std::cout << prefix;
-    std::cout << (isLeft ? "├──" : "└──");
-    std::cout << node->key << std::endl;
-
-    printTree(prefix + (isLeft ? "│   " : "    "), node->left, true);
-    printTree(prefix + (isLeft ? "│   " : "    "), node->right, false);
-  }
+  EXPORT::TreeExporter<NodeT> exporter;
+  exporter.text(node, prefix, isLeft);
+  exporter.write(std::cout);
 }
@@ -0,0 +1,223 @@
+#pragma once
+
+#include "node.hpp"
+#include <atomic>
+#include <compare>
+#include <cstddef>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+namespace VALIDATE {
+
+//-------------------------------------------------------------------------------
+//                              Invariant Validator
+//-------------------------------------------------------------------------------
+
+// One post-order pass over the tree checking, for every node:
+//   - BST order (left < key <= right under the tree's comparator) and
+//     child->parent back links
+//   - BSTNode: stored height is correct and |balance| <= 1 (AVL)
+//   - RBTNode: black root, no red node with a red child, equal black-heights
+// The top levels of the tree are split across threads with std::async; below
+// the fork depth each task recurses sequentially.
+
+struct Report {
+  bool ok{true};
+  std::size_t nodes{0};
+  int height{0}; // AVL height, or black-height for red-black trees
+  std::string error;
+};
+
+template <BinaryNode NodeT,
+          ThreeWayComparator<typename NodeT::key_type> Compare =
+              std::compare_three_way>
+class Validator {
+public:
+  explicit Validator(unsigned threads = std::thread::hardware_concurrency(),
+                     const Compare &compare = Compare());
+
+  Report run(const NodeT *root);
+
+private:
+  struct Summary {
+    const NodeT *min{nullptr};
+    const NodeT *max{nullptr};
+    std::size_t nodes{0};
+    int height{0};
+  };
+
+  int forkDepth;
+  [[no_unique_address]] Compare cmp;
+  std::atomic<bool> failed{false};
+  std::mutex errorMutex;
+  std::string error;
+
+  Summary check(const NodeT *node, int depth);
+  void fail(const NodeT *node, const char *what);
+
+  static constexpr bool isRedBlack();
+  static bool isRed(const NodeT *node);
+};
+
+template <BinaryNode NodeT>
+Report validate(const NodeT *root,
+                unsigned threads = std::thread::hardware_concurrency()) {
+  return Validator<NodeT>(threads).run(root);
+}
+
+// A whole tree, checked in its own key order
+template <typename Tree>
+  requires requires(Tree &t) {
+    t.getRoot();
+    t.comparator();
+  }
+Report validate(Tree &tree,
+                unsigned threads = std::thread::hardware_concurrency()) {
+  using NodeT = std::remove_pointer_t<decltype(tree.getRoot())>;
+  using Compare = std::decay_t<decltype(tree.comparator())>;
+  return Validator<NodeT, Compare>(threads, tree.comparator())
+      .run(tree.getRoot());
+}
+
+//-------------------------------------------------------------------------------
+//                            Validator Implementation
+//-------------------------------------------------------------------------------
+
+template <BinaryNode NodeT,
+          ThreeWayComparator<typename NodeT::key_type> Compare>
+Validator<NodeT, Compare>::Validator(unsigned threads,
+                                     const Compare &compare)
+    : forkDepth(0), cmp(compare) {
+  // fork at the top log2(threads) + 1 levels: ~2x tasks per thread keeps
+  // everyone busy when subtrees differ in size
+  while ((1u << forkDepth) < threads * 2u && forkDepth < 16)
+    ++forkDepth;
+  if (threads <= 1)
+    forkDepth = 0;
+}
+
+template <BinaryNode NodeT,
+          ThreeWayComparator<typename NodeT::key_type> Compare>
+constexpr bool Validator<NodeT, Compare>::isRedBlack() {
+  return requires(const NodeT &n) { n.color == NodeT::RED; };
+}
+
+template <BinaryNode NodeT,
+          ThreeWayComparator<typename NodeT::key_type> Compare>
+bool Validator<NodeT, Compare>::isRed(const NodeT *node) {
+  if constexpr (isRedBlack())
+    return node != nullptr && node->color == NodeT::RED;
+  else
+    return false;
+}
+
+template <BinaryNode NodeT,
+          ThreeWayComparator<typename NodeT::key_type> Compare>
+void Validator<NodeT, Compare>::fail(const NodeT *node, const char *what) {
+  std::lock_guard<std::mutex> lock(errorMutex);
+  if (failed.exchange(true))
+    return; // keep the first report only
+  error = what;
+  if constexpr (requires(std::string &s) { s += std::to_string(node->key); }) {
+    error += " at key ";
+    error += std::to_string(node->key);
+  }
+}
+
+template <BinaryNode NodeT,
+          ThreeWayComparator<typename NodeT::key_type> Compare>
+typename Validator<NodeT, Compare>::Summary
+Validator<NodeT, Compare>::check(const NodeT *node, int depth) {
+  if (node == nullptr || failed.load(std::memory_order_relaxed))
+    return {};
+
+  Summary left, right;
+  if (depth < forkDepth && node->left && node->right) {
+    auto pending = std::async(std::launch::async,
+                              [this, node, depth] {
+                                return check(node->left, depth + 1);
+                              });
+    right = check(node->right, depth + 1);
+    left = pending.get();
+  } else {
+    left = check(node->left, depth + 1);
+    right = check(node->right, depth + 1);
+  }
+
+  if (failed.load(std::memory_order_relaxed))
+    return {};
+
+  // structure
+  if ((node->left && node->left->parent != node) ||
+      (node->right && node->right->parent != node)) {
+    fail(node, "broken parent link");
+    return {};
+  }
+
+  // order
+  if ((left.max && !(cmp(left.max->key, node->key) < 0)) ||
+      (right.min && cmp(right.min->key, node->key) < 0)) {
+    fail(node, "BST order violated");
+    return {};
+  }
+
+  Summary s;
+  s.min = left.min ? left.min : node;
+  s.max = right.max ? right.max : node;
+  s.nodes = left.nodes + right.nodes + 1;
+
+  if constexpr (isRedBlack()) {
+    if (isRed(node) && (isRed(node->left) || isRed(node->right))) {
+      fail(node, "red node with red child");
+      return {};
+    }
+    if (left.height != right.height) {
+      fail(node, "unequal black-height");
+      return {};
+    }
+    s.height = left.height + (isRed(node) ? 0 : 1);
+  } else {
+    s.height = (left.height > right.height ? left.height : right.height) + 1;
+    if (node->height != s.height) {
+      fail(node, "stale height field");
+      return {};
+    }
+    int balance = left.height - right.height;
+    if (balance > 1 || balance < -1) {
+      fail(node, "AVL balance out of range");
+      return {};
+    }
+  }
+
+  return s;
+}
+
+template <BinaryNode NodeT,
+          ThreeWayComparator<typename NodeT::key_type> Compare>
+Report Validator<NodeT, Compare>::run(const NodeT *root) {
+  failed = false;
+  error.clear();
+
+  Report report;
+  if (root && root->parent != nullptr) {
+    fail(root, "root has a parent");
+  } else if (isRed(root)) {
+    fail(root, "red root");
+  } else {
+    Summary s = check(root, 0);
+    report.nodes = s.nodes;
+    report.height = s.height;
+  }
+
+  if (failed) {
+    report = Report{};
+    report.ok = false;
+    report.error = error;
+  }
+  return report;
+}
+
+} // namespace VALIDATE
@@ -0,0 +1,434 @@
+#pragma once
+
+#include "bits.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace VEB {
+
+//-------------------------------------------------------------------------------
+//                              Van Emde Boas Tree
+//-------------------------------------------------------------------------------
+
+// Ordered set of integers of up to 32 bits with O(log log U) insert,
+// remove, successor and predecessor. Keys are mapped to a 32-bit universe
+// (sign bit flipped for signed types, as in ART) and split high/low:
+//
+//   Top   2^32: min and max held aside, 2^16 clusters of Mid, Mid summary
+//   Mid   2^16: a Leaf summary of its non-empty clusters, and those
+//               clusters stored densely in high-byte order
+//   Leaf  2^8:  four 64-bit words
+//
+// Each level does a constant amount of word work and descends at most once,
+// which is the vEB recursion with its bottom four levels (2^8 down to 2^1)
+// folded into bit scans. As in the textbook structure the top minimum is
+// not stored in any cluster, so inserting into an empty cluster never
+// recurses twice.
+//
+// A Mid holds no pointer per possible cluster: cluster i lives at index
+// rank(i) = popcount of the summary bits below i. Sparse sets therefore
+// pay about 32 bytes per occupied leaf. The top level keeps a flat array
+// of 2^16 pointers (512 KiB), allocated once the set holds two keys.
+
+template <Integer Key> class VanEmdeBoasTree {
+public:
+  static_assert(sizeof(Key) <= 4, "the universe is at most 32 bits wide");
+
+  VanEmdeBoasTree() = default;
+  VanEmdeBoasTree(std::initializer_list<Key> list);
+  ~VanEmdeBoasTree();
+
+  VanEmdeBoasTree(const VanEmdeBoasTree &) = delete;
+  VanEmdeBoasTree &operator=(const VanEmdeBoasTree &) = delete;
+
+  bool insert(Key key);
+  bool search(Key key) const;
+  bool remove(Key key);
+
+  std::optional<Key> minimum() const;
+  std::optional<Key> maximum() const;
+  std::optional<Key> successor(Key key) const;   // smallest key > key
+  std::optional<Key> predecessor(Key key) const; // largest key < key
+
+  // in-order visit of every key
+  template <typename Fn> void forEach(Fn &&fn) const;
+
+  std::size_t size() const { return count; }
+  std::size_t memoryUsage() const; // bytes held by every level
+
+private:
+  using UKey = std::uint32_t;
+
+  // Universe of 2^8; -1 stands for "none" in the scans
+  struct Leaf {
+    std::uint64_t words[4]{};
+
+    bool empty() const { return !(words[0] | words[1] | words[2] | words[3]); }
+    bool contains(unsigned x) const;
+    void insert(unsigned x);
+    void remove(unsigned x);
+    int min() const;
+    int max() const;
+    int successor(unsigned x) const;
+    int predecessor(unsigned x) const;
+    unsigned rank(unsigned x) const; // members below x
+  };
+
+  // Universe of 2^16. min/max are cached so that the top level can decide
+  // which cluster holds an answer without touching any leaf.
+  struct Mid {
+    Leaf summary;
+    std::uint16_t lo{0}, hi{0}; // valid while not empty
+    std::vector<Leaf> clusters; // one per summary bit, dense
+
+    bool empty() const { return clusters.empty(); }
+    bool contains(unsigned x) const;
+    bool insert(unsigned x);
+    bool remove(unsigned x);
+    int min() const { return empty() ? -1 : lo; }
+    int max() const { return empty() ? -1 : hi; }
+    int successor(unsigned x) const;
+    int predecessor(unsigned x) const;
+    template <typename Fn> void forEach(unsigned base, Fn &&fn) const;
+  };
+
+  static constexpr std::size_t TOP_CLUSTERS = std::size_t(1) << 16;
+
+  UKey lo{0}, hi{0}; // valid while count > 0; lo is in no cluster
+  std::size_t count{0};
+  Mid summary; // high halves of the clustered keys
+  std::vector<Mid *> clusters;
+
+  static UKey encode(Key key);
+  static Key decode(UKey u);
+  static unsigned high(UKey u) { return u >> 16; }
+  static unsigned low(UKey u) { return u & 0xffff; }
+  static UKey join(unsigned h, unsigned l) { return UKey(h) << 16 | l; }
+
+  const Mid *cluster(unsigned h) const {
+    return clusters.empty() ? nullptr : clusters[h];
+  }
+  void insertClustered(UKey u);
+  void removeClustered(UKey u);
+};
+
+//-------------------------------------------------------------------------------
+//                                Leaf (2^8)
+//-------------------------------------------------------------------------------
+
+template <Integer Key>
+bool VanEmdeBoasTree<Key>::Leaf::contains(unsigned x) const {
+  return getBit<std::uint64_t>(words[x >> 6], x & 63);
+}
+
+template <Integer Key> void VanEmdeBoasTree<Key>::Leaf::insert(unsigned x) {
+  words[x >> 6] = setBit<std::uint64_t>(words[x >> 6], x & 63);
+}
+
+template <Integer Key> void VanEmdeBoasTree<Key>::Leaf::remove(unsigned x) {
+  words[x >> 6] = unsetBit<std::uint64_t>(words[x >> 6], x & 63);
+}
+
+template <Integer Key> int VanEmdeBoasTree<Key>::Leaf::min() const {
+  for (int w = 0; w < 4; ++w)
+    if (words[w])
+      return w * 64 + lowestSetBit(words[w]);
+  return -1;
+}
+
+template <Integer Key> int VanEmdeBoasTree<Key>::Leaf::max() const {
+  for (int w = 3; w >= 0; --w)
+    if (words[w])
+      return w * 64 + highestSetBit(words[w]);
+  return -1;
+}
+
+template <Integer Key>
+int VanEmdeBoasTree<Key>::Leaf::successor(unsigned x) const {
+  int w = int(x >> 6);
+  if (std::uint64_t above = bitsAbove(words[w], int(x & 63)))
+    return w * 64 + lowestSetBit(above);
+  for (++w; w < 4; ++w)
+    if (words[w])
+      return w * 64 + lowestSetBit(words[w]);
+  return -1;
+}
+
+template <Integer Key>
+int VanEmdeBoasTree<Key>::Leaf::predecessor(unsigned x) const {
+  int w = int(x >> 6);
+  if (std::uint64_t below = bitsBelow(words[w], int(x & 63)))
+    return w * 64 + highestSetBit(below);
+  for (--w; w >= 0; --w)
+    if (words[w])
+      return w * 64 + highestSetBit(words[w]);
+  return -1;
+}
+
+template <Integer Key>
+unsigned VanEmdeBoasTree<Key>::Leaf::rank(unsigned x) const {
+  unsigned w = x >> 6, r = 0;
+  for (unsigned i = 0; i < w; ++i)
+    r += unsigned(popcount(words[i]));
+  return r + unsigned(popcount(bitsBelow(words[w], int(x & 63))));
+}
+
+//-------------------------------------------------------------------------------
+//                                 Mid (2^16)
+//-------------------------------------------------------------------------------
+
+template <Integer Key>
+bool VanEmdeBoasTree<Key>::Mid::contains(unsigned x) const {
+  unsigned h = x >> 8;
+  return summary.contains(h) && clusters[summary.rank(h)].contains(x & 255);
+}
+
+template <Integer Key> bool VanEmdeBoasTree<Key>::Mid::insert(unsigned x) {
+  unsigned h = x >> 8, r = summary.rank(h);
+  auto u = std::uint16_t(x);
+  if (empty()) {
+    lo = hi = u;
+  } else if (summary.contains(h) && clusters[r].contains(x & 255)) {
+    return false;
+  } else {
+    lo = std::min(lo, u);
+    hi = std::max(hi, u);
+  }
+  if (!summary.contains(h)) {
+    summary.insert(h);
+    clusters.insert(clusters.begin() + r, Leaf{});
+  }
+  clusters[r].insert(x & 255);
+  return true;
+}
+
+template <Integer Key> bool VanEmdeBoasTree<Key>::Mid::remove(unsigned x) {
+  unsigned h = x >> 8;
+  if (!summary.contains(h))
+    return false;
+  unsigned r = summary.rank(h);
+  if (!clusters[r].contains(x & 255))
+    return false;
+  clusters[r].remove(x & 255);
+  if (clusters[r].empty()) {
+    clusters.erase(clusters.begin() + r);
+    summary.remove(h);
+  }
+  if (empty())
+    return true;
+  if (x == lo)
+    lo = std::uint16_t(summary.min() << 8 | clusters.front().min());
+  if (x == hi)
+    hi = std::uint16_t(summary.max() << 8 | clusters.back().max());
+  return true;
+}
+
+template <Integer Key>
+int VanEmdeBoasTree<Key>::Mid::successor(unsigned x) const {
+  unsigned h = x >> 8;
+  unsigned r = summary.rank(h);
+  if (summary.contains(h)) {
+    if (int l = clusters[r].successor(x & 255); l >= 0)
+      return int(h << 8) | l;
+    ++r;
+  }
+  // the next non-empty cluster sits right after h's place in the array
+  return r < clusters.size() ? summary.successor(h) << 8 | clusters[r].min()
+                             : -1;
+}
+
+template <Integer Key>
+int VanEmdeBoasTree<Key>::Mid::predecessor(unsigned x) const {
+  unsigned h = x >> 8;
+  unsigned r = summary.rank(h);
+  if (summary.contains(h))
+    if (int l = clusters[r].predecessor(x & 255); l >= 0)
+      return int(h << 8) | l;
+  return r > 0 ? summary.predecessor(h) << 8 | clusters[r - 1].max() : -1;
+}
+
+template <Integer Key>
+template <typename Fn>
+void VanEmdeBoasTree<Key>::Mid::forEach(unsigned base, Fn &&fn) const {
+  std::size_t r = 0;
+  for (unsigned w = 0; w < 4; ++w) {
+    for (std::uint64_t hs = summary.words[w]; hs; hs &= hs - 1) {
+      unsigned h = w * 64 + unsigned(lowestSetBit(hs));
+      const Leaf &leaf = clusters[r++];
+      for (unsigned v = 0; v < 4; ++v)
+        for (std::uint64_t ls = leaf.words[v]; ls; ls &= ls - 1)
+          fn(base | h << 8 | (v * 64 + unsigned(lowestSetBit(ls))));
+    }
+  }
+}
+
+//-------------------------------------------------------------------------------
+//                        VanEmdeBoasTree Implementation
+//-------------------------------------------------------------------------------
+
+template <Integer Key>
+typename VanEmdeBoasTree<Key>::UKey VanEmdeBoasTree<Key>::encode(Key key) {
+  auto u = static_cast<std::make_unsigned_t<Key>>(key);
+  if constexpr (std::is_signed_v<Key>)
+    u ^= std::make_unsigned_t<Key>(1) << (sizeof(Key) * 8 - 1);
+  return UKey(u);
+}
+
+template <Integer Key> Key VanEmdeBoasTree<Key>::decode(UKey u) {
+  auto k = static_cast<std::make_unsigned_t<Key>>(u);
+  if constexpr (std::is_signed_v<Key>)
+    k ^= std::make_unsigned_t<Key>(1) << (sizeof(Key) * 8 - 1);
+  return static_cast<Key>(k);
+}
+
+template <Integer Key>
+VanEmdeBoasTree<Key>::VanEmdeBoasTree(std::initializer_list<Key> list) {
+  for (Key key : list)
+    insert(key);
+}
+
+template <Integer Key> VanEmdeBoasTree<Key>::~VanEmdeBoasTree() {
+  for (Mid *mid : clusters)
+    delete mid;
+}
+
+template <Integer Key> bool VanEmdeBoasTree<Key>::search(Key key) const {
+  if (count == 0)
+    return false;
+  UKey u = encode(key);
+  if (u == lo || u == hi)
+    return true;
+  const Mid *c = cluster(high(u));
+  return c && c->contains(low(u));
+}
+
+// u is above lo and not yet stored
+template <Integer Key> void VanEmdeBoasTree<Key>::insertClustered(UKey u) {
+  if (clusters.empty())
+    clusters.assign(TOP_CLUSTERS, nullptr);
+  Mid *&c = clusters[high(u)];
+  if (!c) {
+    c = new Mid;
+    summary.insert(high(u));
+  }
+  c->insert(low(u));
+}
+
+// u is stored in its cluster
+template <Integer Key> void VanEmdeBoasTree<Key>::removeClustered(UKey u) {
+  Mid *&c = clusters[high(u)];
+  c->remove(low(u));
+  if (c->empty()) {
+    delete c;
+    c = nullptr;
+    summary.remove(high(u));
+  }
+}
+
+template <Integer Key> bool VanEmdeBoasTree<Key>::insert(Key key) {
+  UKey u = encode(key);
+  if (count == 0) {
+    lo = hi = u;
+    count = 1;
+    return true;
+  }
+  if (search(key))
+    return false;
+  if (u < lo)
+    std::swap(u, lo); // the new key becomes the minimum, the old one moves in
+  insertClustered(u);
+  if (u > hi)
+    hi = u;
+  ++count;
+  return true;
+}
+
+template <Integer Key> bool VanEmdeBoasTree<Key>::remove(Key key) {
+  if (!search(key))
+    return false;
+  UKey u = encode(key);
+  if (--count == 0)
+    return true;
+
+  if (u == lo) { // promote the smallest clustered key to lo
+    unsigned h = unsigned(summary.min());
+    u = lo = join(h, unsigned(clusters[h]->min()));
+  }
+  removeClustered(u);
+  if (u == hi) {
+    int h = summary.max();
+    hi = h < 0 ? lo : join(unsigned(h), unsigned(clusters[h]->max()));
+  }
+  return true;
+}
+
+template <Integer Key>
+std::optional<Key> VanEmdeBoasTree<Key>::minimum() const {
+  return count ? std::optional<Key>(decode(lo)) : std::nullopt;
+}
+
+template <Integer Key>
+std::optional<Key> VanEmdeBoasTree<Key>::maximum() const {
+  return count ? std::optional<Key>(decode(hi)) : std::nullopt;
+}
+
+// One question per level: is the answer inside u's own cluster (compare
+// with that cluster's max), or in the next non-empty one (ask the summary)?
+template <Integer Key>
+std::optional<Key> VanEmdeBoasTree<Key>::successor(Key key) const {
+  UKey u = encode(key);
+  if (count == 0 || u >= hi)
+    return std::nullopt;
+  if (u < lo)
+    return decode(lo);
+  const Mid *c = cluster(high(u));
+  if (c && int(low(u)) < c->max())
+    return decode(join(high(u), unsigned(c->successor(low(u)))));
+  unsigned h = unsigned(summary.successor(high(u))); // exists: u < hi
+  return decode(join(h, unsigned(clusters[h]->min())));
+}
+
+template <Integer Key>
+std::optional<Key> VanEmdeBoasTree<Key>::predecessor(Key key) const {
+  UKey u = encode(key);
+  if (count == 0 || u <= lo)
+    return std::nullopt;
+  if (u > hi)
+    return decode(hi);
+  const Mid *c = cluster(high(u));
+  if (c && int(low(u)) > c->min())
+    return decode(join(high(u), unsigned(c->predecessor(low(u)))));
+  int h = summary.predecessor(high(u));
+  if (h < 0)
+    return decode(lo); // only the minimum lies below u
+  return decode(join(unsigned(h), unsigned(clusters[h]->max())));
+}
+
+template <Integer Key>
+template <typename Fn>
+void VanEmdeBoasTree<Key>::forEach(Fn &&fn) const {
+  if (count == 0)
+    return;
+  fn(decode(lo));
+  summary.forEach(0, [&](unsigned h) {
+    clusters[h]->forEach(UKey(h) << 16, [&](UKey u) { fn(decode(u)); });
+  });
+}
+
+template <Integer Key> std::size_t VanEmdeBoasTree<Key>::memoryUsage() const {
+  auto midBytes = [](const Mid &mid) {
+    return sizeof(Mid) + mid.clusters.capacity() * sizeof(Leaf);
+  };
+  std::size_t bytes = midBytes(summary) - sizeof(Mid) +
+                      clusters.capacity() * sizeof(Mid *);
+  summary.forEach(0, [&](unsigned h) { bytes += midBytes(*clusters[h]); });
+  return bytes;
+}
+
+} // namespace VEB
@@ -1,30 +1,278 @@
 #include "bignum.hpp"
-#include <cstdlib>
+#include "limbs.hpp"
 #include <cstring>
 #include <iostream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 
-BigInt::BigInt(const int n) {
-  len = 0;
-  memset(value, 0, sizeof(value));
-  flag = (n < 0);
+namespace {
+
+constexpr BigInt::Limb TEN19 = 10000000000000000000ull; // largest 10^k limb
+constexpr int TEN19_DIGITS = 19;
+
+} // namespace
+
+//-------------------------------------------------------------------------------
+//                                   Storage
+//-------------------------------------------------------------------------------
+
+BigInt::BigInt() : value(small), len(1), cap(INLINE_LIMBS), flag(false) {
+  small[0] = 0;
+}
+
+BigInt::BigInt(const BigInt &other) : BigInt() { *this = other; }
 
-  int input = std::abs(n);
-  if (input == 0) {
-    len = 1;
-    value[0] = 0;
+BigInt::BigInt(BigInt &&other) noexcept : BigInt() {
+  *this = std::move(other);
+}
+
+BigInt::~BigInt() { release(); }
+
+void BigInt::release() {
+  if (!isInline())
+    delete[] value;
+  value = small;
+  cap = INLINE_LIMBS;
+}
+
+// Keeps the current limbs; grows by at least half so a run of appends
+// stays linear
+void BigInt::reserve(int limbs) {
+  if (limbs <= cap)
     return;
+  int grown = cap + cap / 2;
+  int newCap = limbs > grown ? limbs : grown;
+  Limb *block = new Limb[newCap];
+  std::memcpy(block, value, sizeof(Limb) * len);
+  if (!isInline())
+    delete[] value;
+  value = block;
+  cap = newCap;
+}
+
+void BigInt::resize(int limbs) {
+  reserve(limbs);
+  if (limbs > len)
+    std::memset(value + len, 0, sizeof(Limb) * (limbs - len));
+  len = limbs;
+}
+
+void BigInt::trim() {
+  while (len > 1 && value[len - 1] == 0)
+    --len;
+  if (len == 1 && value[0] == 0)
+    flag = false; // no negative zero
+}
+
+// The existing block is reused whenever it is big enough
+BigInt &BigInt::operator=(const BigInt &other) {
+  if (this == &other)
+    return *this;
+  reserve(other.len);
+  std::memcpy(value, other.value, sizeof(Limb) * other.len);
+  len = other.len;
+  flag = other.flag;
+  return *this;
+}
+
+// Steals a heap block; inline values are copied, they are short
+BigInt &BigInt::operator=(BigInt &&other) noexcept {
+  if (this == &other)
+    return *this;
+  if (other.isInline()) {
+    std::memcpy(value, other.value, sizeof(Limb) * other.len);
+  } else {
+    release();
+    value = std::exchange(other.value, other.small);
+    cap = std::exchange(other.cap, INLINE_LIMBS);
+  }
+  len = std::exchange(other.len, 1);
+  flag = std::exchange(other.flag, false);
+  other.value[0] = 0;
+  return *this;
+}
+
+//-------------------------------------------------------------------------------
+//                                  Conversion
+//-------------------------------------------------------------------------------
+
+BigInt::BigInt(const int n) : BigInt() {
+  flag = (n < 0);
+  // through unsigned, so INT_MIN has a magnitude too
+  value[0] = flag ? 0u - unsigned(n) : unsigned(n);
+}
+
+// Optional sign, then decimal digits; parsing stops at the first other
+// character. Digits are taken 19 at a time: value = value * 10^19 + chunk.
+BigInt::BigInt(const char *text) : BigInt() {
+  bool negative = *text == '-';
+  if (*text == '-' || *text == '+')
+    ++text;
+  int digits = 0;
+  while (text[digits] >= '0' && text[digits] <= '9')
+    ++digits;
+
+  reserve(digits / TEN19_DIGITS + 1);
+  len = 1;
+  value[0] = 0;
+  for (int pos = 0; pos < digits;) {
+    int take = (digits - pos) % TEN19_DIGITS;
+    if (take == 0)
+      take = TEN19_DIGITS;
+    Limb chunk = 0, scale = 1;
+    for (int i = 0; i < take; ++i, ++pos) {
+      chunk = chunk * 10 + Limb(text[pos] - '0');
+      scale *= 10;
+    }
+    Limb carry = LIMBS::mulAddSmall(value, len, scale, chunk);
+    if (carry)
+      value[len++] = carry;
+  }
+  flag = negative;
+  trim();
+}
+
+// Peels 19 decimal digits at a time off a scratch copy
+std::string BigInt::toString() const {
+  std::vector<Limb> mag(value, value + len);
+  std::vector<Limb> chunks;
+  int n = len;
+  do {
+    chunks.push_back(LIMBS::divSmall(mag.data(), n, TEN19));
+    n = LIMBS::normalized(mag.data(), n);
+  } while (n > 0);
+
+  std::string out = flag ? "-" : "";
+  out += std::to_string(chunks.back());
+  char buf[TEN19_DIGITS + 1];
+  for (auto it = chunks.rbegin() + 1; it != chunks.rend(); ++it) {
+    unsigned long long chunk = *it;
+    for (int i = TEN19_DIGITS - 1; i >= 0; --i, chunk /= 10)
+      buf[i] = char('0' + chunk % 10);
+    out.append(buf, TEN19_DIGITS);
+  }
+  return out;
+}
+
+void BigInt::print() const { std::cout << toString(); }
+
+//-------------------------------------------------------------------------------
+//                            Addition / Comparison
+//-------------------------------------------------------------------------------
+
+bool BigInt::operator==(const BigInt &other) const {
+  return flag == other.flag &&
+         LIMBS::compare(value, len, other.value, other.len) == 0;
+}
+
+bool BigInt::operator<(const BigInt &other) const {
+  if (flag != other.flag)
+    return flag;
+  int order = LIMBS::compare(value, len, other.value, other.len);
+  return flag ? order > 0 : order < 0;
+}
+
+bool BigInt::operator<(const int &t) const { return *this < BigInt(t); }
+
+// sign(a) |a| + sign(b) |b|, with b's sign flipped when `negateB`
+BigInt BigInt::addSigned(const BigInt &a, const BigInt &b, bool negateB) {
+  bool bNegative = b.flag != negateB;
+  const BigInt *big = &a, *little = &b;
+  bool bigNegative = a.flag, littleNegative = bNegative;
+  if (LIMBS::compare(a.value, a.len, b.value, b.len) < 0) {
+    std::swap(big, little);
+    std::swap(bigNegative, littleNegative);
   }
 
-  while (input > 0 && len < MAXSIZE) {
-    value[len++] = input % 10;
-    input /= 10;
+  BigInt out;
+  out.reserve(big->len + 1); // every limb is written below
+  out.len = big->len + 1;
+  out.value[big->len] = 0;
+  if (bigNegative == littleNegative) {
+    out.value[big->len] = LIMBS::add(out.value, big->value, big->len,
+                                     little->value, little->len);
+  } else {
+    LIMBS::sub(out.value, big->value, big->len, little->value, little->len);
   }
+  out.flag = bigNegative;
+  out.trim();
+  return out;
 }
 
-void BigInt::print() const {
-  if (flag)
-    std::cout << '-';
-  for (int i = len - 1; i >= 0; --i) {
-    std::cout << value[i];
+BigInt BigInt::operator+(const BigInt &other) const {
+  return addSigned(*this, other, false);
+}
+
+BigInt BigInt::operator-(const BigInt &other) const {
+  return addSigned(*this, other, true);
+}
+
+//-------------------------------------------------------------------------------
+//                               Multiplication
+//-------------------------------------------------------------------------------
+
+// Schoolbook, Karatsuba, Toom-3 or the NTT by operand size, see
+// LIMBS::multiply
+BigInt BigInt::operator*(const BigInt &other) const {
+  const BigInt *a = this, *b = &other;
+  if (a->len < b->len)
+    std::swap(a, b);
+  BigInt out;
+  out.reserve(a->len + b->len);
+  out.len = a->len + b->len;
+  LIMBS::multiply(out.value, a->value, a->len, b->value, b->len);
+  out.flag = flag != other.flag;
+  out.trim();
+  return out;
+}
+
+// Power, by squaring over the exponent's bits from the top. A negative
+// exponent gives what integer division would: 0, or +-1 for a base of +-1.
+BigInt BigInt::operator^(const BigInt &exponent) const {
+  bool unit = len == 1 && value[0] == 1;
+  if (exponent.flag) {
+    bool odd = exponent.value[0] & 1;
+    return unit ? BigInt(flag && odd ? -1 : 1) : BigInt();
   }
+  BigInt result(1);
+  for (int i = exponent.len - 1; i >= 0; --i)
+    for (int bit = 63; bit >= 0; --bit) {
+      result = result * result;
+      if (exponent.value[i] >> bit & 1)
+        result = result * *this;
+    }
+  return result;
+}
+
+//-------------------------------------------------------------------------------
+//                                  Division
+//-------------------------------------------------------------------------------
+
+// Schoolbook, Burnikel-Ziegler or Newton reciprocal by divisor size, see
+// LIMBS::divide
+std::pair<BigInt, BigInt> BigInt::divmod(const BigInt &divisor) const {
+  if (divisor.len == 1 && divisor.value[0] == 0)
+    throw std::domain_error("BigInt division by zero");
+  if (LIMBS::compare(value, len, divisor.value, divisor.len) < 0)
+    return {BigInt(), *this};
+  BigInt q, r;
+  q.reserve(len - divisor.len + 1); // every limb is written below
+  q.len = len - divisor.len + 1;
+  r.reserve(divisor.len);
+  r.len = divisor.len;
+  LIMBS::divide(q.value, r.value, value, len, divisor.value, divisor.len);
+  q.flag = flag != divisor.flag;
+  r.flag = flag;
+  q.trim();
+  r.trim();
+  return {std::move(q), std::move(r)};
+}
+
+BigInt BigInt::operator/(const BigInt &other) const {
+  return divmod(other).first;
+}
+
+BigInt BigInt::operator%(const BigInt &other) const {
+  return divmod(other).second;
 }
@@ -0,0 +1,252 @@
+#include "limbs.hpp"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace LIMBS {
+namespace {
+
+//-------------------------------------------------------------------------------
+//                                  Schoolbook
+//-------------------------------------------------------------------------------
+
+// Knuth's algorithm D: q[0, nu - nv) = u / v, leaving u % v in u[0, nv). v
+// is normalized (top bit set) with nv >= 2, and u's top nv limbs are below
+// v, so every quotient limb fits. Each limb is estimated from the top two
+// limbs of the window and v's top limb, refined with the next limb of each
+// until it is exact or one too big, and the rare excess added back.
+void schoolbook(Limb *q, Limb *u, int nu, const Limb *v, int nv) {
+  Limb v1 = v[nv - 1], v2 = v[nv - 2];
+  for (int j = nu - nv - 1; j >= 0; --j) {
+    Limb *w = u + j; // w[0, nv] yields quotient limb j
+    Limb qhat, rhat;
+    bool wide = false; // rhat overflowed a limb, qhat needs no refining
+    if (w[nv] >= v1) { // equal, as the window is below v beta
+      qhat = ~Limb(0);
+      rhat = w[nv - 1] + v1;
+      wide = rhat < v1;
+    } else {
+      qhat = divWide(w[nv], w[nv - 1], v1, &rhat);
+    }
+    while (!wide && Wide(qhat) * v2 > (Wide(rhat) << 64 | w[nv - 2])) {
+      --qhat;
+      rhat += v1;
+      wide = rhat < v1;
+    }
+    Limb borrow = subProduct(w, v, nv, qhat);
+    Limb top = w[nv];
+    w[nv] = top - borrow;
+    if (top < borrow) {
+      --qhat;
+      w[nv] += add(w, w, nv, v, nv);
+    }
+    q[j] = qhat;
+  }
+}
+
+//-------------------------------------------------------------------------------
+//                                   Divider
+//-------------------------------------------------------------------------------
+
+// Division of normalized operands. Long divisors are handled a divisor-
+// length block of the quotient at a time, like schoolbook with limbs of n
+// limbs; each block is a 2n / n division by Burnikel-Ziegler recursion or
+// by multiplying with a reciprocal computed once by Newton's iteration.
+// Either way a block costs a small multiple of an n x n product.
+class Divider {
+public:
+  // below 4 the recursions would bottom out in one-limb divisors
+  explicit Divider(const DivThresholds &at)
+      : at{std::max(at.burnikelZiegler, 4), std::max(at.newton, 4)} {}
+
+  // q[0, nu - nv) = u / v, leaving u % v in u[0, nv); v normalized with
+  // nv >= 2 and u's top nv limbs below v
+  void run(Limb *q, Limb *u, int nu, const Limb *v, int nv) const {
+    int qn = nu - nv;
+    if (nv < at.burnikelZiegler || qn < at.burnikelZiegler) {
+      schoolbook(q, u, nu, v, nv);
+      return;
+    }
+    if (qn + 1 < nv) {
+      unbalanced(q, u, nu, v, nv);
+      return;
+    }
+
+    // Zero limbs go below u and v so the block size is m 2^k with m under
+    // the threshold, letting Burnikel-Ziegler halve evenly down to
+    // schoolbook. A short partial block on top is a quotient of its own, a
+    // longer one is filled out with zero limbs above u.
+    bool newton = nv >= at.newton;
+    int n = nv;
+    if (!newton) {
+      int k = 0;
+      while (((nv - 1) >> k) + 1 >= at.burnikelZiegler)
+        ++k;
+      n = (((nv - 1) >> k) + 1) << k;
+    }
+    int low = n - nv, part = qn % n, high = 0;
+    if (2 * part >= n) {
+      high = n - part;
+      part = 0;
+    }
+    int len = low + nu + high;
+    std::vector<Limb> w(len), d(n), quotient(qn + high);
+    std::copy(u, u + nu, w.begin() + low);
+    std::copy(v, v + nv, d.begin() + low);
+    if (part)
+      run(quotient.data() + qn - part, w.data() + qn - part, n + part,
+          d.data(), n);
+
+    if (newton) {
+      std::vector<Limb> inverse(n + 1), scratch(2 * n + 1);
+      reciprocal(inverse.data(), d.data(), n);
+      for (int j = qn + high - part - n; j >= 0; j -= n)
+        divReciprocal(quotient.data() + j, w.data() + j, d.data(),
+                      inverse.data(), n, scratch.data());
+    } else {
+      std::vector<Limb> scratch(n);
+      for (int j = qn + high - part - n; j >= 0; j -= n)
+        div2n1n(quotient.data() + j, w.data() + j, d.data(), n,
+                scratch.data());
+    }
+    std::copy(quotient.begin(), quotient.begin() + qn, q);
+    std::copy(w.begin() + low, w.begin() + low + nv, u);
+  }
+
+private:
+  DivThresholds at;
+
+  // A quotient much shorter than the divisor depends only on the divisor's
+  // top qn + 1 limbs: dividing the matching top of u by them gives at most
+  // 2 too much, which one qn x nv product and a subtraction or two fix.
+  void unbalanced(Limb *q, Limb *u, int nu, const Limb *v, int nv) const {
+    int qn = nu - nv, t = qn + 1;
+    std::vector<Limb> top(qn + t + 1), estimate(qn + 1), p(nu + 1);
+    std::copy(u + nu - qn - t, u + nu, top.begin()); // top limb stays 0
+    run(estimate.data(), top.data(), qn + t + 1, v + nv - t, t);
+    multiply(p.data(), v, nv, estimate.data(), qn + 1);
+    while (compare(p.data(), nu + 1, u, nu) > 0) {
+      subLimb(estimate.data(), qn + 1, 1);
+      sub(p.data(), p.data(), nu + 1, v, nv);
+    }
+    sub(u, u, nu, p.data(), nu);
+    std::copy(estimate.begin(), estimate.begin() + qn, q);
+  }
+
+  // Burnikel-Ziegler: q[0, n) = a / b, leaving a % b in a[0, n), for a of 2n
+  // limbs below b beta^n. Two 3h / 2h steps on halves, each a recursive
+  // h-limb division and an h x h product. `scratch` holds n limbs.
+  void div2n1n(Limb *q, Limb *a, const Limb *b, int n, Limb *scratch) const {
+    if (n % 2 || n < at.burnikelZiegler) {
+      schoolbook(q, a, 2 * n, b, n);
+      return;
+    }
+    int h = n / 2;
+    div3n2n(q + h, a + h, b, h, scratch);
+    div3n2n(q, a, b, h, scratch);
+  }
+
+  // q[0, h) = a / b, leaving a % b in a[0, 2h), for a of 3h limbs below
+  // b beta^h. The estimate from b's top half is at most 2 too big.
+  void div3n2n(Limb *q, Limb *a, const Limb *b, int h, Limb *scratch) const {
+    const Limb *b1 = b + h;
+    if (compare(a + 2 * h, h, b1, h) < 0) {
+      div2n1n(q, a + h, b1, h, scratch);
+      a[2 * h] = 0;
+    } else { // top halves equal: beta^h - 1, remainder a1 + b1
+      std::fill(q, q + h, ~Limb(0));
+      a[2 * h] = add(a + h, a + h, h, b1, h);
+    }
+    multiply(scratch, q, h, b, h);
+    bool negative = sub(a, a, 2 * h + 1, scratch, 2 * h) != 0;
+    while (negative) {
+      subLimb(q, h, 1);
+      negative = add(a, a, 2 * h + 1, b, 2 * h) == 0;
+    }
+  }
+
+  // x[0, n + 1) within 3 of (beta^2n - 1) / b, for b of n limbs with its
+  // top bit set. One Newton step x + x (beta^2n - b x) / beta^2n from the
+  // reciprocal of b's top h limbs doubles its precision; h is a limb over
+  // half so the error stays put from level to level instead of growing.
+  void reciprocal(Limb *x, const Limb *b, int n) const {
+    if (n < at.newton) { // exact: x - beta^n = (beta^2n - 1 - b beta^n) / b
+      std::vector<Limb> u(2 * n, ~Limb(0));
+      for (int i = 0; i < n; ++i)
+        u[n + i] = ~b[i];
+      run(x, u.data(), 2 * n, b, n);
+      x[n] = 1;
+      return;
+    }
+    int h = n / 2 + 1, l = n - h;
+    std::vector<Limb> xh(h + 1);
+    reciprocal(xh.data(), b + l, h);
+
+    // x0 = xh beta^l misses beta^2n by e beta^l, e = beta^(n+h) - b xh
+    std::vector<Limb> e(n + h + 1);
+    multiply(e.data(), b, n, xh.data(), h + 1);
+    bool over = e[n + h] != 0; // b xh < 2 beta^(n+h)
+    if (!over) {
+      for (int i = 0; i < n + h; ++i)
+        e[i] = ~e[i];
+      addLimb(e.data(), n + h, 1);
+    }
+    std::fill(x, x + l, 0);
+    std::copy(xh.begin(), xh.end(), x + l);
+    if (int ne = normalized(e.data(), n + h); ne + 1 > h) {
+      std::vector<Limb> t(ne + h + 1);
+      if (ne >= h + 1)
+        multiply(t.data(), e.data(), ne, xh.data(), h + 1);
+      else
+        multiply(t.data(), xh.data(), h + 1, e.data(), ne);
+      const Limb *step = t.data() + 2 * h; // xh e / beta^2h
+      if (over)
+        sub(x, x, n + 1, step, ne + 1 - h);
+      else
+        add(x, x, n + 1, step, ne + 1 - h);
+    }
+  }
+
+  // q[0, n) = a / b, leaving a % b in a[0, n), for a of 2n limbs below
+  // b beta^n and inverse = reciprocal(b). The top half of a times the
+  // inverse is within a few units of the quotient. `scratch` holds 2n + 1.
+  void divReciprocal(Limb *q, Limb *a, const Limb *b, const Limb *inverse,
+                     int n, Limb *scratch) const {
+    multiply(scratch, inverse, n + 1, a + n, n);
+    if (scratch[2 * n] != 0) // over beta^n, so above the quotient anyway
+      std::fill(q, q + n, ~Limb(0));
+    else
+      std::copy(scratch + n, scratch + 2 * n, q);
+    multiply(scratch, q, n, b, n);
+    bool negative = sub(a, a, 2 * n, scratch, 2 * n) != 0;
+    while (negative) {
+      subLimb(q, n, 1);
+      negative = add(a, a, 2 * n, b, n) == 0;
+    }
+    while (compare(a, 2 * n, b, n) >= 0) {
+      sub(a, a, 2 * n, b, n);
+      addLimb(q, n, 1);
+    }
+  }
+};
+
+} // namespace
+
+// Both operands are shifted so b's top bit is set, which the quotient
+// estimates rely on; the remainder is shifted back.
+void divide(Limb *q, Limb *r, const Limb *a, int na, const Limb *b, int nb,
+            const DivThresholds &at) {
+  if (nb == 1) {
+    std::memcpy(q, a, sizeof(Limb) * na);
+    r[0] = divSmall(q, na, b[0]);
+    return;
+  }
+  int shift = leadingZeros(b[nb - 1]);
+  std::vector<Limb> u(na + 1), v(nb);
+  shiftLeft(v.data(), b, nb, shift);
+  u[na] = shiftLeft(u.data(), a, na, shift);
+  Divider(at).run(q, u.data(), na + 1, v.data(), nb);
+  shiftRight(r, u.data(), nb, shift);
+}
+
+} // namespace LIMBS
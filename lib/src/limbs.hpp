@@ -0,0 +1,307 @@
+#pragma once
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+namespace LIMBS {
+
+//-------------------------------------------------------------------------------
+//                              Magnitude Kernels
+//-------------------------------------------------------------------------------
+
+// Unsigned arithmetic on little-endian arrays of 64-bit limbs, the layer
+// under BigInt. Lengths are limb counts; unless noted, outputs may alias
+// the first operand but must not overlap anything else. Carries use the
+// ADC intrinsic on x86-64 and 128-bit arithmetic elsewhere.
+
+// unsigned long long rather than std::uint64_t (unsigned long on LP64), so
+// the intrinsics write straight into the limb instead of via a temporary
+using Limb = unsigned long long;
+__extension__ typedef unsigned __int128 Wide; // quiets -Wpedantic
+
+static_assert(sizeof(Limb) == 8);
+
+inline unsigned char addCarry(unsigned char carry, Limb a, Limb b, Limb *out) {
+#if defined(__x86_64__)
+  return _addcarry_u64(carry, a, b, out);
+#else
+  Wide sum = Wide(a) + b + carry;
+  *out = Limb(sum);
+  return (unsigned char)(sum >> 64);
+#endif
+}
+
+inline unsigned char subBorrow(unsigned char borrow, Limb a, Limb b,
+                               Limb *out) {
+#if defined(__x86_64__)
+  return _subborrow_u64(borrow, a, b, out);
+#else
+  Wide diff = Wide(a) - b - borrow;
+  *out = Limb(diff);
+  return (unsigned char)(diff >> 127);
+#endif
+}
+
+// significant length: n without the zero limbs on top
+inline int normalized(const Limb *a, int n) {
+  while (n > 0 && a[n - 1] == 0)
+    --n;
+  return n;
+}
+
+inline int compare(const Limb *a, int na, const Limb *b, int nb) {
+  na = normalized(a, na);
+  nb = normalized(b, nb);
+  if (na != nb)
+    return na < nb ? -1 : 1;
+  for (int i = na - 1; i >= 0; --i)
+    if (a[i] != b[i])
+      return a[i] < b[i] ? -1 : 1;
+  return 0;
+}
+
+// out[0, na) = a + b for na >= nb; returns the carry out of the top limb.
+// Unrolled so the carry stays in the flags across four limbs.
+inline Limb add(Limb *out, const Limb *a, int na, const Limb *b, int nb) {
+  unsigned char carry = 0;
+  int i = 0;
+  for (; i + 4 <= nb; i += 4) {
+    carry = addCarry(carry, a[i], b[i], &out[i]);
+    carry = addCarry(carry, a[i + 1], b[i + 1], &out[i + 1]);
+    carry = addCarry(carry, a[i + 2], b[i + 2], &out[i + 2]);
+    carry = addCarry(carry, a[i + 3], b[i + 3], &out[i + 3]);
+  }
+  for (; i < nb; ++i)
+    carry = addCarry(carry, a[i], b[i], &out[i]);
+  for (; i < na; ++i)
+    carry = addCarry(carry, a[i], 0, &out[i]);
+  return carry;
+}
+
+// out[0, na) = a - b for na >= nb; returns the borrow (1 when a < b)
+inline Limb sub(Limb *out, const Limb *a, int na, const Limb *b, int nb) {
+  unsigned char borrow = 0;
+  int i = 0;
+  for (; i + 4 <= nb; i += 4) {
+    borrow = subBorrow(borrow, a[i], b[i], &out[i]);
+    borrow = subBorrow(borrow, a[i + 1], b[i + 1], &out[i + 1]);
+    borrow = subBorrow(borrow, a[i + 2], b[i + 2], &out[i + 2]);
+    borrow = subBorrow(borrow, a[i + 3], b[i + 3], &out[i + 3]);
+  }
+  for (; i < nb; ++i)
+    borrow = subBorrow(borrow, a[i], b[i], &out[i]);
+  for (; i < na; ++i)
+    borrow = subBorrow(borrow, a[i], 0, &out[i]);
+  return borrow;
+}
+
+// a[0, n) += c; returns the carry out of a[n - 1]
+inline Limb addLimb(Limb *a, int n, Limb c) {
+  for (int i = 0; i < n && c; ++i)
+    c = addCarry(0, a[i], c, &a[i]);
+  return c;
+}
+
+// a[0, n) -= c; returns the borrow out of a[n - 1]
+inline Limb subLimb(Limb *a, int n, Limb c) {
+  for (int i = 0; i < n && c; ++i)
+    c = subBorrow(0, a[i], c, &a[i]);
+  return c;
+}
+
+// out[0, nx) = |x - y| for nx >= ny; returns whether x < y. Either input
+// may be out.
+inline bool difference(Limb *out, const Limb *x, int nx, const Limb *y,
+                       int ny) {
+  if (compare(x, nx, y, ny) >= 0) {
+    sub(out, x, nx, y, ny);
+    return false;
+  }
+  int shorter = normalized(x, nx); // below ny, since x < y
+  sub(out, y, ny, x, shorter);
+  for (int i = ny; i < nx; ++i)
+    out[i] = 0;
+  return true;
+}
+
+// out[0, n) = a * m; returns the high limb
+inline Limb mulSmall(Limb *out, const Limb *a, int n, Limb m) {
+  Limb carry = 0;
+  for (int i = 0; i < n; ++i) {
+    Wide t = Wide(a[i]) * m + carry;
+    out[i] = Limb(t);
+    carry = Limb(t >> 64);
+  }
+  return carry;
+}
+
+// out[0, n) += a * m; returns the limb that carries out. The inner loop of
+// schoolbook multiplication.
+inline Limb addProduct(Limb *out, const Limb *a, int n, Limb m) {
+  Limb carry = 0;
+  for (int i = 0; i < n; ++i) {
+    Wide t = Wide(a[i]) * m + out[i] + carry;
+    out[i] = Limb(t);
+    carry = Limb(t >> 64);
+  }
+  return carry;
+}
+
+// out[0, n) -= a * m; returns the limb borrowed from above
+inline Limb subProduct(Limb *out, const Limb *a, int n, Limb m) {
+  Limb borrow = 0;
+  for (int i = 0; i < n; ++i) {
+    Wide t = Wide(a[i]) * m + borrow;
+    Limb low = Limb(t);
+    borrow = Limb(t >> 64) + (out[i] < low);
+    out[i] -= low;
+  }
+  return borrow;
+}
+
+// a[0, n) = a * m + add; returns the limb that carries out
+inline Limb mulAddSmall(Limb *a, int n, Limb m, Limb add) {
+  for (int i = 0; i < n; ++i) {
+    Wide t = Wide(a[i]) * m + add;
+    a[i] = Limb(t);
+    add = Limb(t >> 64);
+  }
+  return add;
+}
+
+// (hi, lo) / d for hi < d, so the quotient fits a limb; *rem gets the
+// remainder. One DIV instruction on x86-64 rather than a 128-bit library
+// division.
+inline Limb divWide(Limb hi, Limb lo, Limb d, Limb *rem) {
+#if defined(__x86_64__) && defined(__GNUC__)
+  Limb q;
+  __asm__("divq %4" : "=a"(q), "=d"(*rem) : "a"(lo), "d"(hi), "rm"(d));
+  return q;
+#else
+  Wide t = Wide(hi) << 64 | lo;
+  *rem = Limb(t % d);
+  return Limb(t / d);
+#endif
+}
+
+// a[0, n) /= d (d != 0); returns the remainder
+inline Limb divSmall(Limb *a, int n, Limb d) {
+  Limb rem = 0;
+  for (int i = n - 1; i >= 0; --i)
+    a[i] = divWide(rem, a[i], d, &rem);
+  return rem;
+}
+
+// zero bits above the top set bit of x != 0
+inline int leadingZeros(Limb x) {
+#if defined(__GNUC__)
+  return __builtin_clzll(x);
+#else
+  int n = 0;
+  for (; !(x >> 63); x <<= 1)
+    ++n;
+  return n;
+#endif
+}
+
+// out[0, n) = a << bits for 0 <= bits < 64; returns the bits shifted out.
+// out may equal a.
+inline Limb shiftLeft(Limb *out, const Limb *a, int n, int bits) {
+  if (bits == 0) {
+    for (int i = n - 1; i >= 0; --i)
+      out[i] = a[i];
+    return 0;
+  }
+  Limb over = a[n - 1] >> (64 - bits);
+  for (int i = n - 1; i > 0; --i)
+    out[i] = a[i] << bits | a[i - 1] >> (64 - bits);
+  out[0] = a[0] << bits;
+  return over;
+}
+
+// out[0, n) = a >> bits for 0 <= bits < 64; out may equal a
+inline void shiftRight(Limb *out, const Limb *a, int n, int bits) {
+  if (bits == 0) {
+    for (int i = 0; i < n; ++i)
+      out[i] = a[i];
+    return;
+  }
+  for (int i = 0; i + 1 < n; ++i)
+    out[i] = a[i] >> bits | a[i + 1] << (64 - bits);
+  out[n - 1] = a[n - 1] >> bits;
+}
+
+// a[0, n) /= d for a d known to divide it. Trailing zero bits are shifted
+// out, the odd part is divided by multiplying with its inverse mod 2^64
+// (Hensel division), which costs a multiply rather than a divide per limb.
+inline void divExactSmall(Limb *a, int n, Limb d) {
+  int shift = 0;
+  while (!(d & 1)) {
+    d >>= 1;
+    ++shift;
+  }
+  shiftRight(a, a, n, shift);
+  if (d == 1)
+    return;
+  Limb inverse = d; // Newton: each step doubles the correct low bits
+  for (int i = 0; i < 5; ++i)
+    inverse *= 2 - d * inverse;
+  Limb borrow = 0;
+  for (int i = 0; i < n; ++i) {
+    Limb x = a[i] - borrow;
+    Limb under = a[i] < borrow;
+    a[i] = x * inverse;
+    borrow = Limb(Wide(a[i]) * d >> 64) + under;
+  }
+}
+
+//-------------------------------------------------------------------------------
+//                               Multiplication
+//-------------------------------------------------------------------------------
+
+// Crossovers between the multiplication algorithms, in limbs of the shorter
+// operand: schoolbook below `karatsuba`, then Karatsuba, Toom-3 from `toom3`
+// and the NTT from `ntt`. Measured with bench/bignum_bench.cpp. Toom-3 also
+// splits products too long for the NTT into pieces it can take.
+struct MulThresholds {
+  int karatsuba = 24;
+  int toom3 = 800;
+  int ntt = 1500;
+};
+
+// out[0, na + nb) = a * b for na >= nb >= 1; out must not overlap either
+// input. Scratch for the whole recursion is allocated once, here. In
+// lib/src/mul.cpp.
+void multiply(Limb *out, const Limb *a, int na, const Limb *b, int nb,
+              const MulThresholds &at = {});
+
+// Longest product (na + nb) the three-prime NTT can form
+constexpr int NTT_MAX_LIMBS = 1 << 24;
+
+// multiply() by number-theoretic transforms modulo three primes, the three
+// run in parallel for large operands. Any na, nb >= 1 with
+// na + nb <= NTT_MAX_LIMBS. In lib/src/ntt.cpp.
+void multiplyNtt(Limb *out, const Limb *a, int na, const Limb *b, int nb);
+
+//-------------------------------------------------------------------------------
+//                                  Division
+//-------------------------------------------------------------------------------
+
+// Crossovers between the division algorithms, in limbs of the divisor:
+// schoolbook (Knuth's algorithm D) below `burnikelZiegler`, or while the
+// quotient is shorter than that; Burnikel-Ziegler recursion up to `newton`,
+// and beyond it a Newton-iteration reciprocal that turns each step into two
+// products. Measured with bench/bignum_bench.cpp.
+struct DivThresholds {
+  int burnikelZiegler = 40;
+  int newton = 32768;
+};
+
+// q[0, na - nb + 1) = a / b and r[0, nb) = a % b for na >= nb >= 1 and
+// b[nb - 1] != 0; q and r must not overlap the inputs or each other. In
+// lib/src/div.cpp.
+void divide(Limb *q, Limb *r, const Limb *a, int na, const Limb *b, int nb,
+            const DivThresholds &at = {});
+
+} // namespace LIMBS
@@ -0,0 +1,281 @@
+#include "limbs.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+namespace LIMBS {
+namespace {
+
+//-------------------------------------------------------------------------------
+//                                Toom-Cook tables
+//-------------------------------------------------------------------------------
+
+// Splitting a into k pieces and b into kb pieces of s limbs turns a * b into
+// a product of polynomials with m = k + kb - 1 coefficients. Those are
+// recovered from the products at m points: the first m - 1 of POINTS and
+// infinity.
+constexpr Limb POINTS[] = {0, 1, 1, 2}; // magnitudes; odd indices > 0
+constexpr int MAX_POINTS = 5;
+
+// Rows 1 .. m - 2 of the inverse Vandermonde matrix for m points, scaled to
+// integers: coefficient j = (sum_i coeff[i] * W_i) / divisor, W_i being the
+// product at point i (the last at infinity). Coefficients 0 and m - 1 are
+// W_0 and W_inf as they stand.
+struct Row {
+  Limb divisor;
+  int coeff[MAX_POINTS];
+};
+
+constexpr Row ROWS4[] = {{2, {0, 1, -1, -2}}, {2, {-2, 1, 1, 0}}};
+constexpr Row ROWS5[] = {{6, {-3, 6, -2, -1, 12}},
+                         {2, {-2, 1, 1, 0, -2}},
+                         {6, {3, -3, -1, 1, -12}}};
+constexpr const Row *ROWS[] = {ROWS4, ROWS5}; // by m - 4
+
+// acc[0, n) += c * x[0, nx), modulo 2^(64 n)
+void accumulate(Limb *acc, int n, const Limb *x, int nx, int c) {
+  if (c == 1)
+    add(acc, acc, n, x, nx);
+  else if (c == -1)
+    sub(acc, acc, n, x, nx);
+  else if (c > 0)
+    addLimb(acc + nx, n - nx, addProduct(acc, x, nx, Limb(c)));
+  else
+    subLimb(acc + nx, n - nx, subProduct(acc, x, nx, Limb(-c)));
+}
+
+// The polynomial with `pieces` coefficients of s limbs (the last one `top`
+// limbs) at x = p and x = -p: plus = value at p and, unless null, minus =
+// |value at -p|. Returns whether the value at -p is negative. Each output
+// is s + 1 limbs, as is `odd`, which is scratch.
+bool evaluate(Limb *plus, Limb *minus, Limb *odd, const Limb *x, int pieces,
+              int s, int top, Limb p) {
+  int n = s + 1;
+  std::memset(plus, 0, sizeof(Limb) * n);
+  std::memset(odd, 0, sizeof(Limb) * n);
+  Limb power = 1;
+  for (int i = 0; i < pieces; ++i, power *= p) {
+    Limb *acc = i % 2 ? odd : plus;
+    int len = i == pieces - 1 ? top : s;
+    if (power == 1)
+      add(acc, acc, n, x + i * s, len);
+    else
+      addLimb(acc + len, n - len, addProduct(acc, x + i * s, len, power));
+  }
+  bool negative = minus && difference(minus, plus, n, odd, n);
+  add(plus, plus, n, odd, n);
+  return negative;
+}
+
+//-------------------------------------------------------------------------------
+//                                  Dispatch
+//-------------------------------------------------------------------------------
+
+struct Plan {
+  enum Kind { Basecase, Chunked, Karatsuba, Toom, Ntt } kind;
+  int s = 0;  // piece size
+  int k = 0;  // pieces of a
+  int kb = 0; // pieces of b
+};
+
+// One top-level product. Every step takes its temporaries from the front of
+// `scratch` and hands the rest down, so need() can size the whole recursion
+// up front.
+class Multiplier {
+public:
+  explicit Multiplier(const MulThresholds &at) : at(at) {}
+
+  Plan plan(int na, int nb) const {
+    if (nb < at.karatsuba)
+      return {Plan::Basecase};
+    if (nb >= at.ntt && na + nb <= NTT_MAX_LIMBS)
+      return {Plan::Ntt};
+    int k = nb >= at.toom3 ? 3 : 2;
+    int s = (na + k - 1) / k;
+    while (k > 2 && na - (k - 1) * s < 1) { // no room for a top piece
+      --k;
+      s = (na + k - 1) / k;
+    }
+    int kb = (nb + s - 1) / s;
+    if (kb < 2) // b fits in one piece of a, multiply piece by piece
+      return {Plan::Chunked};
+    return {k == 2 ? Plan::Karatsuba : Plan::Toom, s, k, kb};
+  }
+
+  // scratch limbs for a * b, including everything below it
+  std::size_t need(int na, int nb) const {
+    if (na < nb)
+      std::swap(na, nb);
+    Plan p = plan(na, nb);
+    switch (p.kind) {
+    case Plan::Basecase:
+    case Plan::Ntt: // allocates its own transform buffers
+      return 0;
+    case Plan::Chunked: {
+      std::size_t below = need(nb, nb);
+      if (int rem = na % nb)
+        below = std::max(below, need(nb, rem));
+      return 2 * std::size_t(nb) + below;
+    }
+    case Plan::Karatsuba:
+      return 4 * std::size_t(p.s) + 1 +
+             std::max(need(p.s, p.s), need(na - p.s, nb - p.s));
+    case Plan::Toom:
+      break;
+    }
+    std::size_t wide = 2 * std::size_t(p.s) + 2;
+    std::size_t products = (p.k + p.kb - 3) * wide;
+    std::size_t work = std::max(6 * (std::size_t(p.s) + 1), products);
+    int ha = na - (p.k - 1) * p.s, hb = nb - (p.kb - 1) * p.s;
+    return products + work +
+           std::max({need(p.s, p.s), need(p.s + 1, p.s + 1), need(ha, hb)});
+  }
+
+  void run(Limb *out, const Limb *a, int na, const Limb *b, int nb,
+           Limb *scratch) const {
+    if (na < nb) {
+      std::swap(a, b);
+      std::swap(na, nb);
+    }
+    Plan p = plan(na, nb);
+    switch (p.kind) {
+    case Plan::Basecase:
+      return basecase(out, a, na, b, nb);
+    case Plan::Chunked:
+      return chunked(out, a, na, b, nb, scratch);
+    case Plan::Karatsuba:
+      return karatsuba(out, a, na, b, nb, p.s, scratch);
+    case Plan::Toom:
+      return toom(out, a, na, b, nb, p, scratch);
+    case Plan::Ntt:
+      return multiplyNtt(out, a, na, b, nb);
+    }
+  }
+
+private:
+  const MulThresholds &at;
+
+  //-----------------------------------------------------------------------------
+  //                               Algorithms
+  //-----------------------------------------------------------------------------
+
+  static void basecase(Limb *out, const Limb *a, int na, const Limb *b,
+                       int nb) {
+    out[na] = mulSmall(out, a, na, b[0]);
+    for (int j = 1; j < nb; ++j)
+      out[na + j] = addProduct(out + j, a, na, b[j]);
+  }
+
+  // a much longer than b: a in b-sized pieces, each product added in at
+  // its offset
+  void chunked(Limb *out, const Limb *a, int na, const Limb *b, int nb,
+               Limb *scratch) const {
+    Limb *t = scratch, *rest = t + 2 * nb;
+    run(out, a, nb, b, nb, rest);
+    for (int off = nb; off < na; off += nb) {
+      int len = std::min(nb, na - off);
+      run(t, a + off, len, b, nb, rest);
+      Limb carry = add(out + off, out + off, nb, t, nb);
+      std::memcpy(out + off + nb, t + nb, sizeof(Limb) * len);
+      addLimb(out + off + nb, len, carry);
+    }
+  }
+
+  // Subtractive Karatsuba: with a = a1 x + a0 and b = b1 x + b0, the middle
+  // coefficient is a0 b0 + a1 b1 - (a0 - a1)(b0 - b1). The differences stay
+  // within s limbs where the sums would not.
+  void karatsuba(Limb *out, const Limb *a, int na, const Limb *b, int nb,
+                 int s, Limb *scratch) const {
+    int ha = na - s, hb = nb - s;
+    Limb *da = scratch, *db = da + s, *t = db + s + 1, *rest = t + 2 * s;
+    bool negative = difference(da, a, s, a + s, ha) !=
+                    difference(db, b, s, b + s, hb);
+    run(out, a, s, b, s, rest);
+    run(out + 2 * s, a + s, ha, b + s, hb, rest);
+    run(t, da, s, db, s, rest);
+
+    Limb *mid = scratch; // 2s + 1 limbs, over the spent differences
+    mid[2 * s] = add(mid, out, 2 * s, out + 2 * s, ha + hb);
+    if (negative)
+      add(mid, mid, 2 * s + 1, t, 2 * s);
+    else
+      sub(mid, mid, 2 * s + 1, t, 2 * s);
+    int room = na + nb - s; // mid's limbs past this are zero
+    add(out + s, out + s, room, mid, std::min(2 * s + 1, room));
+  }
+
+  // Toom-Cook with k pieces of a and kb of b (Toom-3 and its unbalanced
+  // 3 x 2 form): products at the points of POINTS, interpolation by the
+  // ROWS matrices, exact division by each row's divisor.
+  void toom(Limb *out, const Limb *a, int na, const Limb *b, int nb,
+            const Plan &p, Limb *scratch) const {
+    const int s = p.s, m = p.k + p.kb - 1, inner = m - 2;
+    const int ha = na - (p.k - 1) * s, hb = nb - (p.kb - 1) * s;
+    const int n = s + 1, wide = 2 * s + 2;
+    Limb *w = scratch; // products at the inner points, `wide` limbs each
+    Limb *work = w + inner * wide;
+    Limb *rest = work + std::max(6 * n, inner * wide);
+    bool negative[MAX_POINTS] = {};
+
+    Limb *pa = work, *ma = pa + n, *oa = ma + n;
+    Limb *pb = oa + n, *mb = pb + n, *ob = mb + n;
+    for (int i = 1; i <= inner; i += 2) {
+      bool pair = i + 1 <= inner; // -p is a point too
+      bool negA = evaluate(pa, pair ? ma : nullptr, oa, a, p.k, s, ha,
+                          POINTS[i]);
+      bool negB = evaluate(pb, pair ? mb : nullptr, ob, b, p.kb, s, hb,
+                          POINTS[i]);
+      run(w + (i - 1) * wide, pa, n, pb, n, rest);
+      if (pair) {
+        run(w + i * wide, ma, n, mb, n, rest);
+        negative[i + 1] = negA != negB;
+      }
+    }
+    run(out, a, s, b, s, rest);
+    run(out + (m - 1) * s, a + (p.k - 1) * s, ha, b + (p.kb - 1) * s, hb,
+        rest);
+
+    // The middle coefficients are exact and fit in `wide` limbs, so the
+    // signed sums can wrap around on the way there
+    Limb *coeff = work;
+    const Row *rows = ROWS[m - 4];
+    for (int j = 0; j < inner; ++j) {
+      Limb *acc = coeff + j * wide;
+      std::memset(acc, 0, sizeof(Limb) * wide);
+      for (int i = 0; i < m; ++i) {
+        int c = rows[j].coeff[i];
+        if (c == 0)
+          continue;
+        if (i == 0)
+          accumulate(acc, wide, out, 2 * s, c);
+        else if (i == m - 1)
+          accumulate(acc, wide, out + (m - 1) * s, ha + hb, c);
+        else
+          accumulate(acc, wide, w + (i - 1) * wide, wide,
+                     negative[i] ? -c : c);
+      }
+      divExactSmall(acc, wide, rows[j].divisor);
+    }
+
+    std::memset(out + 2 * s, 0, sizeof(Limb) * (m - 3) * s);
+    for (int j = 0; j < inner; ++j) {
+      int off = (j + 1) * s, room = na + nb - off;
+      add(out + off, out + off, room, coeff + j * wide, std::min(wide, room));
+    }
+  }
+};
+
+} // namespace
+
+void multiply(Limb *out, const Limb *a, int na, const Limb *b, int nb,
+              const MulThresholds &at) {
+  Multiplier mul(at);
+  std::unique_ptr<Limb[]> scratch;
+  if (std::size_t size = mul.need(na, nb))
+    scratch.reset(new Limb[size]);
+  mul.run(out, a, na, b, nb, scratch.get());
+}
+
+} // namespace LIMBS
@@ -0,0 +1,458 @@
+#include "limbs.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define NTT_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace LIMBS {
+namespace {
+
+//-------------------------------------------------------------------------------
+//                            Montgomery arithmetic
+//-------------------------------------------------------------------------------
+
+// Number-theoretic transforms run on 32-bit words modulo three primes of the
+// form c 2^k + 1, just under 2^31. The operands are cut into 32-bit pieces,
+// so each coefficient of the product is below 2^24 * 2^64 for any length
+// the primes allow (2^25 points), safely under their product (2^92.6), and
+// the Chinese remainder theorem recovers it exactly.
+using Word = std::uint32_t;
+
+constexpr std::uint64_t powMod(std::uint64_t base, std::uint64_t e,
+                               std::uint64_t mod) {
+  std::uint64_t result = 1;
+  for (base %= mod; e; e >>= 1, base = Wide(base) * base % mod)
+    if (e & 1)
+      result = Wide(result) * base % mod;
+  return result;
+}
+
+// Values are kept in Montgomery form x 2^32 mod p, fully reduced
+struct Prime {
+  Word p;
+  Word root;  // generates the multiplicative group
+  int order;  // 2^order divides p - 1
+  Word inv;   // p^-1 mod 2^32
+  Word r2;    // 2^64 mod p: mul(x, r2) puts x in Montgomery form
+  Word one;   // 1 in Montgomery form
+
+  constexpr Prime(Word p, Word root, int order)
+      : p(p), root(root), order(order), inv(p), r2(Word(powMod(2, 64, p))),
+        one(Word(powMod(2, 32, p))) {
+    for (int i = 0; i < 5; ++i) // Newton, as in divExactSmall
+      inv *= 2 - p * inv;
+  }
+
+  // t 2^-32 mod p, for t < p 2^32: t - q p is divisible by 2^32, so only
+  // the high halves need subtracting
+  Word reduce(std::uint64_t t) const {
+    Word q = Word(t) * inv;
+    return fix(Word(t >> 32) - Word((std::uint64_t(q) * p) >> 32));
+  }
+  Word mul(Word a, Word b) const { return reduce(std::uint64_t(a) * b); }
+  Word add(Word a, Word b) const { return std::min(a + b, a + b - p); }
+  Word sub(Word a, Word b) const { return fix(a - b); }
+
+  // r in (-p, p), wrapped, to [0, p). Of r and r + p the wrapped one is the
+  // larger: branch-free, so random residues cost no mispredictions.
+  Word fix(Word r) const { return std::min(r, r + p); }
+
+  Word pow(Word base, std::uint64_t e) const {
+    Word result = one;
+    for (; e; e >>= 1, base = mul(base, base))
+      if (e & 1)
+        result = mul(result, base);
+    return result;
+  }
+};
+
+// Ascending, so a residue mod one prime is a valid residue mod the next
+constexpr Prime PRIMES[3] = {
+    {1811939329, 13, 26}, // 27 2^26 + 1
+    {2013265921, 31, 27}, // 15 2^27 + 1
+    {2113929217, 5, 25},  // 63 2^25 + 1
+};
+constexpr int MAX_ORDER = 25; // the smallest of the three
+
+//-------------------------------------------------------------------------------
+//                                 Transforms
+//-------------------------------------------------------------------------------
+
+// Per-stage roots of unity, Montgomery form: t[h + j] = w^j for the 2h-th
+// root w (or w^-j), so every stage reads its twiddles contiguously. Only
+// the largest stage is multiplied out, in eight independent chains; each
+// smaller one is every other root of the stage above, and w^-j = -w^(h-j).
+std::vector<Word> twiddles(const Prime &P, std::size_t n, bool inverse) {
+  std::vector<Word> t(n);
+  std::size_t top = n / 2;
+  Word w = P.pow(P.mul(P.root, P.r2), (P.p - 1) / n);
+  Word power[8] = {P.one};
+  for (int r = 1; r < 8; ++r)
+    power[r] = P.mul(power[r - 1], w);
+  Word stride = P.mul(power[7], w);
+  for (std::size_t j = 0; j < top; j += 8)
+    for (std::size_t r = 0; r < 8 && j + r < top; ++r) {
+      t[top + j + r] = power[r];
+      power[r] = P.mul(power[r], stride);
+    }
+  for (std::size_t h = top / 2; h > 0; h /= 2)
+    for (std::size_t j = 0; j < h; ++j)
+      t[h + j] = t[2 * h + 2 * j];
+  if (inverse)
+    for (std::size_t h = 1; h < n; h *= 2) {
+      std::reverse(t.begin() + h + 1, t.begin() + 2 * h);
+      for (std::size_t j = h + 1; j < 2 * h; ++j)
+        t[j] = P.p - t[j];
+    }
+  return t;
+}
+
+// Forward transforms are decimation in frequency and leave the result in
+// bit-reversed order; the inverse is decimation in time and takes it back
+// in that order. Products are pointwise, so the order never matters and
+// no permutation is done.
+void forwardStages(const Prime &P, Word *x, std::size_t n, const Word *tw) {
+  for (std::size_t h = n / 2; h > 0; h /= 2)
+    for (std::size_t s = 0; s < n; s += 2 * h)
+      for (std::size_t j = 0; j < h; ++j) {
+        Word u = x[s + j], v = x[s + j + h];
+        x[s + j] = P.add(u, v);
+        x[s + j + h] = P.mul(P.sub(u, v), tw[h + j]);
+      }
+}
+
+void inverseStages(const Prime &P, Word *x, std::size_t n, const Word *tw) {
+  for (std::size_t h = 1; h < n; h *= 2)
+    for (std::size_t s = 0; s < n; s += 2 * h)
+      for (std::size_t j = 0; j < h; ++j) {
+        Word u = x[s + j], v = P.mul(x[s + j + h], tw[h + j]);
+        x[s + j] = P.add(u, v);
+        x[s + j + h] = P.sub(u, v);
+      }
+}
+
+// x[i] = x[i] * y[i] 2^-32, with y = x allowed
+void pointwise(const Prime &P, Word *x, const Word *y, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i)
+    x[i] = P.mul(x[i], y[i]);
+}
+
+// x[i] = x[i] * c 2^-32
+void scaleBy(const Prime &P, Word *x, std::size_t n, Word c) {
+  for (std::size_t i = 0; i < n; ++i)
+    x[i] = P.mul(x[i], c);
+}
+
+#if defined(NTT_AVX2)
+
+// Eight lanes of the scalar Prime operations, min_epu32 doing fix()
+NTT_AVX2 inline __m256i addMod(__m256i a, __m256i b, __m256i p) {
+  __m256i s = _mm256_add_epi32(a, b);
+  return _mm256_min_epu32(s, _mm256_sub_epi32(s, p));
+}
+
+NTT_AVX2 inline __m256i subMod(__m256i a, __m256i b, __m256i p) {
+  __m256i d = _mm256_sub_epi32(a, b);
+  return _mm256_min_epu32(d, _mm256_add_epi32(d, p));
+}
+
+// mul_epu32 takes the even lanes; the odd ones go through a 64-bit shift
+NTT_AVX2 inline __m256i mulMod(__m256i a, __m256i b, __m256i p,
+                               __m256i inv) {
+  __m256i even = _mm256_mul_epu32(a, b);
+  __m256i odd =
+      _mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+  __m256i qEven = _mm256_mul_epu32(_mm256_mul_epu32(even, inv), p);
+  __m256i qOdd = _mm256_mul_epu32(_mm256_mul_epu32(odd, inv), p);
+  __m256i t = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+  __m256i q = _mm256_blend_epi32(_mm256_srli_epi64(qEven, 32), qOdd, 0xAA);
+  __m256i r = _mm256_sub_epi32(t, q);
+  return _mm256_min_epu32(r, _mm256_add_epi32(r, p));
+}
+
+#define NTT_LOAD(ptr) _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr))
+#define NTT_STORE(ptr, v)                                                      \
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(ptr), v)
+
+// Stages with h >= 8 run eight butterflies at a time, straight down the
+// array. In the last three (h = 4, 2, 1) partners sit in the same eight
+// words, so those go sixteen words at a time, two registers A and B
+// regrouped into u and v halves: 128-bit lanes for h = 4, 64-bit pairs for
+// h = 2, even and odd words for h = 1 (whose twiddle is 1).
+NTT_AVX2 inline void regroup4(__m256i &a, __m256i &b) {
+  __m256i u = _mm256_permute2x128_si256(a, b, 0x20);
+  b = _mm256_permute2x128_si256(a, b, 0x31);
+  a = u;
+}
+
+NTT_AVX2 inline void regroup2(__m256i &a, __m256i &b) {
+  __m256i u = _mm256_unpacklo_epi64(a, b);
+  b = _mm256_unpackhi_epi64(a, b);
+  a = u;
+}
+
+NTT_AVX2 inline void split1(__m256i &a, __m256i &b) {
+  __m256 fa = _mm256_castsi256_ps(a), fb = _mm256_castsi256_ps(b);
+  a = _mm256_castps_si256(_mm256_shuffle_ps(fa, fb, 0x88)); // words 0, 2
+  b = _mm256_castps_si256(_mm256_shuffle_ps(fa, fb, 0xDD)); // words 1, 3
+}
+
+NTT_AVX2 inline void join1(__m256i &u, __m256i &v) {
+  __m256i a = _mm256_unpacklo_epi32(u, v);
+  v = _mm256_unpackhi_epi32(u, v);
+  u = a;
+}
+
+NTT_AVX2 void forwardAvx2(const Prime &P, Word *x, std::size_t n,
+                          const Word *tw) {
+  const __m256i p = _mm256_set1_epi32(int(P.p));
+  const __m256i inv = _mm256_set1_epi32(int(P.inv));
+  if (n < 16)
+    return forwardStages(P, x, n, tw);
+  for (std::size_t h = n / 2; h >= 8; h /= 2)
+    for (std::size_t s = 0; s < n; s += 2 * h)
+      for (std::size_t j = s; j < s + h; j += 8) {
+        __m256i u = NTT_LOAD(x + j), v = NTT_LOAD(x + j + h);
+        NTT_STORE(x + j, addMod(u, v, p));
+        NTT_STORE(x + j + h,
+                  mulMod(subMod(u, v, p), NTT_LOAD(tw + h + j - s), p, inv));
+      }
+
+  const __m256i w4 = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(tw + 4)));
+  const __m256i w2 =
+      _mm256_set1_epi64x(std::int64_t(std::uint64_t(tw[3]) << 32 | tw[2]));
+  for (std::size_t s = 0; s < n; s += 16) {
+    __m256i a = NTT_LOAD(x + s), b = NTT_LOAD(x + s + 8), u;
+    regroup4(a, b);
+    u = addMod(a, b, p);
+    b = mulMod(subMod(a, b, p), w4, p, inv);
+    a = u;
+    regroup4(a, b);
+    regroup2(a, b);
+    u = addMod(a, b, p);
+    b = mulMod(subMod(a, b, p), w2, p, inv);
+    a = u;
+    regroup2(a, b);
+    split1(a, b);
+    u = addMod(a, b, p);
+    b = subMod(a, b, p);
+    join1(u, b);
+    NTT_STORE(x + s, u);
+    NTT_STORE(x + s + 8, b);
+  }
+}
+
+NTT_AVX2 void inverseAvx2(const Prime &P, Word *x, std::size_t n,
+                          const Word *tw) {
+  const __m256i p = _mm256_set1_epi32(int(P.p));
+  const __m256i inv = _mm256_set1_epi32(int(P.inv));
+  if (n < 16)
+    return inverseStages(P, x, n, tw);
+
+  const __m256i w4 = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(tw + 4)));
+  const __m256i w2 =
+      _mm256_set1_epi64x(std::int64_t(std::uint64_t(tw[3]) << 32 | tw[2]));
+  for (std::size_t s = 0; s < n; s += 16) {
+    __m256i a = NTT_LOAD(x + s), b = NTT_LOAD(x + s + 8), u;
+    split1(a, b);
+    u = addMod(a, b, p);
+    b = subMod(a, b, p);
+    join1(u, b);
+    a = u;
+    regroup2(a, b);
+    b = mulMod(b, w2, p, inv);
+    u = addMod(a, b, p);
+    b = subMod(a, b, p);
+    a = u;
+    regroup2(a, b);
+    regroup4(a, b);
+    b = mulMod(b, w4, p, inv);
+    u = addMod(a, b, p);
+    b = subMod(a, b, p);
+    a = u;
+    regroup4(a, b);
+    NTT_STORE(x + s, a);
+    NTT_STORE(x + s + 8, b);
+  }
+  for (std::size_t h = 8; h < n; h *= 2)
+    for (std::size_t s = 0; s < n; s += 2 * h)
+      for (std::size_t j = s; j < s + h; j += 8) {
+        __m256i u = NTT_LOAD(x + j);
+        __m256i v = mulMod(NTT_LOAD(x + j + h), NTT_LOAD(tw + h + j - s), p,
+                           inv);
+        NTT_STORE(x + j, addMod(u, v, p));
+        NTT_STORE(x + j + h, subMod(u, v, p));
+      }
+}
+
+NTT_AVX2 void pointwiseAvx2(const Prime &P, Word *x, const Word *y,
+                            std::size_t n) {
+  const __m256i p = _mm256_set1_epi32(int(P.p));
+  const __m256i inv = _mm256_set1_epi32(int(P.inv));
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    NTT_STORE(x + i, mulMod(NTT_LOAD(x + i), NTT_LOAD(y + i), p, inv));
+  pointwise(P, x + i, y + i, n - i);
+}
+
+NTT_AVX2 void scaleAvx2(const Prime &P, Word *x, std::size_t n, Word c) {
+  const __m256i p = _mm256_set1_epi32(int(P.p));
+  const __m256i inv = _mm256_set1_epi32(int(P.inv));
+  const __m256i by = _mm256_set1_epi32(int(c));
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    NTT_STORE(x + i, mulMod(NTT_LOAD(x + i), by, p, inv));
+  scaleBy(P, x + i, n - i, c);
+}
+
+#undef NTT_LOAD
+#undef NTT_STORE
+
+bool haveAvx2() {
+  static const bool yes = __builtin_cpu_supports("avx2");
+  return yes;
+}
+
+#endif
+
+void forward(const Prime &P, Word *x, std::size_t n, const Word *tw) {
+#if defined(NTT_AVX2)
+  if (haveAvx2())
+    return forwardAvx2(P, x, n, tw);
+#endif
+  forwardStages(P, x, n, tw);
+}
+
+void inverse(const Prime &P, Word *x, std::size_t n, const Word *tw) {
+#if defined(NTT_AVX2)
+  if (haveAvx2())
+    return inverseAvx2(P, x, n, tw);
+#endif
+  inverseStages(P, x, n, tw);
+}
+
+void scale(const Prime &P, Word *x, std::size_t n, Word c) {
+#if defined(NTT_AVX2)
+  if (haveAvx2())
+    return scaleAvx2(P, x, n, c);
+#endif
+  scaleBy(P, x, n, c);
+}
+
+void multiplyPointwise(const Prime &P, Word *x, const Word *y,
+                       std::size_t n) {
+#if defined(NTT_AVX2)
+  if (haveAvx2())
+    return pointwiseAvx2(P, x, y, n);
+#endif
+  pointwise(P, x, y, n);
+}
+
+//-------------------------------------------------------------------------------
+//                                Convolution
+//-------------------------------------------------------------------------------
+
+// 32-bit pieces of a, in Montgomery form, zero-padded to n
+std::vector<Word> load(const Prime &P, const Limb *a, int na, std::size_t n) {
+  std::vector<Word> x(n);
+  std::size_t pieces = std::min(n, 2 * std::size_t(na));
+  for (std::size_t i = 0; i < pieces; ++i)
+    x[i] = Word(a[i / 2] >> (i % 2 * 32));
+  scale(P, x.data(), pieces, P.r2);
+  return x;
+}
+
+// The product's coefficients modulo P, plain and in natural order. Twiddle
+// tables are built as needed so at most three n-word arrays are live.
+std::vector<Word> residues(const Prime &P, const Limb *a, int na,
+                           const Limb *b, int nb, std::size_t n) {
+  std::vector<Word> x = load(P, a, na, n);
+  {
+    std::vector<Word> tw = twiddles(P, n, false);
+    forward(P, x.data(), n, tw.data());
+    if (a == b && na == nb) { // squaring: one transform
+      multiplyPointwise(P, x.data(), x.data(), n);
+    } else {
+      std::vector<Word> y = load(P, b, nb, n);
+      forward(P, y.data(), n, tw.data());
+      multiplyPointwise(P, x.data(), y.data(), n);
+    }
+  }
+  std::vector<Word> tw = twiddles(P, n, true);
+  inverse(P, x.data(), n, tw.data());
+  scale(P, x.data(), n, Word(P.p - (P.p - 1) / n)); // 1/n, and out of form
+  return x;
+}
+
+// Garner's CRT, coefficient by coefficient, with the carry running into
+// the next 32-bit piece of out
+void reconstruct(Limb *out, int nout, const std::vector<Word> *r,
+                 std::size_t coeffs) {
+  const Prime &P1 = PRIMES[0], &P2 = PRIMES[1], &P3 = PRIMES[2];
+  const std::uint64_t p12 = std::uint64_t(P1.p) * P2.p;
+  // constants pre-multiplied by 2^32 (2^64) to cancel Montgomery's 2^-32
+  const Word c2 = Word((Wide(powMod(P1.p, P2.p - 2, P2.p)) << 32) % P2.p);
+  const std::uint64_t c3 = powMod(p12 % P3.p, P3.p - 2, P3.p);
+  const Word c3r = Word((Wide(c3) << 32) % P3.p);
+  const Word c3r2 = Word((Wide(c3) << 64) % P3.p);
+
+  Wide carry = 0;
+  for (std::size_t i = 0; i < 2 * std::size_t(nout); ++i) {
+    if (i < coeffs) {
+      Word r1 = r[0][i], r2 = r[1][i], r3 = r[2][i];
+      Word k2 = P2.mul(P2.sub(r2, r1), c2);
+      std::uint64_t x12 = r1 + std::uint64_t(P1.p) * k2;
+      Word k3 = P3.sub(P3.mul(r3, c3r), P3.mul(P3.reduce(x12), c3r2));
+      carry += x12 + Wide(p12) * k3;
+    }
+    Limb piece = Limb(carry) & 0xffffffffu;
+    carry >>= 32;
+    if (i % 2 == 0)
+      out[i / 2] = piece;
+    else
+      out[i / 2] |= piece << 32;
+  }
+}
+
+// Below this many points one thread does all three primes
+constexpr std::size_t PARALLEL_POINTS = std::size_t(1) << 16;
+
+} // namespace
+
+void multiplyNtt(Limb *out, const Limb *a, int na, const Limb *b, int nb) {
+  // pieces without the zero top halves, then the product's coefficients
+  std::size_t ca = 2 * std::size_t(na) - (a[na - 1] >> 32 == 0);
+  std::size_t cb = 2 * std::size_t(nb) - (b[nb - 1] >> 32 == 0);
+  std::size_t coeffs = ca + cb - 1, n = 1;
+  while (n < coeffs)
+    n *= 2;
+
+  std::vector<Word> r[3];
+  if (n >= PARALLEL_POINTS && std::thread::hardware_concurrency() > 1) {
+    auto residuesAt = [&](int i) {
+      return std::async(std::launch::async, [&, i] {
+        return residues(PRIMES[i], a, na, b, nb, n);
+      });
+    };
+    auto second = residuesAt(1), third = residuesAt(2);
+    r[0] = residues(PRIMES[0], a, na, b, nb, n);
+    r[1] = second.get();
+    r[2] = third.get();
+  } else {
+    for (int i = 0; i < 3; ++i)
+      r[i] = residues(PRIMES[i], a, na, b, nb, n);
+  }
+  reconstruct(out, na + nb, r, coeffs);
+}
+
+static_assert(NTT_MAX_LIMBS <= std::size_t(1) << (MAX_ORDER - 1));
+
+} // namespace LIMBS
@@ -0,0 +1,334 @@
+/*
+ * Load generator for kv_server.
+ *
+ * usage: kv_load [--socket PATH] [--conns N] [--depth D] [--rate R]
+ *                [--seconds S] [--keys K] [--get-pct P]
+ *
+ * Each connection runs on its own thread.
+ *   closed loop (--rate 0): keep D requests in flight per connection and
+ *     send a replacement for every response; measures capacity. D is
+ *     capped at RING.
+ *   open loop (--rate R): R requests/s in total on a fixed schedule, sent
+ *     whether or not earlier ones were answered. Latency is measured from
+ *     the scheduled send time, so a stalled server is charged for the
+ *     requests queued behind the stall (no coordinated omission).
+ *
+ * Keys are uniform in [0, 2K); with `kv_server --prefill K` half of them
+ * hit. Operations are P% GET, the rest split between PUT and DEL, plus a
+ * GET-sized share of SUCCESSOR when P < 100.
+ */
+
+#include "protocol.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <poll.h>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Requests in flight per connection: send times are kept by id % RING, and
+// RING responses (1 MiB) stay well under what kv_server queues for a
+// client before it stops reading from it
+constexpr std::size_t RING = 1 << 16;
+
+struct Config {
+  std::string path = KVPROTO::DEFAULT_SOCKET;
+  int conns = 4;
+  int depth = 32;
+  double rate = 0; // total requests per second; 0 selects closed loop
+  double seconds = 5;
+  long keys = 1 << 20;
+  int getPct = 90;
+};
+
+struct Result {
+  std::vector<std::uint32_t> latencyNs; // saturates at ~4.3 s
+  std::uint64_t sent{0};
+  std::uint64_t received{0};
+  std::uint64_t found{0};
+  std::uint64_t errors{0};
+  bool ok{true};
+};
+
+int connectTo(const std::string &path) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (fd < 0 || path.size() >= sizeof(addr.sun_path))
+    return -1;
+  std::strcpy(addr.sun_path, path.c_str());
+  if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+bool writeAll(int fd, const void *data, std::size_t len) {
+  auto *p = static_cast<const char *>(data);
+  while (len > 0) {
+    ssize_t n = write(fd, p, len);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    len -= std::size_t(n);
+  }
+  return true;
+}
+
+class Client {
+public:
+  Client(const Config &cfg, unsigned seed, Result &res)
+      : cfg(cfg), res(res), rng(seed), keyDist(0, 2 * cfg.keys - 1),
+        opDist(0, 99), sendTime(RING) {}
+
+  void run() {
+    fd = connectTo(cfg.path);
+    if (fd < 0) {
+      res.ok = false;
+      return;
+    }
+    if (cfg.rate > 0)
+      openLoop();
+    else
+      closedLoop();
+    close(fd);
+  }
+
+private:
+  const Config &cfg;
+  Result &res;
+  std::mt19937_64 rng;
+  std::uniform_int_distribution<long> keyDist;
+  std::uniform_int_distribution<int> opDist;
+  std::vector<Clock::time_point> sendTime; // by id % RING
+  std::vector<KVPROTO::Request> outBatch;
+  std::vector<char> in = std::vector<char>(64 * 1024);
+  std::size_t inUsed{0};
+  std::uint32_t nextId{0};
+  int fd{-1};
+
+  std::uint64_t inFlight() const { return res.sent - res.received; }
+
+  void queue(Clock::time_point when) {
+    KVPROTO::Request req{};
+    req.id = nextId++;
+    int roll = opDist(rng);
+    int rest = (100 - cfg.getPct) / 3;
+    req.op = roll < cfg.getPct                 ? KVPROTO::GET
+             : roll < cfg.getPct + rest        ? KVPROTO::SUCCESSOR
+             : roll < cfg.getPct + 2 * rest    ? KVPROTO::PUT
+                                               : KVPROTO::DEL;
+    req.key = keyDist(rng);
+    sendTime[req.id % RING] = when;
+    outBatch.push_back(req);
+  }
+
+  bool sendQueued() {
+    if (outBatch.empty())
+      return true;
+    bool ok = writeAll(fd, outBatch.data(),
+                       outBatch.size() * sizeof(KVPROTO::Request));
+    res.sent += outBatch.size();
+    outBatch.clear();
+    return ok;
+  }
+
+  // Read what is available and account for every whole response;
+  // returns the number of responses, or -1 on a closed socket
+  long receive() {
+    ssize_t got = read(fd, in.data() + inUsed, in.size() - inUsed);
+    if (got < 0 && errno == EINTR)
+      return 0;
+    if (got <= 0)
+      return -1;
+    inUsed += std::size_t(got);
+    Clock::time_point now = Clock::now();
+
+    std::size_t frames = inUsed / sizeof(KVPROTO::Response);
+    for (std::size_t i = 0; i < frames; ++i) {
+      KVPROTO::Response r;
+      std::memcpy(&r, in.data() + i * sizeof(r), sizeof(r));
+      auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    now - sendTime[r.id % RING])
+                    .count();
+      res.latencyNs.push_back(std::uint32_t(
+          std::min<long long>(ns, std::numeric_limits<std::uint32_t>::max())));
+      res.found += r.status == KVPROTO::FOUND;
+      res.errors += r.status == KVPROTO::BAD_REQUEST;
+    }
+    std::size_t used = frames * sizeof(KVPROTO::Response);
+    std::memmove(in.data(), in.data() + used, inUsed - used);
+    inUsed -= used;
+    res.received += frames;
+    return long(frames);
+  }
+
+  void closedLoop() {
+    Clock::time_point end =
+        Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                           std::chrono::duration<double>(cfg.seconds));
+    for (int i = 0; i < cfg.depth; ++i)
+      queue(Clock::now());
+    if (!sendQueued())
+      return;
+
+    while (inFlight() > 0) {
+      long done = receive();
+      if (done < 0) {
+        res.ok = false;
+        return;
+      }
+      if (Clock::now() < end) {
+        Clock::time_point now = Clock::now();
+        for (long i = 0; i < done; ++i)
+          queue(now);
+        if (!sendQueued())
+          return;
+      }
+    }
+  }
+
+  void openLoop() {
+    double perConn = cfg.rate / cfg.conns;
+    auto interval = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / perConn));
+    Clock::time_point start = Clock::now();
+    Clock::time_point end =
+        start + std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(cfg.seconds));
+    Clock::time_point due = start;
+
+    for (;;) {
+      Clock::time_point now = Clock::now();
+      // everything whose scheduled time has passed goes out in one write
+      while (due <= now && due < end && inFlight() + outBatch.size() < RING) {
+        queue(due);
+        due += interval;
+      }
+      if (!sendQueued()) {
+        res.ok = false;
+        return;
+      }
+      if (due >= end && inFlight() == 0)
+        return;
+
+      // sleep until the next scheduled send or a response, not a spin
+      Clock::duration wait = std::chrono::seconds(1); // draining
+      if (due < end)
+        wait = std::max(Clock::duration::zero(), due - now);
+      auto ns =
+          std::chrono::duration_cast<std::chrono::nanoseconds>(wait).count();
+      timespec timeout{time_t(ns / 1000000000), long(ns % 1000000000)};
+      pollfd p{fd, POLLIN, 0};
+      int ready = ppoll(&p, 1, &timeout, nullptr);
+      if (ready > 0 && receive() < 0) {
+        res.ok = false;
+        return;
+      }
+      if (ready == 0 && due >= end) { // server stopped answering
+        res.ok = false;
+        return;
+      }
+    }
+  }
+};
+
+double percentile(const std::vector<std::uint32_t> &sorted, double p) {
+  if (sorted.empty())
+    return 0;
+  std::size_t i = std::size_t(p / 100.0 * double(sorted.size() - 1) + 0.5);
+  return sorted[i] / 1000.0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Config cfg;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string flag = argv[i];
+    const char *value = argv[i + 1];
+    if (flag == "--socket")
+      cfg.path = value;
+    else if (flag == "--conns")
+      cfg.conns = std::max(1, std::atoi(value));
+    else if (flag == "--depth")
+      cfg.depth = std::clamp(std::atoi(value), 1, int(RING));
+    else if (flag == "--rate")
+      cfg.rate = std::atof(value);
+    else if (flag == "--seconds")
+      cfg.seconds = std::atof(value);
+    else if (flag == "--keys")
+      cfg.keys = std::max(1L, std::atol(value));
+    else if (flag == "--get-pct")
+      cfg.getPct = std::clamp(std::atoi(value), 0, 100);
+    else {
+      std::fprintf(stderr, "unknown flag %s\n", flag.c_str());
+      return 2;
+    }
+  }
+
+  std::vector<Result> results(cfg.conns);
+  std::vector<std::thread> threads;
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < cfg.conns; ++i)
+    threads.emplace_back([&cfg, &results, i] {
+      Client client(cfg, 0x5eed + unsigned(i), results[i]);
+      client.run();
+    });
+  for (std::thread &t : threads)
+    t.join();
+  double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+  Result total;
+  for (Result &r : results) {
+    total.latencyNs.insert(total.latencyNs.end(), r.latencyNs.begin(),
+                           r.latencyNs.end());
+    total.sent += r.sent;
+    total.received += r.received;
+    total.found += r.found;
+    total.errors += r.errors;
+    total.ok = total.ok && r.ok;
+  }
+  std::sort(total.latencyNs.begin(), total.latencyNs.end());
+
+  std::printf("%s loop, %d conns, %s %g\n", cfg.rate > 0 ? "open" : "closed",
+              cfg.conns, cfg.rate > 0 ? "target rate" : "depth",
+              cfg.rate > 0 ? cfg.rate : double(cfg.depth));
+  std::printf("requests: %llu sent, %llu answered, %llu found, %llu bad\n",
+              (unsigned long long)total.sent,
+              (unsigned long long)total.received,
+              (unsigned long long)total.found,
+              (unsigned long long)total.errors);
+  std::printf("throughput: %.0f req/s over %.2f s\n",
+              double(total.received) / elapsed, elapsed);
+  std::printf("latency us: p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  "
+              "max %.1f\n",
+              percentile(total.latencyNs, 50), percentile(total.latencyNs, 90),
+              percentile(total.latencyNs, 99),
+              percentile(total.latencyNs, 99.9),
+              percentile(total.latencyNs, 100));
+  if (!total.ok) {
+    std::fprintf(stderr, "some connections failed or were cut short\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,413 @@
+/*
+ * Tree-backed key server over a Unix domain socket.
+ *
+ * usage: kv_server [--socket PATH] [--threads N] [--tree avl|rb]
+ *                  [--prefill N]
+ *
+ * One acceptor hands connections round-robin to N worker threads, each
+ * running its own edge-triggered epoll loop. A worker drains everything a
+ * client has pipelined, answers the whole batch under a single lock
+ * acquisition (shared for read-only batches, exclusive otherwise) and sends
+ * all responses with one write. See protocol.hpp for the frame layout.
+ *
+ * A client that sends faster than it reads its responses is throttled:
+ * once OUT_HIGH_WATER bytes of responses are queued for it, its socket is
+ * left unread (so its own sends block) until the queue drains to half that.
+ *
+ * The trees are sets, so the "map" is key -> presence; SUCCESSOR gives
+ * ordered access. Stops on SIGINT/SIGTERM and prints per-worker counts.
+ */
+
+#include "generator.hpp"
+#include "protocol.hpp"
+#include "rbtree.h"
+#include "tree.hpp"
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <poll.h>
+#include <shared_mutex>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+std::atomic<bool> stopping{false};
+
+// Queued response bytes that stop reads from a connection, and the most
+// request bytes one pass reads before answering them
+constexpr std::size_t OUT_HIGH_WATER = std::size_t(4) << 20;
+constexpr std::size_t IN_BATCH = std::size_t(1) << 20;
+
+void onSignal(int) { stopping.store(true); }
+
+bool setNonBlocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+struct Connection {
+  int fd;
+  std::vector<char> in;
+  std::size_t inUsed{0};
+  std::vector<char> out;
+  std::size_t outSent{0};
+  bool waitingForWrite{false};
+  bool throttled{false}; // left unread until `out` drains
+
+  std::size_t pending() const { return out.size() - outSent; }
+};
+
+template <typename Tree> class Server {
+public:
+  Server(std::string path, unsigned threads)
+      : path(std::move(path)), workers(threads) {}
+
+  void prefill(long n) {
+    for (long k = 0; k < n; ++k)
+      tree.insert(int(k * 2)); // even keys present, odd ones missing
+  }
+
+  int run();
+
+private:
+  struct Worker {
+    int epfd{-1};
+    std::thread thread;
+    std::uint64_t requests{0};
+    std::uint64_t batches{0};
+    std::mutex connMutex; // the acceptor adds, the worker removes
+    std::unordered_set<Connection *> conns;
+  };
+
+  std::string path;
+  std::vector<Worker> workers;
+  std::shared_mutex treeLock;
+  Tree tree;
+
+  void serve(Worker &w);
+  void drop(Worker &w, Connection *c);
+  bool onReadable(Worker &w, Connection &c);
+  bool flush(Worker &w, Connection &c);
+  void answer(Worker &w, const KVPROTO::Request *req, std::size_t n,
+              KVPROTO::Response *resp);
+  KVPROTO::Response apply(const KVPROTO::Request &req);
+};
+
+template <typename Tree> int Server<Tree>::run() {
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (listener < 0 || path.size() >= sizeof(addr.sun_path)) {
+    std::perror("socket");
+    return 1;
+  }
+  std::strcpy(addr.sun_path, path.c_str());
+  unlink(path.c_str());
+  if (bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+      listen(listener, 1024) != 0) {
+    std::perror("bind/listen");
+    return 1;
+  }
+
+  for (Worker &w : workers) {
+    w.epfd = epoll_create1(0);
+    w.thread = std::thread(&Server::serve, this, std::ref(w));
+  }
+  std::printf("listening on %s with %zu workers\n", path.c_str(),
+              workers.size());
+  std::fflush(stdout);
+
+  std::size_t next = 0;
+  while (!stopping.load()) {
+    pollfd p{listener, POLLIN, 0};
+    if (poll(&p, 1, 200) <= 0)
+      continue;
+    int fd = accept(listener, nullptr, nullptr);
+    if (fd < 0 || !setNonBlocking(fd)) {
+      if (fd >= 0)
+        close(fd);
+      continue;
+    }
+    int buf = 1 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buf, sizeof(buf));
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buf, sizeof(buf));
+
+    auto *c = new Connection{fd, std::vector<char>(64 * 1024), 0, {}, 0,
+                             false};
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = c;
+    Worker &w = workers[next++ % workers.size()];
+    std::lock_guard<std::mutex> lock(w.connMutex);
+    if (epoll_ctl(w.epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+      close(fd);
+      delete c;
+    } else {
+      w.conns.insert(c);
+    }
+  }
+
+  for (Worker &w : workers) {
+    w.thread.join();
+    for (Connection *c : w.conns) { // clients still connected at shutdown
+      close(c->fd);
+      delete c;
+    }
+    w.conns.clear();
+  }
+  close(listener);
+  unlink(path.c_str());
+
+  std::uint64_t total = 0;
+  for (std::size_t i = 0; i < workers.size(); ++i) {
+    std::printf("worker %zu: %llu requests in %llu batches\n", i,
+                (unsigned long long)workers[i].requests,
+                (unsigned long long)workers[i].batches);
+    total += workers[i].requests;
+  }
+  std::printf("total: %llu requests\n", (unsigned long long)total);
+  return 0;
+}
+
+template <typename Tree> void Server<Tree>::serve(Worker &w) {
+  epoll_event events[256];
+  while (!stopping.load()) {
+    int n = epoll_wait(w.epfd, events, 256, 200);
+    for (int i = 0; i < n; ++i) {
+      auto *c = static_cast<Connection *>(events[i].data.ptr);
+      bool alive = true;
+      if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+        alive = onReadable(w, *c);
+      if (alive && (events[i].events & EPOLLOUT)) {
+        alive = flush(w, *c);
+        // edge triggered: unread input raises no new event, so go get it
+        if (alive && c->throttled && c->pending() <= OUT_HIGH_WATER / 2)
+          alive = onReadable(w, *c);
+      }
+      if (!alive)
+        drop(w, c);
+    }
+  }
+  close(w.epfd);
+}
+
+template <typename Tree> void Server<Tree>::drop(Worker &w, Connection *c) {
+  {
+    std::lock_guard<std::mutex> lock(w.connMutex);
+    w.conns.erase(c);
+  }
+  close(c->fd); // also drops it from the epoll set
+  delete c;
+}
+
+// Drain the socket, answer every complete frame, keep a partial tail. Reads
+// stop early while too many responses wait for the client
+template <typename Tree>
+bool Server<Tree>::onReadable(Worker &w, Connection &c) {
+  for (;;) {
+    c.throttled = c.pending() >= OUT_HIGH_WATER;
+    if (c.throttled)
+      return true;
+
+    bool drained = false, eof = false;
+    while (c.inUsed < IN_BATCH) {
+      if (c.inUsed == c.in.size())
+        c.in.resize(c.in.size() * 2);
+      ssize_t got =
+          read(c.fd, c.in.data() + c.inUsed, c.in.size() - c.inUsed);
+      if (got > 0) {
+        c.inUsed += std::size_t(got);
+        continue;
+      }
+      if (got == 0)
+        eof = true;
+      else if (errno == EINTR)
+        continue;
+      else if (errno != EAGAIN && errno != EWOULDBLOCK)
+        return false;
+      drained = true;
+      break;
+    }
+
+    std::size_t frames = c.inUsed / sizeof(KVPROTO::Request);
+    if (frames > 0) {
+      if (c.outSent > 0) { // keep only what is still unsent
+        c.out.erase(c.out.begin(), c.out.begin() + c.outSent);
+        c.outSent = 0;
+      }
+      std::size_t base = c.out.size();
+      c.out.resize(base + frames * sizeof(KVPROTO::Response));
+      std::vector<KVPROTO::Request> batch(frames);
+      std::memcpy(batch.data(), c.in.data(),
+                  frames * sizeof(KVPROTO::Request));
+      std::vector<KVPROTO::Response> replies(frames);
+      answer(w, batch.data(), frames, replies.data());
+      std::memcpy(c.out.data() + base, replies.data(),
+                  frames * sizeof(KVPROTO::Response));
+
+      std::size_t used = frames * sizeof(KVPROTO::Request);
+      std::memmove(c.in.data(), c.in.data() + used, c.inUsed - used);
+      c.inUsed -= used;
+    }
+
+    if (!flush(w, c))
+      return false;
+    if (eof)
+      return c.pending() > 0;
+    if (drained)
+      return true;
+  }
+}
+
+template <typename Tree> bool Server<Tree>::flush(Worker &w, Connection &c) {
+  while (c.outSent < c.out.size()) {
+    ssize_t sent =
+        write(c.fd, c.out.data() + c.outSent, c.out.size() - c.outSent);
+    if (sent > 0) {
+      c.outSent += std::size_t(sent);
+      continue;
+    }
+    if (sent < 0 && errno == EINTR)
+      continue;
+    if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      break;
+    return false;
+  }
+
+  bool pendingOut = c.outSent < c.out.size();
+  if (!pendingOut) {
+    c.out.clear();
+    c.outSent = 0;
+  }
+  if (pendingOut != c.waitingForWrite) { // only touch epoll on a change
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    if (pendingOut)
+      ev.events |= EPOLLOUT;
+    ev.data.ptr = &c;
+    epoll_ctl(w.epfd, EPOLL_CTL_MOD, c.fd, &ev);
+    c.waitingForWrite = pendingOut;
+  }
+  return true;
+}
+
+template <typename Tree>
+void Server<Tree>::answer(Worker &w, const KVPROTO::Request *req,
+                          std::size_t n, KVPROTO::Response *resp) {
+  bool writes = false;
+  for (std::size_t i = 0; i < n && !writes; ++i)
+    writes = req[i].op == KVPROTO::PUT || req[i].op == KVPROTO::DEL;
+
+  if (writes) {
+    std::unique_lock<std::shared_mutex> lock(treeLock);
+    for (std::size_t i = 0; i < n; ++i)
+      resp[i] = apply(req[i]);
+  } else {
+    std::shared_lock<std::shared_mutex> lock(treeLock);
+    for (std::size_t i = 0; i < n; ++i)
+      resp[i] = apply(req[i]);
+  }
+  w.requests += n;
+  ++w.batches;
+}
+
+template <typename Tree>
+KVPROTO::Response Server<Tree>::apply(const KVPROTO::Request &req) {
+  KVPROTO::Response r{};
+  r.id = req.id;
+  r.value = req.key;
+  if (req.key < std::numeric_limits<int>::min() ||
+      req.key > std::numeric_limits<int>::max()) { // the trees key on int
+    r.status = KVPROTO::BAD_REQUEST;
+    return r;
+  }
+  int key = int(req.key);
+
+  switch (req.op) {
+  case KVPROTO::GET:
+    r.status = tree.search(key) ? KVPROTO::FOUND : KVPROTO::MISSING;
+    break;
+  case KVPROTO::PUT:
+    if (tree.search(key)) {
+      r.status = KVPROTO::EXISTS;
+    } else {
+      tree.insert(key);
+      r.status = KVPROTO::OK;
+    }
+    break;
+  case KVPROTO::DEL:
+    if (tree.search(key)) {
+      tree.remove(key);
+      r.status = KVPROTO::OK;
+    } else {
+      r.status = KVPROTO::MISSING;
+    }
+    break;
+  case KVPROTO::SUCCESSOR: {
+    auto *node = TRAVERSE::lowerBound(tree.getRoot(), key);
+    if (node && node->key == key)
+      node = TRAVERSE::next(node);
+    r.status = node ? KVPROTO::FOUND : KVPROTO::MISSING;
+    if (node)
+      r.value = node->key;
+    break;
+  }
+  default:
+    r.status = KVPROTO::BAD_REQUEST;
+  }
+  return r;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::string path = KVPROTO::DEFAULT_SOCKET;
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency() / 2);
+  std::string kind = "rb";
+  long prefill = 0;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string flag = argv[i];
+    if (flag == "--socket")
+      path = argv[i + 1];
+    else if (flag == "--threads")
+      threads = unsigned(std::max(1, std::atoi(argv[i + 1])));
+    else if (flag == "--tree")
+      kind = argv[i + 1];
+    else if (flag == "--prefill")
+      prefill = std::atol(argv[i + 1]);
+    else {
+      std::fprintf(stderr, "unknown flag %s\n", flag.c_str());
+      return 2;
+    }
+  }
+
+  std::signal(SIGINT, onSignal);
+  std::signal(SIGTERM, onSignal);
+  std::signal(SIGPIPE, SIG_IGN);
+
+  if (kind == "avl") {
+    auto server = std::make_unique<Server<TREE::AVLTree<int>>>(path, threads);
+    server->prefill(prefill);
+    return server->run();
+  }
+  auto server =
+      std::make_unique<Server<RBTREE::RedBlackTree<int>>>(path, threads);
+  server->prefill(prefill);
+  return server->run();
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+
+namespace KVPROTO {
+
+//-------------------------------------------------------------------------------
+//                                Wire Protocol
+//-------------------------------------------------------------------------------
+
+// Fixed 16-byte frames in host byte order (client and server share the
+// machine). A client may pipeline any number of requests; the server
+// answers each with one Response carrying the same id, in order per
+// connection. Fixed frames let the server cut a read buffer into a batch
+// without parsing.
+
+enum Op : std::uint8_t {
+  GET = 1,       // status FOUND / MISSING
+  PUT = 2,       // status OK (inserted) / EXISTS
+  DEL = 3,       // status OK (removed) / MISSING
+  SUCCESSOR = 4, // status FOUND with value = smallest key > key, or MISSING
+};
+
+enum Status : std::uint8_t {
+  OK = 0,
+  FOUND = 1,
+  MISSING = 2,
+  EXISTS = 3,
+  BAD_REQUEST = 4,
+};
+
+struct Request {
+  std::uint32_t id;
+  std::uint8_t op;
+  std::uint8_t pad[3];
+  std::int64_t key;
+};
+
+struct Response {
+  std::uint32_t id;
+  std::uint8_t status;
+  std::uint8_t pad[3];
+  std::int64_t value;
+};
+
+static_assert(sizeof(Request) == 16 && sizeof(Response) == 16);
+
+constexpr const char *DEFAULT_SOCKET = "/tmp/tree-kv.sock";
+
+} // namespace KVPROTO
@@ -0,0 +1,202 @@
+/*
+ * BigInt arithmetic.
+ *
+ * Addition, subtraction and comparison against the built-in integers and
+ * through identities on long decimal strings. Every multiplication
+ * algorithm is checked against schoolbook by forcing it with tiny
+ * crossovers, and every division algorithm by recombining q * b + r == a
+ * with r < b. Operands mix random limbs with the carry stressing shapes
+ * (all ones, sparse, a top limb of 1) that random data almost never
+ * produces. Then the decimal boundary, the sign rules and the inline
+ * storage.
+ */
+
+#include "bignum.hpp"
+#include "check.hpp"
+#include "limbs.hpp"
+#include <climits>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using LIMBS::Limb;
+
+std::mt19937_64 rng(7);
+
+std::vector<Limb> operand(int n) {
+  std::vector<Limb> x(n);
+  int shape = int(rng() % 4);
+  for (auto &limb : x) {
+    switch (shape) {
+    case 0:
+      limb = rng();
+      break;
+    case 1:
+      limb = ~0ull;
+      break;
+    case 2:
+      limb = rng() % 3 == 0 ? ~0ull : (rng() % 2 ? 0 : rng());
+      break;
+    default:
+      limb = rng() & 0xffff000000000000ull;
+    }
+  }
+  if (rng() % 4 == 0)
+    x[n - 1] = 1;
+  if (x[n - 1] == 0)
+    x[n - 1] = 1;
+  return x;
+}
+
+void multiplication() {
+  const LIMBS::MulThresholds schoolbook{INT_MAX, INT_MAX, INT_MAX};
+  const LIMBS::MulThresholds forced[] = {
+      {},                    // the tuned defaults
+      {2, INT_MAX, INT_MAX}, // Karatsuba all the way down
+      {2, 6, INT_MAX},       // Toom-3
+      {4, 9, 40},            // all three, NTT on top
+      {INT_MAX, INT_MAX, 1}, // NTT only
+  };
+  for (int iter = 0; iter < 600; ++iter) {
+    int na = 1 + int(rng() % (iter < 500 ? 200 : 2000));
+    int nb = 1 + int(rng() % na);
+    std::vector<Limb> a = operand(na), b = operand(nb);
+    std::vector<Limb> want(na + nb), got(na + nb);
+    LIMBS::multiply(want.data(), a.data(), na, b.data(), nb, schoolbook);
+    for (const auto &at : forced) {
+      LIMBS::multiply(got.data(), a.data(), na, b.data(), nb, at);
+      CHECK(got == want);
+    }
+    LIMBS::multiplyNtt(got.data(), a.data(), na, b.data(), nb);
+    CHECK(got == want);
+  }
+
+  // long enough for the NTT to run its three primes on separate threads
+  LIMBS::MulThresholds toom;
+  toom.ntt = INT_MAX;
+  std::vector<Limb> a = operand(20000), b = operand(12000);
+  std::vector<Limb> want(32000), got(32000);
+  LIMBS::multiply(want.data(), a.data(), 20000, b.data(), 12000, toom);
+  LIMBS::multiplyNtt(got.data(), a.data(), 20000, b.data(), 12000);
+  CHECK(got == want);
+}
+
+void division() {
+  const LIMBS::DivThresholds forced[] = {
+      {},                 // the tuned defaults
+      {INT_MAX, INT_MAX}, // schoolbook only
+      {4, INT_MAX},       // Burnikel-Ziegler
+      {4, 4},             // Newton
+      {6, 20},
+  };
+  for (int iter = 0; iter < 1500; ++iter) {
+    int nb = 1 + int(rng() % 300);
+    int na = nb + int(rng() % (rng() % 4 == 0 ? 900 : 8));
+    std::vector<Limb> a = operand(na), b = operand(nb);
+    if (rng() % 5 == 0 && na > nb) // a just above a multiple of b
+      std::copy(b.begin(), b.end(), a.end() - nb);
+
+    int qn = na - nb + 1;
+    for (const auto &at : forced) {
+      std::vector<Limb> q(qn), r(nb), p(na + 1), sum(na + 1);
+      LIMBS::divide(q.data(), r.data(), a.data(), na, b.data(), nb, at);
+      if (qn >= nb)
+        LIMBS::multiply(p.data(), q.data(), qn, b.data(), nb);
+      else
+        LIMBS::multiply(p.data(), b.data(), nb, q.data(), qn);
+      Limb carry = LIMBS::add(sum.data(), p.data(), na + 1, r.data(), nb);
+      CHECK(carry == 0);
+      CHECK(LIMBS::compare(sum.data(), na + 1, a.data(), na) == 0);
+      CHECK(LIMBS::compare(r.data(), nb, b.data(), nb) < 0);
+    }
+  }
+}
+
+std::string repeat(char c, int n) { return std::string(std::size_t(n), c); }
+
+std::string decimal(int digits) {
+  std::string text(1, char('1' + rng() % 9));
+  while (int(text.size()) < digits)
+    text += char('0' + rng() % 10);
+  return rng() % 2 ? "-" + text : text;
+}
+
+// + - < == against the built-in integers where they fit, and through
+// identities on the text form where they do not
+void addition() {
+  for (int i = 0; i < 20000; ++i) {
+    long long x = (long long)(rng() >> 3) - (1ll << 60);
+    long long y = (long long)(rng() >> 3) - (1ll << 60);
+    BigInt a(std::to_string(x).c_str()), b(std::to_string(y).c_str());
+    CHECK((a + b).toString() == std::to_string(x + y));
+    CHECK((a - b).toString() == std::to_string(x - y));
+    CHECK((a < b) == (x < y) && (a == b) == (x == y));
+  }
+  for (int i = 0; i < 2000; ++i) {
+    std::string x = decimal(1 + int(rng() % 400));
+    std::string y = decimal(1 + int(rng() % 400));
+    BigInt a(x.c_str()), b(y.c_str());
+    CHECK(a.toString() == x);
+    CHECK((a + b) - b == a && (a - b) + b == a && a + b == b + a);
+    CHECK(a - a == BigInt(0));
+    CHECK(a < a + BigInt(1) && !(a < a));
+  }
+}
+
+void integers() {
+  // (10^n - 1)^2 == 10^2n - 2 * 10^n + 1 == 9...980...01
+  for (int n : {1, 18, 19, 20, 95, 96, 500, 5000, 40000}) {
+    BigInt nines(repeat('9', n).c_str());
+    std::string square = repeat('9', n - 1) + "8" + repeat('0', n - 1) + "1";
+    CHECK((nines * nines).toString() == square);
+    CHECK((nines * nines / nines).toString() == repeat('9', n));
+    CHECK((nines * nines % nines).toString() == "0");
+    BigInt one = 1;
+    CHECK(((nines + one) - one) == nines);
+  }
+
+  CHECK((BigInt(2) ^ BigInt(200)).toString() ==
+        "1606938044258990275541962092341162602522202993782792835301376");
+  CHECK(BigInt("-000123").toString() == "-123");
+  CHECK(BigInt("0").toString() == "0" && BigInt("-0").toString() == "0");
+
+  // truncation toward zero, the remainder takes the dividend's sign
+  const int pairs[][2] = {{7, 2}, {-7, 2}, {7, -2}, {-7, -2}, {6, 3}, {1, 5}};
+  for (const auto &p : pairs) {
+    auto [q, r] = BigInt(p[0]).divmod(BigInt(p[1]));
+    CHECK(q.toString() == std::to_string(p[0] / p[1]));
+    CHECK(r.toString() == std::to_string(p[0] % p[1]));
+  }
+
+  bool threw = false;
+  try {
+    (void)(BigInt(1) / BigInt(0));
+  } catch (const std::domain_error &) {
+    threw = true;
+  }
+  CHECK(threw);
+
+  // inline storage until INLINE_LIMBS, then the heap block is kept
+  BigInt x = 1;
+  CHECK(x.isInline());
+  x = BigInt(2) ^ BigInt(1000);
+  CHECK(!x.isInline());
+  int cap = x.capacity();
+  x = 5;
+  CHECK(x.capacity() == cap && x.toString() == "5");
+}
+
+} // namespace
+
+int main() {
+  addition();
+  multiplication();
+  division();
+  integers();
+  std::puts("bignum_test: ok");
+  return 0;
+}
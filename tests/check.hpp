@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+// assert() that survives NDEBUG: the tests run in whatever configuration
+// the tree is built in, Release included
+#define CHECK(cond)                                                            \
+  ((cond) ? void(0) : CHECKS::fail(#cond, __FILE__, __LINE__))
+
+namespace CHECKS {
+
+[[noreturn]] inline void fail(const char *what, const char *file, int line) {
+  std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, what);
+  std::exit(1);
+}
+
+} // namespace CHECKS
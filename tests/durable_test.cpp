@@ -0,0 +1,208 @@
+/*
+ * DurableSet recovery: what a reopen sees after a clean close, a snapshot,
+ * a crash (a forked child that _exit()s), a torn log tail, a snapshot cut
+ * short before wal.old was removed, and a commit that failed half way
+ * through its write.
+ */
+
+#include "check.hpp"
+#include "durable.hpp"
+#include "rbtree.h"
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <set>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace {
+
+namespace fs = std::filesystem;
+using Set = STORE::DurableSet<int>;
+
+template <typename S> bool holds(S &set, const std::set<int> &ref) {
+  if (set.size() != ref.size())
+    return false;
+  for (int k : ref)
+    if (!set.contains(k))
+      return false;
+  return true;
+}
+
+// runs `child` in a forked process that ends in _exit(); a set the child
+// allocates and never deletes is one that crashed
+template <typename Fn> void crash(Fn child) {
+  pid_t pid = ::fork();
+  CHECK(pid >= 0);
+  if (pid == 0) {
+    child();
+    ::_exit(0);
+  }
+  int status = 0;
+  ::waitpid(pid, &status, 0);
+  CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+void reopen(const std::string &dir) {
+  using RBSet = STORE::DurableSet<int, RBTREE::RedBlackTree<int>>;
+  std::set<int> ref;
+  std::mt19937 rng(2);
+  {
+    RBSet set(dir);
+    for (int i = 0; i < 20000; ++i) {
+      int k = int(rng() % 8000) - 4000;
+      if (rng() % 3)
+        CHECK(set.insert(k) == ref.insert(k).second);
+      else
+        CHECK(set.remove(k) == (ref.erase(k) == 1));
+      if (i == 8000)
+        set.snapshot();
+    }
+  }
+  {
+    RBSet set(dir);
+    CHECK(holds(set, ref));
+    CHECK(set.recoveredKeys() > 0 && set.replayedRecords() > 0);
+    set.snapshot();
+  }
+  RBSet set(dir);
+  CHECK(holds(set, ref));
+  CHECK(set.recoveredKeys() == ref.size() && set.replayedRecords() == 0);
+}
+
+void crashAndTornTail(const std::string &dir) {
+  std::set<int> ref;
+  {
+    Set set(dir);
+    for (int k = 0; k < 100; ++k) {
+      set.insert(k);
+      ref.insert(k);
+    }
+  }
+  crash([&] {
+    STORE::Options options;
+    options.batchOps = 1 << 30;
+    options.batchDelay = std::chrono::microseconds(0);
+    auto *set = new Set(dir, options);
+    for (int k = 1000; k < 1100; ++k)
+      set->insert(k);
+    set->sync();
+    for (int k = 2000; k < 2100; ++k) // never committed
+      set->insert(k);
+  });
+  for (int k = 1000; k < 1100; ++k)
+    ref.insert(k);
+  {
+    std::ofstream wal(dir + "/wal", std::ios::app | std::ios::binary);
+    wal.write("\x01garbage", 8); // a torn record
+  }
+  {
+    Set set(dir);
+    CHECK(holds(set, ref));
+    set.insert(-1); // must land after the cut, not after the garbage
+    ref.insert(-1);
+  }
+  Set set(dir);
+  CHECK(holds(set, ref));
+}
+
+void autoSnapshotAndLeftoverLog(const std::string &dir) {
+  std::set<int> ref;
+  {
+    STORE::Options options;
+    options.batchOps = 64;
+    options.snapshotEvery = 1000;
+    options.fsync = false;
+    Set set(dir, options);
+    for (int i = 0; i < 50000; ++i) {
+      int k = (i * 7919) % 20000;
+      if (i % 3) {
+        set.insert(k);
+        ref.insert(k);
+      } else {
+        set.remove(k);
+        ref.erase(k);
+      }
+    }
+  }
+  {
+    Set set(dir);
+    CHECK(holds(set, ref));
+    CHECK(set.recoveredKeys() > 0);
+    set.insert(-1);
+  }
+  ref.insert(-1);
+
+  // a crash between moving the log aside and writing the snapshot
+  fs::rename(dir + "/wal", dir + "/wal.old");
+  {
+    Set set(dir);
+    CHECK(holds(set, ref));
+    set.remove(-1);
+    set.insert(-2);
+    set.snapshot();
+  }
+  ref.erase(-1);
+  ref.insert(-2);
+  CHECK(!fs::exists(dir + "/wal.old"));
+  Set set(dir);
+  CHECK(holds(set, ref));
+}
+
+// RLIMIT_FSIZE makes the commit's write() come up short, then fail
+void partialWrite(const std::string &dir) {
+  crash([&] {
+    std::signal(SIGXFSZ, SIG_IGN);
+    STORE::Options options;
+    options.batchOps = 1 << 30;
+    options.batchDelay = std::chrono::microseconds(0);
+    Set set(dir, options);
+    for (int k = 0; k < 50; ++k)
+      set.insert(k);
+    set.sync();
+    for (int k = 50; k < 200; ++k)
+      set.insert(k);
+
+    rlimit old{};
+    ::getrlimit(RLIMIT_FSIZE, &old);
+    rlimit low = old;
+    low.rlim_cur = 1000;
+    ::setrlimit(RLIMIT_FSIZE, &low);
+    bool threw = false;
+    try {
+      set.sync();
+    } catch (const std::system_error &) {
+      threw = true;
+    }
+    ::setrlimit(RLIMIT_FSIZE, &old);
+    if (!threw)
+      ::_exit(2);
+    set.sync(); // the retry appends the batch once
+  });
+  Set set(dir);
+  CHECK(set.size() == 200 && set.replayedRecords() == 200);
+}
+
+} // namespace
+
+int main() {
+  char base[] = "/tmp/durable_test.XXXXXX";
+  CHECK(::mkdtemp(base) != nullptr);
+  std::string root = base;
+
+  reopen(root + "/reopen");
+  crashAndTornTail(root + "/crash");
+  autoSnapshotAndLeftoverLog(root + "/snapshot");
+  partialWrite(root + "/partial");
+
+  fs::remove_all(root);
+  std::puts("durable_test: ok");
+  return 0;
+}
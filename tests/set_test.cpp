@@ -0,0 +1,321 @@
+/*
+ * The other ordered sets against std::set.
+ *
+ * Each structure gets the same random stream of inserts, removes and
+ * lookups as a std::set, with every return value and order query checked,
+ * and the full key sequence compared from time to time. The concurrent
+ * sets are then driven from several threads on disjoint key ranges, which
+ * keeps the expected final contents exact.
+ */
+
+#include "art.hpp"
+#include "betree.hpp"
+#include "check.hpp"
+#include "hashindex.hpp"
+#include "scapegoat.hpp"
+#include "sharded.hpp"
+#include "skiplist.hpp"
+#include "veb.hpp"
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include <optional>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace {
+
+template <typename Key>
+bool same(const std::optional<Key> &got,
+          typename std::set<Key>::const_iterator it,
+          const std::set<Key> &ref) {
+  return it == ref.end() ? !got : got && *got == *it;
+}
+
+template <typename Key>
+std::optional<Key> below(const std::set<Key> &ref, const Key &key) {
+  auto it = ref.lower_bound(key);
+  return it == ref.begin() ? std::nullopt : std::optional<Key>(*std::prev(it));
+}
+
+template <typename Set, typename Key>
+bool sameKeys(Set &set, const std::set<Key> &ref) {
+  std::vector<Key> keys;
+  set.forEach([&](const Key &k) { keys.push_back(k); });
+  return keys == std::vector<Key>(ref.begin(), ref.end());
+}
+
+// ART and vEB share an interface; `mask` narrows the keys so they collide
+template <typename Set, typename Key>
+void integerSet(unsigned seed, std::uint64_t mask) {
+  Set set;
+  std::set<Key> ref;
+  std::mt19937_64 rng(seed);
+  auto draw = [&] { return Key(rng() & mask); };
+  for (int step = 0; step < 100000; ++step) {
+    Key k = draw();
+    switch (rng() % 8) {
+    case 0:
+    case 1:
+    case 2:
+      CHECK(set.insert(k) == ref.insert(k).second);
+      break;
+    case 3:
+    case 4:
+      CHECK(set.remove(k) == (ref.erase(k) == 1));
+      break;
+    default:
+      CHECK(set.search(k) == (ref.count(k) == 1));
+    }
+    Key q = draw();
+    CHECK(same(set.successor(q), ref.upper_bound(q), ref));
+    CHECK(set.predecessor(q) == below(ref, q));
+    CHECK(set.size() == ref.size());
+    CHECK(same(set.minimum(), ref.begin(), ref));
+    if (step % 4999 == 0)
+      CHECK(sameKeys(set, ref));
+  }
+  while (!ref.empty()) {
+    CHECK(set.maximum() == *ref.rbegin());
+    CHECK(set.remove(*ref.rbegin()));
+    ref.erase(std::prev(ref.end()));
+  }
+  CHECK(!set.minimum() && set.size() == 0);
+}
+
+void scapegoat(double alpha) {
+  SCAPEGOAT::ScapegoatTree<int> tree(alpha);
+  std::set<int> ref;
+  std::mt19937 rng(42);
+  for (int step = 0; step < 100000; ++step) {
+    int k = int(rng() % 5000);
+    switch (rng() % 10) {
+    case 0:
+    case 1:
+    case 2:
+    case 3:
+    case 4:
+      CHECK(tree.insert(k) == ref.insert(k).second);
+      break;
+    case 5:
+    case 6:
+    case 7:
+      CHECK(tree.remove(k) == (ref.erase(k) == 1));
+      break;
+    default:
+      CHECK((tree.search(k) != nullptr) == (ref.count(k) == 1));
+    }
+    if (step % 997 == 0) {
+      CHECK(sameKeys(tree, ref));
+      CHECK(tree.size() == ref.size());
+      CHECK(same(tree.successor(k), ref.upper_bound(k), ref));
+      // alpha-height balance, with slack for deletions since the last rebuild
+      double bound = std::log(double(ref.size() + 1)) / std::log(1 / alpha);
+      CHECK(tree.height() <= bound + 3);
+    }
+  }
+
+  SCAPEGOAT::ScapegoatTree<int> sorted(alpha);
+  for (int k = 0; k < 100000; ++k)
+    sorted.insert(k);
+  CHECK(sorted.height() <= std::log(100001.0) / std::log(1 / alpha) + 1);
+  for (int k = 0; k < 100000; k += 2)
+    sorted.remove(k);
+  CHECK(sorted.size() == 50000 && *sorted.minimum() == 1);
+
+  SCAPEGOAT::ScapegoatTree<int, Descending<>> desc{3, 1, 2};
+  std::vector<int> keys;
+  desc.forEach([&](int k) { keys.push_back(k); });
+  CHECK((keys == std::vector<int>{3, 2, 1}));
+}
+
+// small leaves and fanouts force splits, merges and buffer flushes
+void buffered(std::size_t leaf, std::size_t fanout, std::size_t buffer) {
+  BETREE::BufferedTree<int> tree(leaf, fanout, buffer);
+  std::set<int> ref;
+  std::mt19937 rng(unsigned(leaf * 31 + fanout));
+  for (int step = 0; step < 100000; ++step) {
+    int k = int(rng() % 5000);
+    switch (rng() % 10) {
+    case 0:
+    case 1:
+    case 2:
+    case 3:
+    case 4:
+      tree.insert(k);
+      ref.insert(k);
+      break;
+    case 5:
+    case 6:
+    case 7:
+      tree.remove(k);
+      ref.erase(k);
+      break;
+    case 8:
+      CHECK(same(tree.successor(k), ref.upper_bound(k), ref));
+      break;
+    default:
+      CHECK(tree.search(k) == (ref.count(k) == 1));
+      CHECK(same(tree.minimum(), ref.begin(), ref));
+    }
+  }
+  CHECK(sameKeys(tree, ref));
+  tree.flush();
+  CHECK(sameKeys(tree, ref));
+}
+
+void hashIndexed() {
+  TREE::HashIndexedSet<int> set(4); // grows several times
+  std::set<int> ref;
+  std::mt19937 rng(11);
+  for (int step = 0; step < 100000; ++step) {
+    int k = int(rng() % 5000);
+    switch (rng() % 4) {
+    case 0:
+    case 1:
+      CHECK(set.insert(k) == ref.insert(k).second);
+      CHECK(set.find(k) && set.find(k)->key == k); // the node insert linked
+      break;
+    case 2:
+      CHECK(set.remove(k) == (ref.erase(k) == 1));
+      break;
+    default:
+      CHECK(set.contains(k) == (ref.count(k) == 1));
+      CHECK((set.find(k) != nullptr) == set.contains(k));
+      CHECK(same(set.successor(k), ref.upper_bound(k), ref));
+    }
+    CHECK(set.size() == ref.size());
+  }
+  CHECK(same(set.minimum(), ref.begin(), ref));
+  std::vector<int> got;
+  for (int k : set.range(1000, 2000))
+    got.push_back(k);
+  CHECK(got == std::vector<int>(ref.lower_bound(1000), ref.lower_bound(2000)));
+}
+
+void sharded() {
+  // a skewed load must move the splitters and keep global order
+  TREE::ShardedSet<int> set(8);
+  std::set<int> ref;
+  std::mt19937 rng(5);
+  for (int step = 0; step < 100000; ++step) {
+    int k = step < 50000 ? int(rng() % 1000) : int(rng() % 1000000);
+    if (rng() % 4) {
+      CHECK(set.insert(k) == ref.insert(k).second);
+    } else {
+      CHECK(set.remove(k) == (ref.erase(k) == 1));
+    }
+  }
+  CHECK(set.size() == ref.size());
+  CHECK(std::vector<int>(set.begin(), set.end()) ==
+        std::vector<int>(ref.begin(), ref.end()));
+  std::size_t largest = 0;
+  for (std::size_t i = 0; i < set.shardCount(); ++i)
+    largest = std::max(largest, set.shardSize(i));
+  CHECK(largest < ref.size() / 2);
+
+  // a seeded range splits evenly before any rebalance
+  TREE::ShardedSet<int> even(4, 0, 1000);
+  for (int k = 0; k < 1000; ++k)
+    even.insert(k);
+  for (std::size_t i = 0; i < 4; ++i)
+    CHECK(even.shardSize(i) == 250);
+
+  // the order is the trees' own, splitters included
+  TREE::ShardedSet<int, TREE::AVLTree<int, Descending<>>> desc(4, 0, 1000);
+  for (int k = 0; k < 1000; ++k)
+    desc.insert(k);
+  std::vector<int> keys(desc.begin(), desc.end());
+  CHECK(keys.size() == 1000 && keys.front() == 999 && keys.back() == 0);
+  CHECK(std::is_sorted(keys.rbegin(), keys.rend()));
+
+  // writers on disjoint ranges
+  TREE::ShardedSet<int> shared(4, 0, 400000);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t)
+    threads.emplace_back([&shared, t] {
+      for (int k = t * 100000; k < (t + 1) * 100000; ++k)
+        shared.insert(k);
+      for (int k = t * 100000; k < (t + 1) * 100000; k += 2)
+        shared.remove(k);
+    });
+  for (auto &thread : threads)
+    thread.join();
+  CHECK(shared.size() == 200000);
+  for (int k = 0; k < 400000; k += 1001)
+    CHECK(shared.contains(k) == (k % 2 == 1));
+}
+
+void skipList() {
+  SKIPLIST::LockFreeSkipList<int> list;
+  std::set<int> ref;
+  std::mt19937 rng(9);
+  for (int step = 0; step < 100000; ++step) {
+    int k = int(rng() % 5000);
+    switch (rng() % 4) {
+    case 0:
+    case 1:
+      CHECK(list.insert(k) == ref.insert(k).second);
+      break;
+    case 2:
+      CHECK(list.remove(k) == (ref.erase(k) == 1));
+      break;
+    default:
+      CHECK(list.search(k) == (ref.count(k) == 1));
+      CHECK(same(list.successor(k), ref.upper_bound(k), ref));
+    }
+  }
+  CHECK(list.size() == ref.size());
+  CHECK(same(list.minimum(), ref.begin(), ref));
+
+  // each thread owns a residue class; odd keys survive
+  SKIPLIST::LockFreeSkipList<int> shared;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t)
+    threads.emplace_back([&shared, t] {
+      for (int k = t; k < 200000; k += 4)
+        CHECK(shared.insert(k));
+      for (int k = t; k < 200000; k += 4)
+        if (k % 2 == 0)
+          CHECK(shared.remove(k));
+    });
+  for (auto &thread : threads)
+    thread.join();
+  CHECK(shared.size() == 100000);
+  for (int k = 0; k < 200000; k += 999)
+    CHECK(shared.search(k) == (k % 2 == 1));
+  CHECK(shared.minimum() == 1 && shared.successor(1) == 3);
+}
+
+} // namespace
+
+int main() {
+  using ART::AdaptiveRadixTree;
+  using VEB::VanEmdeBoasTree;
+  integerSet<AdaptiveRadixTree<int>, int>(1, ~0ull);
+  integerSet<AdaptiveRadixTree<int>, int>(2, 0x80000fff); // both signs
+  integerSet<AdaptiveRadixTree<std::int64_t>, std::int64_t>(3, 0xff0000ffff);
+  integerSet<AdaptiveRadixTree<std::uint8_t>, std::uint8_t>(4, 0xff);
+  integerSet<VanEmdeBoasTree<int>, int>(5, ~0ull);
+  integerSet<VanEmdeBoasTree<int>, int>(6, 0x80000fff);
+  integerSet<VanEmdeBoasTree<unsigned>, unsigned>(7, 0xc001ffff);
+  integerSet<VanEmdeBoasTree<std::int16_t>, std::int16_t>(8, 0xffff);
+
+  for (double alpha : {0.55, 0.7, 0.9})
+    scapegoat(alpha);
+
+  buffered(4, 4, 4);
+  buffered(8, 4, 16);
+  buffered(16, 5, 8);
+  buffered(128, 16, 512);
+
+  hashIndexed();
+  sharded();
+  skipList();
+
+  std::puts("set_test: ok");
+  return 0;
+}
@@ -0,0 +1,301 @@
+/*
+ * The binary trees against std::set / std::multiset.
+ *
+ * Random insert / remove / search streams over a small key range (so keys
+ * collide often), checking every answer and, periodically, the in-order
+ * sequence and the structural invariants. Then the optional node features
+ * (lazy delete, multiset, hashing), the Merkle comparisons, nodes freed
+ * on another thread than the one that made them, and the exporters'
+ * quoting.
+ */
+
+#include "check.hpp"
+#include "export.hpp"
+#include "generator.hpp"
+#include "nodepool.hpp"
+#include "rbtree.h"
+#include "tree.hpp"
+#include "validate.hpp"
+#include <compare>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+using C = std::compare_three_way;
+
+template <typename Tree, typename Ref> bool sameKeys(Tree &tree, Ref &ref) {
+  std::vector<int> keys;
+  for (int k : TRAVERSE::inOrder(tree.getRoot()))
+    keys.push_back(k);
+  return keys == std::vector<int>(ref.begin(), ref.end());
+}
+
+// `balanced` is false for the plain BST, which the validator would hold to
+// the AVL height rule
+template <typename Tree> void differential(unsigned seed, bool balanced) {
+  Tree tree;
+  std::set<int> ref;
+  std::mt19937 rng(seed);
+  for (int step = 0; step < 100000; ++step) {
+    int k = int(rng() % 4000) - 2000;
+    switch (rng() % 4) {
+    case 0:
+    case 1:
+      if (!tree.search(k)) // the plain BST keeps duplicates
+        tree.insert(k);
+      ref.insert(k);
+      break;
+    case 2:
+      tree.remove(k);
+      ref.erase(k);
+      break;
+    default: {
+      auto *node = tree.search(k);
+      CHECK((node != nullptr) == (ref.count(k) == 1));
+      if (node) {
+        // the maximum is its own successor
+        auto *next = tree.successor(k);
+        auto it = ref.upper_bound(k);
+        CHECK(next->key == (it == ref.end() ? k : *it));
+      }
+    }
+    }
+    if (step % 997 == 0) {
+      CHECK(sameKeys(tree, ref));
+      if (!ref.empty()) {
+        CHECK(tree.minimum()->key == *ref.begin());
+        CHECK(tree.maximum()->key == *ref.rbegin());
+      }
+      if (balanced)
+        CHECK(VALIDATE::validate(tree).ok);
+    }
+  }
+  // keys above the maximum take the append fast path
+  for (int k = 5000; k < 6000; ++k) {
+    tree.insert(k);
+    ref.insert(k);
+  }
+  CHECK(sameKeys(tree, ref));
+  if (balanced)
+    CHECK(VALIDATE::validate(tree).ok);
+}
+
+template <typename Tree> void descending() {
+  Tree tree{3, 1, 4, 1, 5, 9, 2, 6};
+  std::vector<int> keys;
+  for (int k : TRAVERSE::inOrder(tree.getRoot()))
+    keys.push_back(k);
+  CHECK((keys == std::vector<int>{9, 6, 5, 4, 3, 2, 1}));
+  CHECK(tree.minimum()->key == 9 && tree.successor(4)->key == 3);
+  CHECK(VALIDATE::validate(tree).ok);
+}
+
+template <typename Tree> void hinted() {
+  Tree tree;
+  auto *node = tree.insert(nullptr, 0);
+  for (int k = 1; k < 5000; ++k)
+    node = tree.insert(node, k);
+  for (int k = -1; k > -5000; --k)
+    tree.insert(tree.minimum(), k);
+  CHECK(VALIDATE::validate(tree).ok);
+  CHECK(tree.minimum()->key == -4999 && tree.maximum()->key == 4999);
+
+  // a hint that is no neighbour, or an equal key, falls back to one descent
+  tree.insert(nullptr, 20000);
+  auto *mid = tree.insert(tree.minimum(), 15000);
+  CHECK(mid->key == 15000 && mid == tree.search(15000));
+  CHECK(tree.insert(mid, 2500) == tree.search(2500));
+  CHECK(VALIDATE::validate(tree).ok);
+}
+
+// Features against a multiset (a set when MULTISET is off)
+template <typename Tree, unsigned F> void features(unsigned seed) {
+  constexpr bool lazy = F & NODE::LAZY_DELETE, counted = F & NODE::MULTISET;
+  Tree tree;
+  if constexpr (lazy)
+    tree.setLazyDelete(true);
+  if constexpr (counted)
+    tree.setMultiset(true);
+  if constexpr ((F & NODE::HASHING) != 0)
+    tree.setHashing(true);
+
+  std::multiset<int> ref;
+  std::mt19937 rng(seed);
+  for (int step = 0; step < 40000; ++step) {
+    int k = int(rng() % 500);
+    if (rng() % 3 < 2) {
+      tree.insert(k);
+      if (counted || !ref.count(k))
+        ref.insert(k);
+    } else if constexpr (counted) {
+      tree.removeOne(k);
+      if (auto it = ref.find(k); it != ref.end())
+        ref.erase(it);
+    } else {
+      tree.remove(k);
+      ref.erase(k);
+    }
+    if constexpr (lazy)
+      if (step % 97 == 0)
+        tree.compactStep(8);
+  }
+  for (int k = 0; k < 500; ++k)
+    CHECK(tree.count(k) == ref.count(k));
+  if constexpr (lazy) {
+    tree.compact();
+    CHECK(tree.tombstoneCount() == 0);
+    for (int k = 0; k < 500; ++k)
+      CHECK(tree.count(k) == ref.count(k));
+  }
+  CHECK(VALIDATE::validate(tree).ok);
+}
+
+template <typename Tree> void merkle() {
+  Tree a, b;
+  for (int k = 0; k < 200; ++k) {
+    a.insert(k);
+    b.insert(199 - k);
+  }
+  CHECK(a.equals(b) && a.diff(b).empty());
+  b.insert(500);
+  a.remove(7);
+  CHECK(!a.equals(b));
+  CHECK((a.diff(b) == std::vector<int>{7, 500}));
+
+  // multiplicities count, and the trees' own hashing setting survives
+  Tree m, n;
+  m.setMultiset(true);
+  n.setMultiset(true);
+  m.insert(1);
+  m.insert(2);
+  n.insert(1);
+  n.insert(2);
+  n.insert(2);
+  CHECK((m.diff(n) == std::vector<int>{2}));
+  m.insert(2);
+  CHECK(m.equals(n));
+  m.remove(1);
+  n.remove(1);
+  CHECK(m.equals(n));
+}
+
+// A tree filled on one thread and emptied on another: its nodes join the
+// freeing thread's cache and go back to the shared pool when that thread
+// exits, so the next round must not need new slabs
+void crossThread() {
+  using Pool = POOL::NodePool<POOL::sizeClass(sizeof(RBTNode<int>))>;
+  auto round = [] {
+    RBTREE::RedBlackTree<int> *tree = nullptr;
+    std::thread([&tree] {
+      tree = new RBTREE::RedBlackTree<int>;
+      for (int k = 0; k < 20000; ++k)
+        tree->insert(k * 7919 % 20000);
+    }).join();
+    std::thread([&tree] {
+      for (int k = 0; k < 20000; ++k)
+        tree->remove(k);
+      CHECK(tree->getRoot() == nullptr);
+      delete tree;
+    }).join();
+  };
+  round();
+  std::size_t reserved = Pool::reserved();
+  for (int i = 0; i < 20; ++i)
+    round();
+  CHECK(Pool::reserved() == reserved);
+}
+
+// keys that print with quotes, backslashes or control characters
+void exported() {
+  TREE::AVLTree<std::string> tree;
+  for (const char *key : {"a\"b", "c\\d", "e\nf", "g\x01h"})
+    tree.insert(key);
+  EXPORT::TreeExporter<std::remove_pointer_t<decltype(tree.getRoot())>> out;
+  CHECK(out.json(tree.getRoot()) ==
+        R"({"key":"c\\d","left":{"key":"a\"b","left":null,"right":null},)"
+        R"("right":{"key":"e\nf","left":null,"right":{"key":"g\u0001h",)"
+        R"("left":null,"right":null}}})"
+        "\n");
+  out.clear();
+  std::string dot = out.dot(tree.getRoot());
+  CHECK(dot.find(R"(n0 [label="c\\d"];)") != std::string::npos);
+  CHECK(dot.find(R"(n1 [label="a\"b"];)") != std::string::npos);
+  CHECK(dot.find(R"(n2 [label="e\nf"];)") != std::string::npos);
+
+  // numbers stay numbers, except those JSON has no spelling for
+  RBTREE::RedBlackTree<double> reals;
+  for (double key : {1.5, -2.0, 1.0 / 0.0})
+    reals.insert(key);
+  EXPORT::TreeExporter<std::remove_pointer_t<decltype(reals.getRoot())>> num;
+  std::string json = num.json(reals.getRoot());
+  CHECK(json.find(R"("key":1.5)") != std::string::npos);
+  CHECK(json.find(R"("key":-2,)") != std::string::npos);
+  CHECK(json.find(R"("key":"inf")") != std::string::npos);
+
+  // and read back to the same doubles, however close together
+  const std::set<double> exact = {1.0000001, 1.0000002, 123456789.0,
+                                  0.1,       1e-300,    -2.5e300};
+  TREE::AVLTree<double> close;
+  for (double key : exact)
+    close.insert(key);
+  EXPORT::TreeExporter<std::remove_pointer_t<decltype(close.getRoot())>> dbl;
+  auto readBack = [](const std::string &out, const char *marker) {
+    std::set<double> keys;
+    for (auto at = out.find(marker); at != std::string::npos;
+         at = out.find(marker, at + 1)) {
+      const char *from = out.c_str() + at + std::strlen(marker);
+      char *end = nullptr;
+      double key = std::strtod(from, &end);
+      if (end != from) // not an edge label
+        keys.insert(key);
+    }
+    return keys;
+  };
+  CHECK(readBack(dbl.json(close.getRoot()), R"("key":)") == exact);
+  dbl.clear();
+  CHECK(readBack(dbl.dot(close.getRoot()), R"(label=")") == exact);
+  dbl.clear();
+  CHECK(readBack(dbl.text(close.getRoot()), "──") == exact);
+}
+
+} // namespace
+
+int main() {
+  differential<TREE::BinarySearchTree<int>>(1, false);
+  differential<TREE::AVLTree<int>>(2, true);
+  differential<RBTREE::RedBlackTree<int>>(3, true);
+  differential<TREE::AVLTree<int, C, NODE::ALL>>(4, true);
+  differential<RBTREE::RedBlackTree<int, C, NODE::ALL>>(5, true);
+
+  descending<TREE::AVLTree<int, Descending<>>>();
+  descending<RBTREE::RedBlackTree<int, Descending<>>>();
+  hinted<TREE::AVLTree<int>>();
+  hinted<RBTREE::RedBlackTree<int>>();
+
+  constexpr unsigned LAZY = NODE::LAZY_DELETE;
+  constexpr unsigned COUNTED = NODE::MULTISET | NODE::HASHING;
+  features<TREE::AVLTree<int, C, LAZY>, LAZY>(6);
+  features<TREE::AVLTree<int, C, COUNTED>, COUNTED>(7);
+  features<TREE::AVLTree<int, C, NODE::ALL>, NODE::ALL>(8);
+  features<RBTREE::RedBlackTree<int, C, LAZY>, LAZY>(9);
+  features<RBTREE::RedBlackTree<int, C, NODE::ALL>, NODE::ALL>(10);
+
+  merkle<TREE::AVLTree<int, C, NODE::ALL>>();
+  merkle<RBTREE::RedBlackTree<int, C, NODE::ALL>>();
+
+  crossThread();
+  exported();
+
+  static_assert(sizeof(BSTNode<int>) == 32 && sizeof(RBTNode<int>) == 32);
+
+  std::puts("tree_test: ok");
+  return 0;
+}